@@ -1,3 +1,5 @@
 C:/VulkanSDK/1.2.162.1/Bin32/glslc.exe shaders/shader.vert -o shaders/vert.spv
 C:/VulkanSDK/1.2.162.1/Bin32/glslc.exe shaders/shader.frag -o shaders/frag.spv
+C:/VulkanSDK/1.2.162.1/Bin32/glslc.exe shaders/cluster_cull.comp -o shaders/cluster_cull.spv
+C:/VulkanSDK/1.2.162.1/Bin32/glslc.exe shaders/object_cull.comp -o shaders/object_cull.spv
 pause
\ No newline at end of file
@@ -1,21 +1,37 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(location = 0) out vec3 fragColor;
+//set per mesh from its vertex layout, see vertex_layout_decode_constants
+layout(constant_id = 0) const bool OCTAHEDRAL_COLOR = false;
+
+//float positions come with the identity, quantised ones are stored in -1 to 1 over the mesh bounds
+layout(push_constant) uniform PositionTransform {
+    vec4 scale;
+    vec4 offset;
+} positionTransform;
+
+//snorm and half float formats are turned into floats by the vertex fetch, only the transform is left to do
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
+//per instance, a translation in xyz with a uniform scale in w, an rgba8 tint and an application defined id
+layout(location = 2) in vec4 inInstanceTransform;
+layout(location = 3) in vec4 inInstanceColor;
+layout(location = 4) in uint inInstanceId;
+
+layout(location = 0) out vec3 fragColor;
 
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
-);
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
-}
\ No newline at end of file
+    vec3 position = positionTransform.offset.xyz + positionTransform.scale.xyz * inPosition;
+    position = inInstanceTransform.xyz + inInstanceTransform.w * position;
+    gl_Position = vec4(position.xy, 0.0, 1.0);
+    fragColor = (OCTAHEDRAL_COLOR ? decodeOctahedral(inColor.xy) : inColor) * inInstanceColor.rgb;
+}
@@ -1,9 +1,28 @@
+//clock_gettime and nanosleep are posix rather than plain C so ask for them before any header is included
+#ifndef _WIN32
+	#define _POSIX_C_SOURCE 200112L
+#endif
+
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
 
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <pthread.h>
+	#include <time.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
 #include "basic_helpers.h"
+#include "profiler.h"
 char *read_file(char *file_name, bool null_terminated) {
+	PROFILE_BEGIN_DETAIL("read_file", file_name);
 	FILE *f = fopen(file_name, "rb");
 	fseek(f, 0, SEEK_END);
 	long f_size = ftell(f);
@@ -13,6 +32,7 @@ char *read_file(char *file_name, bool null_terminated) {
    fclose(f);
 	if (null_terminated)
 		string[f_size] = '\0';
+	PROFILE_END();
 	return string;
 }
 
@@ -22,4 +42,256 @@ long get_length(char *file_name){
 	long length = ftell(f);
 	fclose(f);
 	return length;
-}
\ No newline at end of file
+}
+
+struct mapped_file map_file(const char *file_name){
+	PROFILE_BEGIN_DETAIL("map_file", file_name);
+	struct mapped_file mapped = {0};
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	LARGE_INTEGER size;
+	if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size) || size.QuadPart == 0){
+		printf("Error: failed to open %s for mapping\n", file_name);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		PROFILE_END();
+		return mapped;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	void *data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (!data){
+		printf("Error: failed to map %s\n", file_name);
+		if (mapping)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		PROFILE_END();
+		return mapped;
+	}
+
+	mapped.file = file;
+	mapped.mapping = mapping;
+	mapped.data = data;
+	mapped.size = (size_t)size.QuadPart;
+#else
+	int fd = open(file_name, O_RDONLY);
+	struct stat info;
+	if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0){
+		printf("Error: failed to open %s for mapping\n", file_name);
+		if (fd >= 0)
+			close(fd);
+		PROFILE_END();
+		return mapped;
+	}
+
+	//the mapping keeps its own reference to the file so the descriptor can go straight away
+	void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED){
+		printf("Error: failed to map %s\n", file_name);
+		PROFILE_END();
+		return mapped;
+	}
+
+	//everything mapped is read front to back exactly once, so ask for aggressive read ahead
+	posix_madvise(data, (size_t)info.st_size, POSIX_MADV_SEQUENTIAL);
+	mapped.data = data;
+	mapped.size = (size_t)info.st_size;
+#endif
+
+	PROFILE_END();
+	return mapped;
+}
+
+void unmap_file(struct mapped_file *file){
+	if (!file->data)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(file->data);
+	CloseHandle(file->mapping);
+	CloseHandle(file->file);
+#else
+	munmap((void *)file->data, file->size);
+#endif
+	*file = (struct mapped_file){0};
+}
+
+uint64_t get_time_ns(){
+#ifdef _WIN32
+	static LARGE_INTEGER frequency = {0};
+	if (frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	//split the conversion so the multiply doesnt overflow for long uptimes
+	uint64_t seconds = counter.QuadPart / frequency.QuadPart;
+	uint64_t remainder = counter.QuadPart % frequency.QuadPart;
+	return seconds * 1000000000ull + remainder * 1000000000ull / frequency.QuadPart;
+#else
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+#endif
+}
+
+void sleep_ms(uint32_t milliseconds){
+#ifdef _WIN32
+	Sleep(milliseconds);
+#else
+	struct timespec time = {
+		.tv_sec = milliseconds / 1000,
+		.tv_nsec = (long)(milliseconds % 1000) * 1000000L
+	};
+	nanosleep(&time, NULL);
+#endif
+}
+
+//the platform handle plus what it should run, the start routines below unpack it
+struct thread{
+#ifdef _WIN32
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+	void (*func)(void *arg);
+	void *arg;
+};
+
+#ifdef _WIN32
+static DWORD WINAPI thread_start_routine(LPVOID data){
+	struct thread *thread = data;
+	thread->func(thread->arg);
+	return 0;
+}
+#else
+static void *thread_start_routine(void *data){
+	struct thread *thread = data;
+	thread->func(thread->arg);
+	return NULL;
+}
+#endif
+
+struct thread *start_thread(void (*func)(void *arg), void *arg){
+	struct thread *thread = malloc(sizeof *thread);
+	if (!thread){
+		printf("Error: failed to allocate thread");
+		return NULL;
+	}
+	thread->func = func;
+	thread->arg = arg;
+
+#ifdef _WIN32
+	thread->handle = CreateThread(NULL, 0, thread_start_routine, thread, 0, NULL);
+	bool started = thread->handle != NULL;
+#else
+	bool started = pthread_create(&thread->handle, NULL, thread_start_routine, thread) == 0;
+#endif
+
+	if (!started){
+		printf("Error: failed to start thread");
+		free(thread);
+		return NULL;
+	}
+	return thread;
+}
+
+void join_thread(struct thread *thread){
+	if (!thread) return;
+
+#ifdef _WIN32
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+#else
+	pthread_join(thread->handle, NULL);
+#endif
+	free(thread);
+}
+
+int get_cpu_count(){
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	int count = (int)info.dwNumberOfProcessors;
+#else
+	int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return count > 0 ? count : 1;
+}
+
+//the header sits in front of the bytes handed out, 16 bytes so allocations keep the alignment malloc gave
+struct scratch_chunk{
+	struct scratch_chunk *next;
+	size_t size;
+	size_t used;
+	size_t pad;
+};
+
+#define SCRATCH_ALIGNMENT 16
+
+struct scratch_arena create_scratch_arena(size_t chunk_size){
+	struct scratch_arena arena = {0};
+	arena.chunk_size = chunk_size;
+	return arena;
+}
+
+static struct scratch_chunk *new_scratch_chunk(size_t size){
+	struct scratch_chunk *chunk = malloc(sizeof *chunk + size);
+	if (!chunk){
+		printf("Error: failed to allocate scratch chunk");
+		return NULL;
+	}
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
+	return chunk;
+}
+
+void *scratch_alloc(struct scratch_arena *arena, size_t size){
+	size = (size + SCRATCH_ALIGNMENT - 1) & ~(size_t)(SCRATCH_ALIGNMENT - 1);
+
+	//only the newest chunk is bumped from, whatever was left at the end of older ones is wasted until the reset
+	struct scratch_chunk *chunk = arena->chunks;
+	if (!chunk || chunk->size - chunk->used < size){
+		chunk = new_scratch_chunk(size > arena->chunk_size ? size : arena->chunk_size);
+		if (!chunk)
+			return NULL;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+
+	void *data = (char *)(chunk + 1) + chunk->used;
+	chunk->used += size;
+	arena->used += size;
+	if (arena->used > arena->high_water)
+		arena->high_water = arena->used;
+	return data;
+}
+
+void scratch_reset(struct scratch_arena *arena){
+	if (!arena->chunks)
+		return;
+
+	//more than one chunk means the last round outgrew the chunk size, so grow it to what was needed
+	if (arena->chunks->next){
+		destroy_scratch_arena(arena);
+		if (arena->high_water > arena->chunk_size)
+			arena->chunk_size = arena->high_water;
+		return;
+	}
+	arena->chunks->used = 0;
+	arena->used = 0;
+}
+
+void destroy_scratch_arena(struct scratch_arena *arena){
+	struct scratch_chunk *chunk = arena->chunks;
+	while (chunk){
+		struct scratch_chunk *next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+	arena->chunks = NULL;
+	arena->used = 0;
+}
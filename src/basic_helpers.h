@@ -1,2 +1,44 @@
 char *read_file(char *file_name, bool null_terminated);
-long get_length(char *file_name);
\ No newline at end of file
+long get_length(char *file_name);
+
+//maps a whole file read only, for big files that are only copied out of so nothing is read into a malloc first
+struct mapped_file map_file(const char *file_name);
+void unmap_file(struct mapped_file *file);
+
+//a monotonic clock in nanoseconds, only differences between two calls mean anything
+uint64_t get_time_ns();
+void sleep_ms(uint32_t milliseconds);
+
+//a minimal thread wrapper over win32 threads and pthreads, the thread is freed by join_thread
+struct thread;
+struct thread *start_thread(void (*func)(void *arg), void *arg);
+void join_thread(struct thread *thread);
+int get_cpu_count();
+
+//a bump allocator for short lived arrays such as vulkan enumeration results, everything is freed at once by a reset
+struct scratch_arena create_scratch_arena(size_t chunk_size);
+void *scratch_alloc(struct scratch_arena *arena, size_t size);
+void scratch_reset(struct scratch_arena *arena);
+void destroy_scratch_arena(struct scratch_arena *arena);
+
+//structs
+
+struct scratch_chunk;
+
+//data is NULL when the file couldnt be opened or mapped, the handles are only needed to undo the mapping on windows
+struct mapped_file{
+	const void *data;
+	size_t size;
+#ifdef _WIN32
+	void *file;
+	void *mapping;
+#endif
+};
+
+//chunks are chained when one fills up, a reset folds them back into a single chunk big enough for the next round
+struct scratch_arena{
+	struct scratch_chunk *chunks;
+	size_t chunk_size;
+	size_t used;
+	size_t high_water;
+};
@@ -0,0 +1,164 @@
+//plain old C headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "benchmark.h"
+
+static const char *benchmark_metric_names[BENCH_METRIC_COUNT] = {
+	[BENCH_WAIT_MS] = "wait_ms",
+	[BENCH_ACQUIRE_MS] = "acquire_ms",
+	[BENCH_SUBMIT_MS] = "submit_ms",
+	[BENCH_PRESENT_MS] = "present_ms",
+	[BENCH_FRAME_MS] = "frame_ms",
+	[BENCH_GPU_FRAME_MS] = "gpu_frame_ms",
+	[BENCH_IA_VERTICES] = "ia_vertices",
+	[BENCH_IA_PRIMITIVES] = "ia_primitives",
+	[BENCH_VS_INVOCATIONS] = "vs_invocations",
+	[BENCH_CLIPPING_INVOCATIONS] = "clipping_invocations",
+	[BENCH_CLIPPING_PRIMITIVES] = "clipping_primitives",
+	[BENCH_FS_INVOCATIONS] = "fs_invocations"
+};
+
+struct benchmark create_benchmark(uint32_t warmup_frames, uint32_t measured_frames){
+	struct benchmark benchmark = {0};
+	benchmark.warmup_frames = warmup_frames;
+	benchmark.measured_frames = measured_frames;
+
+	//everything is allocated up front so recording a frame never allocates
+	for (int i = 0; i < BENCH_METRIC_COUNT; i++){
+		benchmark.samples[i] = malloc(sizeof *benchmark.samples[i] * measured_frames);
+		if (!benchmark.samples[i]){
+			printf("Error: failed to allocate benchmark samples");
+			benchmark.measured_frames = 0;
+		}
+	}
+
+	return benchmark;
+}
+
+void destroy_benchmark(struct benchmark *benchmark){
+	for (int i = 0; i < BENCH_METRIC_COUNT; i++){
+		free(benchmark->samples[i]);
+		benchmark->samples[i] = NULL;
+	}
+}
+
+bool benchmark_measuring(struct benchmark *benchmark){
+	return benchmark->frames_seen >= benchmark->warmup_frames && !benchmark_finished(benchmark);
+}
+
+bool benchmark_finished(struct benchmark *benchmark){
+	return benchmark->frames_seen >= benchmark->warmup_frames + benchmark->measured_frames;
+}
+
+void benchmark_record(struct benchmark *benchmark, enum benchmark_metric metric, double value){
+	//warm up frames are thrown away, they are dominated by pipeline compiles and driver first use costs
+	if (!benchmark_measuring(benchmark) || benchmark->sample_counts[metric] >= benchmark->measured_frames)
+		return;
+
+	benchmark->samples[metric][benchmark->sample_counts[metric]++] = value;
+}
+
+void benchmark_next_frame(struct benchmark *benchmark){
+	benchmark->frames_seen++;
+}
+
+static int compare_doubles(const void *a, const void *b){
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+//nearest rank percentile on already sorted samples
+static double percentile(const double *sorted, uint32_t count, double percent){
+	uint32_t rank = (uint32_t)(percent / 100.0 * count + 0.5);
+	if (rank < 1) rank = 1;
+	if (rank > count) rank = count;
+	return sorted[rank - 1];
+}
+
+static struct benchmark_summary summarise(const double *samples, uint32_t count){
+	struct benchmark_summary summary = {0};
+	summary.count = count;
+	if (!count)
+		return summary;
+
+	double *sorted = malloc(sizeof *sorted * count);
+	if (!sorted){
+		printf("Error: failed to allocate benchmark sort buffer");
+		return summary;
+	}
+	memcpy(sorted, samples, sizeof *sorted * count);
+	qsort(sorted, count, sizeof *sorted, compare_doubles);
+
+	double total = 0.0;
+	for (uint32_t i = 0; i < count; i++){
+		total += sorted[i];
+	}
+
+	summary.min = sorted[0];
+	summary.mean = total / count;
+	summary.p50 = percentile(sorted, count, 50.0);
+	summary.p95 = percentile(sorted, count, 95.0);
+	summary.p99 = percentile(sorted, count, 99.0);
+	summary.max = sorted[count - 1];
+
+	free(sorted);
+	return summary;
+}
+
+bool benchmark_report(struct benchmark *benchmark, const char *file_name, enum benchmark_format format){
+	FILE *f = file_name ? fopen(file_name, "w") : stdout;
+	if (!f){
+		printf("Error: failed to open benchmark output %s\n", file_name);
+		return false;
+	}
+
+	if (format == BENCH_FORMAT_CSV){
+		fprintf(f, "metric,count,min,mean,p50,p95,p99,max\n");
+	} else {
+		fprintf(f, "{\n\t\"warmup_frames\": %u,\n\t\"measured_frames\": %u,\n\t\"metrics\": {", benchmark->warmup_frames, benchmark->measured_frames);
+	}
+
+	bool first = true;
+	for (int i = 0; i < BENCH_METRIC_COUNT; i++){
+		//metrics nothing was recorded for, such as present in a headless run, are left out
+		if (!benchmark->sample_counts[i])
+			continue;
+
+		struct benchmark_summary s = summarise(benchmark->samples[i], benchmark->sample_counts[i]);
+		if (format == BENCH_FORMAT_CSV){
+			fprintf(f, "%s,%u,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n", benchmark_metric_names[i], s.count, s.min, s.mean, s.p50, s.p95, s.p99, s.max);
+		} else {
+			fprintf(f, "%s\n\t\t\"%s\": {\"count\": %u, \"min\": %.6f, \"mean\": %.6f, \"p50\": %.6f, \"p95\": %.6f, \"p99\": %.6f, \"max\": %.6f}",
+				first ? "" : ",", benchmark_metric_names[i], s.count, s.min, s.mean, s.p50, s.p95, s.p99, s.max);
+		}
+		first = false;
+	}
+
+	if (format == BENCH_FORMAT_JSON)
+		fprintf(f, "\n\t}\n}\n");
+
+	if (f != stdout)
+		fclose(f);
+	return true;
+}
+
+struct benchmark_summary benchmark_summarise_metric(struct benchmark *benchmark, enum benchmark_metric metric){
+	return summarise(benchmark->samples[metric], benchmark->sample_counts[metric]);
+}
+
+bool parse_benchmark_format(const char *name, enum benchmark_format *format){
+	if (strcmp(name, "json") == 0){
+		*format = BENCH_FORMAT_JSON;
+		return true;
+	}
+	if (strcmp(name, "csv") == 0){
+		*format = BENCH_FORMAT_CSV;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,64 @@
+//forward declarations of structs defined further down that are passed around by pointer
+struct benchmark;
+
+//enums
+
+//every value the benchmark tracks per frame, the names used in the report live in benchmark.c
+enum benchmark_metric{
+	BENCH_WAIT_MS,
+	BENCH_ACQUIRE_MS,
+	BENCH_SUBMIT_MS,
+	BENCH_PRESENT_MS,
+	BENCH_FRAME_MS,
+	BENCH_GPU_FRAME_MS,
+	//pipeline statistics counters per frame, only recorded when the device supports them
+	BENCH_IA_VERTICES,
+	BENCH_IA_PRIMITIVES,
+	BENCH_VS_INVOCATIONS,
+	BENCH_CLIPPING_INVOCATIONS,
+	BENCH_CLIPPING_PRIMITIVES,
+	BENCH_FS_INVOCATIONS,
+	BENCH_METRIC_COUNT
+};
+
+enum benchmark_format{
+	BENCH_FORMAT_JSON,
+	BENCH_FORMAT_CSV
+};
+
+
+//benchmark functions
+struct benchmark create_benchmark(uint32_t warmup_frames, uint32_t measured_frames);
+void destroy_benchmark(struct benchmark *benchmark);
+void benchmark_record(struct benchmark *benchmark, enum benchmark_metric metric, double value);
+void benchmark_next_frame(struct benchmark *benchmark);
+bool benchmark_measuring(struct benchmark *benchmark);
+bool benchmark_finished(struct benchmark *benchmark);
+bool benchmark_report(struct benchmark *benchmark, const char *file_name, enum benchmark_format format);
+struct benchmark_summary benchmark_summarise_metric(struct benchmark *benchmark, enum benchmark_metric metric);
+bool parse_benchmark_format(const char *name, enum benchmark_format *format);
+
+
+
+//structs
+
+//samples holds measured_frames values per metric, a metric can have fewer samples than frames if it was not
+//available every frame so each one keeps its own count
+struct benchmark{
+	uint32_t warmup_frames;
+	uint32_t measured_frames;
+	uint32_t frames_seen;
+	double *samples[BENCH_METRIC_COUNT];
+	uint32_t sample_counts[BENCH_METRIC_COUNT];
+};
+
+//the summary written out for each metric
+struct benchmark_summary{
+	uint32_t count;
+	double min;
+	double mean;
+	double p50;
+	double p95;
+	double p99;
+	double max;
+};
@@ -0,0 +1,161 @@
+//plain old C headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+//GLFW header
+#define GLFW_INCLUDE_VULKAN
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include "host_allocator.h"
+#include "gpu_timer.h"
+#include "vulkan_helpers.h"
+#include "mesh.h"
+#include "draw_queue.h"
+#include "basic_helpers.h"
+
+//the radix sort goes over the key a byte at a time from the bottom up
+#define DRAW_SORT_DIGIT_BITS 8
+#define DRAW_SORT_PASSES (64 / DRAW_SORT_DIGIT_BITS)
+#define DRAW_SORT_BUCKETS (1 << DRAW_SORT_DIGIT_BITS)
+
+uint64_t make_draw_key(uint32_t pass, uint32_t pipeline, uint32_t set, uint32_t material, float depth){
+	//clamped first so a depth a little outside 0 to 1 lands at the ends instead of wrapping
+	depth = MIN(MAX(depth, 0.0f), 1.0f);
+	//in double as a float cant hold every 24 bit step and would round the top one over into the material
+	uint64_t depth_bits = (uint64_t)(depth * (double)((1u << DRAW_KEY_DEPTH_BITS) - 1) + 0.5);
+
+	uint64_t key = pass & ((1u << DRAW_KEY_PASS_BITS) - 1);
+	key = key << DRAW_KEY_PIPELINE_BITS | (pipeline & ((1u << DRAW_KEY_PIPELINE_BITS) - 1));
+	key = key << DRAW_KEY_SET_BITS | (set & ((1u << DRAW_KEY_SET_BITS) - 1));
+	key = key << DRAW_KEY_MATERIAL_BITS | (material & ((1u << DRAW_KEY_MATERIAL_BITS) - 1));
+	key = key << DRAW_KEY_DEPTH_BITS | depth_bits;
+	return key;
+}
+
+struct draw_queue create_draw_queue(uint32_t capacity){
+	struct draw_queue queue = {0};
+	queue.packets = malloc(sizeof *queue.packets * capacity);
+	queue.entries = malloc(sizeof *queue.entries * capacity);
+	queue.scratch = malloc(sizeof *queue.scratch * capacity);
+	if (!queue.packets || !queue.entries || !queue.scratch){
+		printf("Error: failed to allocate a draw queue of %u draws", capacity);
+		free(queue.packets);
+		free(queue.entries);
+		free(queue.scratch);
+		return (struct draw_queue){0};
+	}
+	queue.sorted = queue.entries;
+	queue.capacity = capacity;
+	return queue;
+}
+
+void destroy_draw_queue(struct draw_queue *queue){
+	free(queue->packets);
+	free(queue->entries);
+	free(queue->scratch);
+	*queue = (struct draw_queue){0};
+}
+
+void draw_queue_reset(struct draw_queue *queue){
+	queue->count = 0;
+	queue->sorted = queue->entries;
+}
+
+bool draw_queue_push(struct draw_queue *queue, const struct draw_packet *packet){
+	if (queue->count >= queue->capacity){
+		queue->dropped_draws++;
+		return false;
+	}
+	queue->packets[queue->count] = *packet;
+	queue->entries[queue->count] = (struct draw_sort_entry){.key = packet->key, .packet = queue->count};
+	queue->count++;
+	return true;
+}
+
+//least significant digit first, each pass is stable so the order the earlier passes set up survives the later ones
+//the histograms for every digit come out of one read of the keys, and a digit every key shares is skipped outright
+//which with most of the key being a handful of ids is most of them
+void draw_queue_sort(struct draw_queue *queue){
+	queue->sorted = queue->entries;
+	if (queue->count < 2)
+		return;
+
+	uint32_t histograms[DRAW_SORT_PASSES][DRAW_SORT_BUCKETS] = {0};
+	for (uint32_t i = 0; i < queue->count; i++){
+		uint64_t key = queue->entries[i].key;
+		for (uint32_t pass = 0; pass < DRAW_SORT_PASSES; pass++)
+			histograms[pass][(key >> (pass * DRAW_SORT_DIGIT_BITS)) & (DRAW_SORT_BUCKETS - 1)]++;
+	}
+
+	struct draw_sort_entry *from = queue->entries, *to = queue->scratch;
+	for (uint32_t pass = 0; pass < DRAW_SORT_PASSES; pass++){
+		uint32_t *histogram = histograms[pass];
+		uint32_t shift = pass * DRAW_SORT_DIGIT_BITS;
+		if (histogram[(from[0].key >> shift) & (DRAW_SORT_BUCKETS - 1)] == queue->count)
+			continue;
+
+		uint32_t offset = 0;
+		for (uint32_t b = 0; b < DRAW_SORT_BUCKETS; b++){
+			uint32_t count = histogram[b];
+			histogram[b] = offset;
+			offset += count;
+		}
+		for (uint32_t i = 0; i < queue->count; i++)
+			to[histogram[(from[i].key >> shift) & (DRAW_SORT_BUCKETS - 1)]++] = from[i];
+
+		struct draw_sort_entry *swap = from;
+		from = to;
+		to = swap;
+	}
+	queue->sorted = from;
+}
+
+//state is only tracked within one call, a command buffer starts with nothing bound so there is nothing to carry over
+void draw_queue_record(VkCommandBuffer command_buffer, struct draw_queue *queue){
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+	const struct mesh *mesh = NULL;
+
+	for (uint32_t i = 0; i < queue->count; i++){
+		const struct draw_packet *packet = &queue->packets[queue->sorted[i].packet];
+
+		if (packet->pipeline != pipeline){
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, packet->pipeline);
+			pipeline = packet->pipeline;
+			queue->pipeline_binds++;
+		} else {
+			queue->skipped_binds++;
+		}
+
+		//a different layout can disturb whatever sets and push constants were there, so both go again after one
+		bool layout_changed = packet->pipeline_layout != pipeline_layout;
+		pipeline_layout = packet->pipeline_layout;
+
+		if (packet->descriptor_set != VK_NULL_HANDLE){
+			if (layout_changed || packet->descriptor_set != descriptor_set){
+				vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &packet->descriptor_set, 0, NULL);
+				queue->set_binds++;
+			} else {
+				queue->skipped_binds++;
+			}
+		}
+		descriptor_set = packet->descriptor_set;
+
+		if (layout_changed || packet->mesh != mesh){
+			vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(struct position_transform), &packet->mesh->position_transform);
+			mesh_bind(command_buffer, packet->mesh, false);
+			mesh = packet->mesh;
+			queue->mesh_binds++;
+		} else {
+			queue->skipped_binds++;
+		}
+
+		mesh_draw(command_buffer, packet->mesh, packet->lod, packet->first_instance, packet->instance_count);
+		queue->draws++;
+	}
+}
@@ -0,0 +1,76 @@
+//forward declarations of structs defined further down that are passed around by pointer
+struct draw_queue;
+struct draw_packet;
+struct mesh;
+
+//how the 64 bit sort key is split, from the top bit down, so sorting orders by pass first and depth last
+//pipeline, set and material are small ids the caller hands out, not vulkan handles
+#define DRAW_KEY_PASS_BITS 4
+#define DRAW_KEY_PIPELINE_BITS 12
+#define DRAW_KEY_SET_BITS 12
+#define DRAW_KEY_MATERIAL_BITS 12
+#define DRAW_KEY_DEPTH_BITS 24
+//how many draws a queue takes per frame, anything past it is dropped and counted
+#define DRAW_QUEUE_CAPACITY 4096
+
+//enums
+
+//passes in the order they are recorded
+enum draw_pass{
+	DRAW_PASS_MAIN,
+	DRAW_PASS_COUNT
+};
+
+//functions
+
+//depth is 0 to 1 with nearer first, pass 1 - depth instead for back to front, fields too big for their bits are masked
+uint64_t make_draw_key(uint32_t pass, uint32_t pipeline, uint32_t set, uint32_t material, float depth);
+
+//draw queue functions, push draws in any order, sort them and record them with every redundant bind skipped
+struct draw_queue create_draw_queue(uint32_t capacity);
+void destroy_draw_queue(struct draw_queue *queue);
+void draw_queue_reset(struct draw_queue *queue);
+bool draw_queue_push(struct draw_queue *queue, const struct draw_packet *packet);
+void draw_queue_sort(struct draw_queue *queue);
+void draw_queue_record(VkCommandBuffer command_buffer, struct draw_queue *queue);
+
+
+//structs
+
+//everything one draw needs, the key decides the order and the rest is what gets bound and drawn
+//descriptor_set can be VK_NULL_HANDLE for pipelines without one, the mesh's position transform is pushed when the mesh changes
+struct draw_packet{
+	uint64_t key;
+	VkPipeline pipeline;
+	VkPipelineLayout pipeline_layout;
+	VkDescriptorSet descriptor_set;
+	const struct mesh *mesh;
+	uint32_t lod;
+	uint32_t first_instance;
+	uint32_t instance_count;
+};
+
+//what the radix sort moves around, the packets themselves stay where they were pushed
+struct draw_sort_entry{
+	uint64_t key;
+	uint32_t packet;
+};
+
+//the packets and two arrays of sort entries for the radix sort to go back and forth between, allocated once up front
+//sorted points at whichever of the two holds the order after draw_queue_sort
+struct draw_queue{
+	struct draw_packet *packets;
+	struct draw_sort_entry *entries;
+	struct draw_sort_entry *scratch;
+	struct draw_sort_entry *sorted;
+	uint32_t count;
+	uint32_t capacity;
+
+	//totals over the queue's life, for seeing how much state sorting saves
+	uint64_t draws;
+	uint64_t pipeline_binds;
+	uint64_t set_binds;
+	uint64_t mesh_binds;
+	uint64_t skipped_binds;
+	uint64_t dropped_draws;
+};
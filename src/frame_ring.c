@@ -0,0 +1,88 @@
+//plain old C headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+//GLFW header
+#define GLFW_INCLUDE_VULKAN
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include "host_allocator.h"
+#include "gpu_timer.h"
+#include "vulkan_helpers.h"
+#include "frame_ring.h"
+
+//everything per frame data is used for, so one ring can feed all of them
+#define FRAME_RING_USAGE (VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | \
+	VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT)
+
+struct frame_ring create_frame_ring(VkPhysicalDevice physical_device, VkDevice device, struct gpu_allocator *allocator, VkDeviceSize region_size, int frames_in_flight){
+	struct frame_ring ring = {0};
+	ring.frames_in_flight = frames_in_flight;
+
+	VkPhysicalDeviceProperties properties = get_device_capabilities(physical_device, VK_NULL_HANDLE)->properties;
+	ring.min_uniform_alignment = MAX(properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment);
+
+	//regions start on a uniform aligned boundary so offsets within one line up the same way in every region
+	ring.region_size = (region_size + ring.min_uniform_alignment - 1) / ring.min_uniform_alignment * ring.min_uniform_alignment;
+
+	VkBufferCreateInfo create_info = {0};
+	create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	create_info.size = ring.region_size * frames_in_flight;
+	create_info.usage = FRAME_RING_USAGE;
+	create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &create_info, HOST_ALLOCATOR, &ring.buffer) != VK_SUCCESS){
+		printf("Error: failed to create frame ring buffer");
+		return ring;
+	}
+
+	//coherent so writes never need flushing, device local is preferred for the bar heap on discrete cards
+	ring.allocation = gpu_allocate_buffer(device, allocator, ring.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if (!ring.allocation.mapped){
+		printf("Error: failed to allocate mapped frame ring memory");
+		return ring;
+	}
+	ring.mapped = ring.allocation.mapped;
+
+	return ring;
+}
+
+void destroy_frame_ring(VkDevice device, struct frame_ring *ring){
+	vkDestroyBuffer(device, ring->buffer, HOST_ALLOCATOR);
+	gpu_free(device, &ring->allocation);
+}
+
+void frame_ring_begin(struct frame_ring *ring, int slot){
+	ring->slot = slot;
+	ring->head = 0;
+}
+
+struct frame_ring_allocation frame_ring_allocate(struct frame_ring *ring, VkDeviceSize size, VkDeviceSize alignment){
+	struct frame_ring_allocation allocation = {0};
+	allocation.buffer = ring->buffer;
+
+	//vulkan alignments are all powers of two
+	if (alignment < 1)
+		alignment = 1;
+	VkDeviceSize start = (ring->head + alignment - 1) & ~(alignment - 1);
+	if (!ring->mapped || start + size > ring->region_size){
+		ring->failed_allocations++;
+		return allocation;
+	}
+
+	ring->head = start + size;
+	ring->high_water = MAX(ring->high_water, ring->head);
+
+	allocation.offset = ring->region_size * ring->slot + start;
+	allocation.data = ring->mapped + allocation.offset;
+	allocation.size = size;
+	return allocation;
+}
+
+struct frame_ring_allocation frame_ring_allocate_uniform(struct frame_ring *ring, VkDeviceSize size){
+	return frame_ring_allocate(ring, size, ring->min_uniform_alignment);
+}
@@ -0,0 +1,36 @@
+//frame ring functions
+struct frame_ring create_frame_ring(VkPhysicalDevice physical_device, VkDevice device, struct gpu_allocator *allocator, VkDeviceSize region_size, int frames_in_flight);
+void destroy_frame_ring(VkDevice device, struct frame_ring *ring);
+void frame_ring_begin(struct frame_ring *ring, int slot);
+struct frame_ring_allocation frame_ring_allocate(struct frame_ring *ring, VkDeviceSize size, VkDeviceSize alignment);
+struct frame_ring_allocation frame_ring_allocate_uniform(struct frame_ring *ring, VkDeviceSize size);
+
+
+//structs
+
+//a piece of this frame's region, write through data and bind buffer at offset, data is NULL when the region is full
+struct frame_ring_allocation{
+	void *data;
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+};
+
+//one host visible buffer mapped for its whole life and split into a region per frame in flight
+//a region is only rewound in frame_ring_begin, which the draw functions call after waiting for the frame that last
+//used the slot, so nothing the gpu may still be reading is ever overwritten and nothing is allocated or mapped per frame
+struct frame_ring{
+	VkBuffer buffer;
+	struct gpu_allocation allocation;
+	unsigned char *mapped;
+	VkDeviceSize region_size;
+	int frames_in_flight;
+	VkDeviceSize min_uniform_alignment;
+
+	//the region being filled and how far into it we are
+	int slot;
+	VkDeviceSize head;
+	//the most any frame has used, for sizing the regions, and how many allocations didnt fit
+	VkDeviceSize high_water;
+	uint64_t failed_allocations;
+};
@@ -0,0 +1,239 @@
+//plain old C headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+//GLFW header
+#define GLFW_INCLUDE_VULKAN
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include "host_allocator.h"
+#include "gpu_timer.h"
+#include "vulkan_helpers.h"
+
+#define QUERIES_PER_SLOT (GPU_TIMER_MAX_REGIONS * 2)
+
+//every counter in struct gpu_pipeline_statistics, the results come back in flag bit order
+#define STATISTICS_FLAGS (VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT | \
+	VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT | \
+	VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | \
+	VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT | \
+	VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | \
+	VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT)
+#define STATISTICS_COUNTERS 6
+
+static void create_statistics_pool(VkDevice device, struct gpu_timer *timer){
+	VkQueryPoolCreateInfo create_info = {0};
+	create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	create_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+	create_info.queryCount = GPU_TIMER_MAX_REGIONS * timer->frames_in_flight;
+	create_info.pipelineStatistics = STATISTICS_FLAGS;
+
+	if (vkCreateQueryPool(device, &create_info, HOST_ALLOCATOR, &timer->statistics_pool) != VK_SUCCESS){
+		printf("Error: failed to create pipeline statistics query pool");
+		return;
+	}
+
+	timer->statistics_supported = true;
+}
+
+struct gpu_timer create_gpu_timer(VkPhysicalDevice physical_device, VkDevice device, uint32_t queue_family, int frames_in_flight, bool pipeline_statistics){
+	struct gpu_timer timer = {0};
+	timer.frames_in_flight = frames_in_flight;
+	timer.open_statistics_region = -1;
+
+	const struct device_capabilities *capabilities = get_device_capabilities(physical_device, VK_NULL_HANDLE);
+	VkPhysicalDeviceProperties properties = capabilities->properties;
+	uint32_t valid_bits = queue_family < capabilities->queue_family_count ? capabilities->queue_families[queue_family].timestampValidBits : 0;
+
+	//a queue that writes no valid bits cant do timestamps at all, everything below then becomes a no-op
+	if (valid_bits == 0 || properties.limits.timestampPeriod == 0.0f){
+		printf("GPU timestamps are not supported on this queue\n");
+		return timer;
+	}
+
+	timer.timestamp_period = properties.limits.timestampPeriod;
+	timer.timestamp_mask = valid_bits >= 64 ? UINT64_MAX : ((1ull << valid_bits) - 1);
+
+	VkQueryPoolCreateInfo create_info = {0};
+	create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	create_info.queryCount = QUERIES_PER_SLOT * frames_in_flight;
+
+	if (vkCreateQueryPool(device, &create_info, HOST_ALLOCATOR, &timer.query_pool) != VK_SUCCESS){
+		printf("Error: failed to create timestamp query pool");
+		return timer;
+	}
+
+	timer.slot_frames = calloc(frames_in_flight, sizeof *timer.slot_frames);
+	timer.slot_region_counts = calloc(frames_in_flight, sizeof *timer.slot_region_counts);
+	timer.slot_region_names = calloc((size_t)frames_in_flight * GPU_TIMER_MAX_REGIONS, sizeof *timer.slot_region_names);
+	timer.slot_region_has_statistics = calloc((size_t)frames_in_flight * GPU_TIMER_MAX_REGIONS, sizeof *timer.slot_region_has_statistics);
+	if (!timer.slot_frames || !timer.slot_region_counts || !timer.slot_region_names || !timer.slot_region_has_statistics){
+		printf("Error: failed to allocate gpu timer slots");
+		return timer;
+	}
+
+	//statistics ride along with the timestamp regions so they are only there when timestamps are
+	if (pipeline_statistics)
+		create_statistics_pool(device, &timer);
+
+	timer.supported = true;
+	return timer;
+}
+
+void destroy_gpu_timer(VkDevice device, struct gpu_timer *timer){
+	if (timer->query_pool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(device, timer->query_pool, HOST_ALLOCATOR);
+	if (timer->statistics_pool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(device, timer->statistics_pool, HOST_ALLOCATOR);
+
+	free(timer->slot_frames);
+	free(timer->slot_region_counts);
+	free(timer->slot_region_names);
+	free(timer->slot_region_has_statistics);
+}
+
+void gpu_timer_begin_frame(VkCommandBuffer command_buffer, struct gpu_timer *timer, int slot, uint64_t frame_value){
+	if (!timer->supported) return;
+
+	//queries have to be reset before being written again and this has to happen outside a render pass
+	vkCmdResetQueryPool(command_buffer, timer->query_pool, slot * QUERIES_PER_SLOT, QUERIES_PER_SLOT);
+	if (timer->statistics_supported)
+		vkCmdResetQueryPool(command_buffer, timer->statistics_pool, slot * GPU_TIMER_MAX_REGIONS, GPU_TIMER_MAX_REGIONS);
+
+	timer->slot_frames[slot] = frame_value;
+	timer->slot_region_counts[slot] = 0;
+	timer->open_statistics_region = -1;
+}
+
+int gpu_timer_begin_region(VkCommandBuffer command_buffer, struct gpu_timer *timer, int slot, const char *name){
+	if (!timer->supported || timer->slot_region_counts[slot] >= GPU_TIMER_MAX_REGIONS)
+		return -1;
+
+	int region = timer->slot_region_counts[slot]++;
+	timer->slot_region_names[slot * GPU_TIMER_MAX_REGIONS + region] = name;
+
+	//top of pipe is written as soon as the region is reached, so the difference to bottom of pipe covers all its work
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timer->query_pool, slot * QUERIES_PER_SLOT + region * 2);
+
+	bool statistics = timer->statistics_supported && timer->open_statistics_region < 0;
+	timer->slot_region_has_statistics[slot * GPU_TIMER_MAX_REGIONS + region] = statistics;
+	if (statistics){
+		vkCmdBeginQuery(command_buffer, timer->statistics_pool, slot * GPU_TIMER_MAX_REGIONS + region, 0);
+		timer->open_statistics_region = region;
+	}
+	return region;
+}
+
+void gpu_timer_end_region(VkCommandBuffer command_buffer, struct gpu_timer *timer, int slot, int region){
+	if (!timer->supported || region < 0) return;
+
+	if (timer->open_statistics_region == region){
+		vkCmdEndQuery(command_buffer, timer->statistics_pool, slot * GPU_TIMER_MAX_REGIONS + region);
+		timer->open_statistics_region = -1;
+	}
+
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timer->query_pool, slot * QUERIES_PER_SLOT + region * 2 + 1);
+}
+
+//reads the statistics of every region that had a query, false if any of them is not ready yet
+static bool collect_statistics(VkDevice device, struct gpu_timer *timer, int slot, int region_count, struct gpu_frame_timings *timings){
+	//each query is the counters followed by its availability, regions that never began a query stay unavailable
+	uint64_t results[GPU_TIMER_MAX_REGIONS * (STATISTICS_COUNTERS + 1)];
+	VkResult result = vkGetQueryPoolResults(device, timer->statistics_pool, slot * GPU_TIMER_MAX_REGIONS, region_count, sizeof results, results, sizeof(uint64_t) * (STATISTICS_COUNTERS + 1), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	if (result != VK_SUCCESS && result != VK_NOT_READY)
+		return false;
+
+	struct gpu_pipeline_statistics total = {0};
+	for (int i = 0; i < region_count; i++){
+		if (!timer->slot_region_has_statistics[slot * GPU_TIMER_MAX_REGIONS + i])
+			continue;
+
+		uint64_t *counters = &results[i * (STATISTICS_COUNTERS + 1)];
+		if (counters[STATISTICS_COUNTERS] == 0)
+			return false;
+
+		struct gpu_pipeline_statistics *region = &timings->region_statistics[i];
+		region->input_assembly_vertices = counters[0];
+		region->input_assembly_primitives = counters[1];
+		region->vertex_shader_invocations = counters[2];
+		region->clipping_invocations = counters[3];
+		region->clipping_primitives = counters[4];
+		region->fragment_shader_invocations = counters[5];
+
+		total.input_assembly_vertices += region->input_assembly_vertices;
+		total.input_assembly_primitives += region->input_assembly_primitives;
+		total.vertex_shader_invocations += region->vertex_shader_invocations;
+		total.clipping_invocations += region->clipping_invocations;
+		total.clipping_primitives += region->clipping_primitives;
+		total.fragment_shader_invocations += region->fragment_shader_invocations;
+	}
+
+	timings->statistics = total;
+	timings->has_statistics = true;
+	return true;
+}
+
+bool gpu_timer_collect(VkDevice device, struct gpu_timer *timer, int slot){
+	if (!timer->supported || timer->slot_frames[slot] == 0 || timer->slot_region_counts[slot] == 0)
+		return false;
+
+	int region_count = timer->slot_region_counts[slot];
+	int query_count = region_count * 2;
+
+	//each query comes back as a value followed by its availability, without WAIT_BIT this never blocks
+	uint64_t results[QUERIES_PER_SLOT * 2];
+	VkResult result = vkGetQueryPoolResults(device, timer->query_pool, slot * QUERIES_PER_SLOT, query_count, sizeof results, results, sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	if (result != VK_SUCCESS && result != VK_NOT_READY)
+		return false;
+
+	for (int i = 0; i < query_count; i++){
+		if (results[i * 2 + 1] == 0)
+			return false;
+	}
+
+	struct gpu_frame_timings timings = {0};
+	timings.frame = timer->slot_frames[slot];
+	timings.region_count = region_count;
+
+	uint64_t first = UINT64_MAX;
+	uint64_t last = 0;
+	for (int i = 0; i < region_count; i++){
+		uint64_t begin = results[i * 4] & timer->timestamp_mask;
+		uint64_t end = results[i * 4 + 2] & timer->timestamp_mask;
+		//a masked counter can wrap between the two writes, unsigned subtraction then the mask still gives the right delta
+		uint64_t ticks = (end - begin) & timer->timestamp_mask;
+
+		timings.region_names[i] = timer->slot_region_names[slot * GPU_TIMER_MAX_REGIONS + i];
+		timings.region_ms[i] = ticks * timer->timestamp_period / 1e6;
+
+		if (begin < first) first = begin;
+		if (end > last) last = end;
+	}
+	timings.total_ms = last >= first ? (last - first) * timer->timestamp_period / 1e6 : 0.0;
+
+	if (timer->statistics_supported && !collect_statistics(device, timer, slot, region_count, &timings))
+		return false;
+
+	//only newer frames replace the latest result, slots can be collected out of order around a swap chain rebuild
+	if (!timer->has_latest || timings.frame > timer->latest.frame){
+		timer->latest = timings;
+		timer->has_latest = true;
+	}
+
+	//stop the same results being reported twice
+	timer->slot_region_counts[slot] = 0;
+	return true;
+}
+
+bool gpu_timer_latest(struct gpu_timer *timer, struct gpu_frame_timings *timings){
+	if (!timer->has_latest)
+		return false;
+
+	*timings = timer->latest;
+	return true;
+}
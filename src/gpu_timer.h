@@ -0,0 +1,70 @@
+//forward declarations of structs defined further down that are passed around by pointer
+struct gpu_timer;
+struct gpu_frame_timings;
+
+//gpu timer functions
+struct gpu_timer create_gpu_timer(VkPhysicalDevice physical_device, VkDevice device, uint32_t queue_family, int frames_in_flight, bool pipeline_statistics);
+void destroy_gpu_timer(VkDevice device, struct gpu_timer *timer);
+void gpu_timer_begin_frame(VkCommandBuffer command_buffer, struct gpu_timer *timer, int slot, uint64_t frame_value);
+int gpu_timer_begin_region(VkCommandBuffer command_buffer, struct gpu_timer *timer, int slot, const char *name);
+void gpu_timer_end_region(VkCommandBuffer command_buffer, struct gpu_timer *timer, int slot, int region);
+bool gpu_timer_collect(VkDevice device, struct gpu_timer *timer, int slot);
+bool gpu_timer_latest(struct gpu_timer *timer, struct gpu_frame_timings *timings);
+
+
+//structs
+
+//the most regions one frame can time, each region takes two queries
+#define GPU_TIMER_MAX_REGIONS 8
+
+//the pipeline statistics counters we ask for, in the order vulkan writes them which is by flag bit
+struct gpu_pipeline_statistics{
+	uint64_t input_assembly_vertices;
+	uint64_t input_assembly_primitives;
+	uint64_t vertex_shader_invocations;
+	uint64_t clipping_invocations;
+	uint64_t clipping_primitives;
+	uint64_t fragment_shader_invocations;
+};
+
+//the results for one completed frame, region names point at the strings passed to gpu_timer_begin_region
+struct gpu_frame_timings{
+	uint64_t frame;
+	int region_count;
+	const char *region_names[GPU_TIMER_MAX_REGIONS];
+	double region_ms[GPU_TIMER_MAX_REGIONS];
+	//from the first region starting to the last one ending
+	double total_ms;
+
+	//only filled in when pipeline statistics are enabled, a nested region has no counters of its own
+	//as its parent already covers it, so the frame totals are just the sum of the regions
+	bool has_statistics;
+	struct gpu_pipeline_statistics region_statistics[GPU_TIMER_MAX_REGIONS];
+	struct gpu_pipeline_statistics statistics;
+};
+
+//one query pool split into a set of 2 * GPU_TIMER_MAX_REGIONS queries per frame in flight
+//a set is only rewritten once the frame that used it has completed, so reading it back never stalls
+struct gpu_timer{
+	bool supported;
+	VkQueryPool query_pool;
+	int frames_in_flight;
+	//nanoseconds per timestamp tick and the mask of bits the queue actually writes
+	double timestamp_period;
+	uint64_t timestamp_mask;
+
+	//one pipeline statistics query per region per frame in flight, needs the pipelineStatisticsQuery feature
+	bool statistics_supported;
+	VkQueryPool statistics_pool;
+	//only one statistics query can be active at a time so nested regions dont get one, -1 when none is open
+	int open_statistics_region;
+
+	//per slot bookkeeping of what the last recorded frame wrote
+	uint64_t *slot_frames;
+	int *slot_region_counts;
+	const char **slot_region_names;
+	bool *slot_region_has_statistics;
+
+	bool has_latest;
+	struct gpu_frame_timings latest;
+};
@@ -0,0 +1,280 @@
+//plain old C headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <vulkan/vulkan.h>
+
+#include "host_allocator.h"
+
+//every allocation is prefixed by a header so free knows where it came from, the pools hand out chunks of
+//64 << class bytes carved from 64KB slabs, bigger allocations go straight to malloc
+#define HOST_CLASS_COUNT 7
+#define HOST_MIN_CHUNK 64
+#define HOST_SLAB_SIZE (64 * 1024)
+#define HOST_CLASS_LARGE HOST_CLASS_COUNT
+#define HOST_CLASS_ARENA (HOST_CLASS_COUNT + 1)
+
+//command scope allocations only live for the one vulkan call that made them so they are bump allocated from an
+//arena which goes back to the start whenever nothing in it is live any more
+#define HOST_ARENA_SIZE (256 * 1024)
+
+struct allocation_header{
+	uint64_t size;
+	uint32_t size_class;
+	uint32_t scope;
+	//from the start of the chunk to the pointer handed out
+	uint32_t offset;
+	uint32_t padding;
+};
+
+struct slab{
+	struct slab *next;
+};
+
+//vulkan may call back from any thread that makes vulkan calls so everything below is behind one spin lock,
+//the critical sections are a few pointer swaps
+static atomic_flag host_lock = ATOMIC_FLAG_INIT;
+static void *free_chunks[HOST_CLASS_COUNT];
+static struct slab *slabs = NULL;
+static unsigned char *arena = NULL;
+static size_t arena_offset = 0;
+static uint64_t arena_live = 0;
+static struct host_allocator_stats stats = {0};
+
+static void lock(){
+	while (atomic_flag_test_and_set_explicit(&host_lock, memory_order_acquire))
+		;
+}
+
+static void unlock(){
+	atomic_flag_clear_explicit(&host_lock, memory_order_release);
+}
+
+static uint32_t scope_index(VkSystemAllocationScope scope){
+	return (uint32_t)scope < HOST_SCOPE_COUNT ? (uint32_t)scope : VK_SYSTEM_ALLOCATION_SCOPE_OBJECT;
+}
+
+//takes a chunk off the class free list, carving a new slab into chunks when the list is empty
+//called and returns with the lock held, but drops it over the slab malloc so other threads arent left spinning on it
+static void *pool_take(uint32_t size_class){
+	if (!free_chunks[size_class]){
+		unlock();
+		struct slab *slab = malloc(HOST_SLAB_SIZE);
+		lock();
+		if (!slab)
+			return NULL;
+		//another thread may have filled the list while the lock was dropped, the new slab's chunks just go on top
+		slab->next = slabs;
+		slabs = slab;
+		stats.slab_bytes += HOST_SLAB_SIZE;
+
+		//the first chunk is given up to hold the slab link, the rest go on the free list
+		size_t chunk_size = (size_t)HOST_MIN_CHUNK << size_class;
+		for (size_t offset = chunk_size; offset + chunk_size <= HOST_SLAB_SIZE; offset += chunk_size){
+			void **chunk = (void **)((unsigned char *)slab + offset);
+			*chunk = free_chunks[size_class];
+			free_chunks[size_class] = chunk;
+		}
+	}
+
+	void **chunk = free_chunks[size_class];
+	if (chunk)
+		free_chunks[size_class] = *chunk;
+	return chunk;
+}
+
+static void *VKAPI_CALL host_allocate(void *user_data, size_t size, size_t alignment, VkSystemAllocationScope scope){
+	(void)user_data;
+	if (size == 0)
+		return NULL;
+
+	if (alignment < 16)
+		alignment = 16;
+	//room for the header plus the worst case of lining the pointer up after it
+	size_t needed = size + sizeof(struct allocation_header) + alignment;
+
+	lock();
+
+	unsigned char *base = NULL;
+	uint32_t size_class = HOST_CLASS_LARGE;
+	if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND && arena && arena_offset + needed <= HOST_ARENA_SIZE){
+		base = arena + arena_offset;
+		arena_offset += (needed + 15) & ~(size_t)15;
+		arena_live++;
+		size_class = HOST_CLASS_ARENA;
+		stats.arena++;
+	} else {
+		for (uint32_t i = 0; i < HOST_CLASS_COUNT; i++){
+			if (((size_t)HOST_MIN_CHUNK << i) >= needed){
+				size_class = i;
+				break;
+			}
+		}
+
+		if (size_class < HOST_CLASS_COUNT){
+			base = pool_take(size_class);
+			if (base)
+				stats.pooled++;
+		}
+	}
+
+	if (!base){
+		//malloc is thread safe and slow, no reason to hold the lock over it
+		unlock();
+		base = malloc(needed);
+		if (!base)
+			return NULL;
+		size_class = HOST_CLASS_LARGE;
+		lock();
+		stats.large++;
+	}
+
+	uintptr_t aligned = ((uintptr_t)base + sizeof(struct allocation_header) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	struct allocation_header *header = (struct allocation_header *)aligned - 1;
+	header->size = size;
+	header->size_class = size_class;
+	header->scope = scope_index(scope);
+	header->offset = (uint32_t)(aligned - (uintptr_t)base);
+
+	struct host_scope_stats *s = &stats.scopes[header->scope];
+	s->allocations++;
+	s->total_bytes += size;
+	s->live_bytes += size;
+	if (s->live_bytes > s->peak_bytes)
+		s->peak_bytes = s->live_bytes;
+
+	unlock();
+	return (void *)aligned;
+}
+
+static void VKAPI_CALL host_free(void *user_data, void *memory){
+	(void)user_data;
+	if (!memory)
+		return;
+
+	struct allocation_header *header = (struct allocation_header *)memory - 1;
+	unsigned char *base = (unsigned char *)memory - header->offset;
+
+	lock();
+	struct host_scope_stats *s = &stats.scopes[header->scope];
+	s->frees++;
+	s->live_bytes -= header->size;
+
+	if (header->size_class < HOST_CLASS_COUNT){
+		void **chunk = (void **)base;
+		*chunk = free_chunks[header->size_class];
+		free_chunks[header->size_class] = chunk;
+	} else if (header->size_class == HOST_CLASS_ARENA){
+		if (--arena_live == 0)
+			arena_offset = 0;
+	}
+	unlock();
+
+	if (header->size_class == HOST_CLASS_LARGE)
+		free(base);
+}
+
+static void *VKAPI_CALL host_reallocate(void *user_data, void *original, size_t size, size_t alignment, VkSystemAllocationScope scope){
+	if (!original)
+		return host_allocate(user_data, size, alignment, scope);
+	if (size == 0){
+		host_free(user_data, original);
+		return NULL;
+	}
+
+	//a chunk is never grown in place, the copy is cheap next to what the driver does with it
+	struct allocation_header *header = (struct allocation_header *)original - 1;
+	void *memory = host_allocate(user_data, size, alignment, scope);
+	if (!memory)
+		return NULL;
+
+	memcpy(memory, original, header->size < size ? header->size : size);
+
+	lock();
+	stats.scopes[scope_index(scope)].reallocations++;
+	//the new allocation was counted as one, a reallocation isnt
+	stats.scopes[scope_index(scope)].allocations--;
+	unlock();
+
+	host_free(user_data, original);
+	return memory;
+}
+
+static void VKAPI_CALL host_internal_allocation(void *user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope){
+	(void)user_data;
+	(void)size;
+	(void)type;
+	lock();
+	stats.scopes[scope_index(scope)].internal_allocations++;
+	unlock();
+}
+
+static void VKAPI_CALL host_internal_free(void *user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope){
+	(void)user_data;
+	(void)size;
+	(void)type;
+	lock();
+	stats.scopes[scope_index(scope)].internal_frees++;
+	unlock();
+}
+
+static const VkAllocationCallbacks callbacks = {
+	.pUserData = NULL,
+	.pfnAllocation = host_allocate,
+	.pfnReallocation = host_reallocate,
+	.pfnFree = host_free,
+	.pfnInternalAllocation = host_internal_allocation,
+	.pfnInternalFree = host_internal_free
+};
+
+const VkAllocationCallbacks *host_allocator_callbacks(){
+	//the arena is set up on first use, if it cant be then command scope just uses the pools
+	lock();
+	if (!arena)
+		arena = malloc(HOST_ARENA_SIZE);
+	unlock();
+	return &callbacks;
+}
+
+struct host_allocator_stats get_host_allocator_stats(){
+	lock();
+	struct host_allocator_stats copy = stats;
+	unlock();
+	return copy;
+}
+
+void print_host_allocator_stats(){
+	static const char *scope_names[HOST_SCOPE_COUNT] = {"command", "object", "cache", "device", "instance"};
+	struct host_allocator_stats s = get_host_allocator_stats();
+
+	printf("Host allocations: %llu pooled, %llu arena, %llu large, %.2f KB of slabs\n",
+		(unsigned long long)s.pooled, (unsigned long long)s.arena, (unsigned long long)s.large, s.slab_bytes / 1024.0);
+	for (int i = 0; i < HOST_SCOPE_COUNT; i++){
+		struct host_scope_stats *scope = &s.scopes[i];
+		printf("\t%-8s %llu allocs %llu reallocs %llu frees %llu internal, %llu bytes total %llu peak %llu live\n", scope_names[i],
+			(unsigned long long)scope->allocations, (unsigned long long)scope->reallocations, (unsigned long long)scope->frees,
+			(unsigned long long)scope->internal_allocations, (unsigned long long)scope->total_bytes,
+			(unsigned long long)scope->peak_bytes, (unsigned long long)scope->live_bytes);
+	}
+}
+
+//only safe once everything made with the callbacks is gone, which for us is after vkDestroyInstance
+void destroy_host_allocator(){
+	lock();
+	while (slabs){
+		struct slab *next = slabs->next;
+		free(slabs);
+		slabs = next;
+	}
+	for (int i = 0; i < HOST_CLASS_COUNT; i++){
+		free_chunks[i] = NULL;
+	}
+	free(arena);
+	arena = NULL;
+	arena_offset = 0;
+	unlock();
+}
@@ -0,0 +1,47 @@
+//host allocator functions
+const VkAllocationCallbacks *host_allocator_callbacks();
+struct host_allocator_stats get_host_allocator_stats();
+void print_host_allocator_stats();
+void destroy_host_allocator();
+
+
+//structs
+
+//how many VkSystemAllocationScope values there are, command through instance
+#define HOST_SCOPE_COUNT 5
+
+//what the driver asked for in one allocation scope, internal allocations are the ones the driver made itself and only told us about
+struct host_scope_stats{
+	uint64_t allocations;
+	uint64_t reallocations;
+	uint64_t frees;
+	uint64_t internal_allocations;
+	uint64_t internal_frees;
+	uint64_t live_bytes;
+	uint64_t peak_bytes;
+	uint64_t total_bytes;
+};
+
+//where the allocations were served from, pooled ones never reach malloc once their slab exists
+struct host_allocator_stats{
+	struct host_scope_stats scopes[HOST_SCOPE_COUNT];
+	uint64_t pooled;
+	uint64_t arena;
+	uint64_t large;
+	uint64_t slab_bytes;
+};
+
+
+//macros
+
+//build with -DHOST_ALLOCATOR_ENABLED=0 to hand vulkan NULL callbacks and use the driver's own allocator again
+#ifndef HOST_ALLOCATOR_ENABLED
+	#define HOST_ALLOCATOR_ENABLED 1
+#endif
+
+//pass this wherever vulkan takes a const VkAllocationCallbacks *, create and destroy have to use the same one
+#if HOST_ALLOCATOR_ENABLED
+	#define HOST_ALLOCATOR host_allocator_callbacks()
+#else
+	#define HOST_ALLOCATOR NULL
+#endif
@@ -0,0 +1,134 @@
+//plain old C headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+//GLFW header
+#define GLFW_INCLUDE_VULKAN
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include "host_allocator.h"
+#include "gpu_timer.h"
+#include "vulkan_helpers.h"
+#include "frame_ring.h"
+#include "upload_manager.h"
+#include "mesh.h"
+#include "instancing.h"
+#include "draw_queue.h"
+#include "basic_helpers.h"
+
+uint32_t vertex_layout_add_instances(struct vertex_layout *layout){
+	uint32_t binding = vertex_layout_add_binding(layout, VK_VERTEX_INPUT_RATE_INSTANCE);
+	vertex_layout_add_attribute(layout, binding, INSTANCE_TRANSFORM_LOCATION, VK_FORMAT_R32G32B32A32_SFLOAT);
+	vertex_layout_add_attribute(layout, binding, INSTANCE_COLOR_LOCATION, VK_FORMAT_R8G8B8A8_UNORM);
+	vertex_layout_add_attribute(layout, binding, INSTANCE_ID_LOCATION, VK_FORMAT_R32_UINT);
+	return binding;
+}
+
+//a bright colour per id that neighbours dont share, a single instance stays white so it looks like it always did
+static uint32_t instance_color(uint32_t id, uint32_t count){
+	if (count == 1)
+		return 0xFFFFFFFFu;
+	uint32_t hash = id * 2654435761u;
+	uint32_t r = 96 + (hash & 0x9F), g = 96 + ((hash >> 8) & 0x9F), b = 96 + ((hash >> 16) & 0x9F);
+	return r | g << 8 | b << 16 | 0xFFu << 24;
+}
+
+struct instance_set create_instance_grid(uint32_t count){
+	struct instance_set set = {0};
+	if (count == 0)
+		return set;
+
+	set.instances = malloc(sizeof *set.instances * count);
+	set.lods = calloc(count, sizeof *set.lods);
+	if (!set.instances || !set.lods){
+		printf("Error: failed to allocate %u instances", count);
+		free(set.instances);
+		free(set.lods);
+		return (struct instance_set){0};
+	}
+	set.count = count;
+
+	//meshes are drawn in -1 to 1 so each one is shrunk to its cell of a square grid just big enough for them all
+	uint32_t side = (uint32_t)ceil(sqrt((double)count));
+	while (side * side < count)
+		side++;
+	float cell = 2.0f / side;
+	for (uint32_t i = 0; i < count; i++){
+		struct instance_data *instance = &set.instances[i];
+		instance->transform[0] = -1.0f + cell * (i % side + 0.5f);
+		instance->transform[1] = -1.0f + cell * (i / side + 0.5f);
+		instance->transform[2] = 0.0f;
+		instance->transform[3] = 1.0f / side;
+		instance->color = instance_color(i, count);
+		instance->id = i;
+	}
+	return set;
+}
+
+void destroy_instance_set(struct instance_set *set){
+	free(set->instances);
+	free(set->lods);
+	*set = (struct instance_set){0};
+}
+
+bool bind_instances(VkCommandBuffer command_buffer, const struct instance_set *set, struct frame_ring *ring, uint32_t binding, uint32_t count){
+	count = MIN(count, set->count);
+	struct frame_ring_allocation allocation = frame_ring_allocate(ring, sizeof(struct instance_data) * (count ? count : 1), 16);
+	if (!allocation.data)
+		return false;
+
+	memcpy(allocation.data, set->instances, sizeof(struct instance_data) * count);
+	vkCmdBindVertexBuffers(command_buffer, binding, 1, &allocation.buffer, &allocation.offset);
+	return true;
+}
+
+uint32_t queue_instances(VkCommandBuffer command_buffer, struct instance_set *set, const struct mesh *mesh, struct frame_ring *ring, uint32_t binding, float pixels_per_unit, float error_pixels, struct draw_queue *queue, const struct draw_packet *base){
+	set->draw_count = 0;
+	if (set->count == 0)
+		return 0;
+
+	struct frame_ring_allocation allocation = frame_ring_allocate(ring, sizeof(struct instance_data) * set->count, 16);
+	if (!allocation.data)
+		return 0;
+
+	//instances are grouped by level so each level is one draw of a contiguous run, whatever order they are in
+	uint32_t lod_starts[MESH_MAX_LODS] = {0};
+	for (uint32_t i = 0; i < set->count; i++){
+		set->lods[i] = (uint8_t)select_mesh_lod(mesh, pixels_per_unit * set->instances[i].transform[3], error_pixels, set->lods[i]);
+		lod_starts[set->lods[i]]++;
+	}
+	uint32_t lod_counts[MESH_MAX_LODS];
+	uint32_t first = 0;
+	for (uint32_t l = 0; l < MESH_MAX_LODS; l++){
+		lod_counts[l] = lod_starts[l];
+		lod_starts[l] = first;
+		first += lod_counts[l];
+	}
+
+	//written straight into the persistently mapped region, it is only read by the gpu through the vertex fetch
+	struct instance_data *mapped = allocation.data;
+	uint32_t lod_heads[MESH_MAX_LODS];
+	memcpy(lod_heads, lod_starts, sizeof lod_heads);
+	for (uint32_t i = 0; i < set->count; i++)
+		mapped[lod_heads[set->lods[i]]++] = set->instances[i];
+
+	//the instance binding sits past the mesh's so the queue rebinding meshes never disturbs it
+	vkCmdBindVertexBuffers(command_buffer, binding, 1, &allocation.buffer, &allocation.offset);
+	struct draw_packet packet = *base;
+	packet.mesh = mesh;
+	for (uint32_t l = 0; l < mesh->lod_count; l++){
+		if (!lod_counts[l])
+			continue;
+		packet.lod = l;
+		packet.first_instance = lod_starts[l];
+		packet.instance_count = lod_counts[l];
+		if (draw_queue_push(queue, &packet))
+			set->draw_count++;
+	}
+	return set->draw_count;
+}
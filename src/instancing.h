@@ -0,0 +1,51 @@
+//forward declarations of structs defined further down that are passed around by pointer
+struct instance_set;
+struct vertex_layout;
+struct mesh;
+struct frame_ring;
+struct draw_queue;
+struct draw_packet;
+
+//the vertex input locations the per instance attributes take, straight after the mesh's position and colour
+#define INSTANCE_TRANSFORM_LOCATION 2
+#define INSTANCE_COLOR_LOCATION 3
+#define INSTANCE_ID_LOCATION 4
+//the instance benchmark keeps quadrupling the instance count until a frame would draw more triangles than this
+#define INSTANCE_BENCHMARK_MAX_TRIANGLES (1024 * 1024)
+
+//functions
+
+//adds a per instance binding for struct instance_data to the layout and returns its index, bind the instances there
+uint32_t vertex_layout_add_instances(struct vertex_layout *layout);
+
+//instance set functions, a grid is count copies spread evenly over clip space each scaled down to fit its cell
+struct instance_set create_instance_grid(uint32_t count);
+void destroy_instance_set(struct instance_set *set);
+
+//both write this frame's instances into the frame ring and bind them, queue also picks a level of detail per instance
+//and pushes one instanced draw per level in use onto the queue, each a copy of base with the mesh and its run filled in,
+//returning how many draws that took
+bool bind_instances(VkCommandBuffer command_buffer, const struct instance_set *set, struct frame_ring *ring, uint32_t binding, uint32_t count);
+uint32_t queue_instances(VkCommandBuffer command_buffer, struct instance_set *set, const struct mesh *mesh, struct frame_ring *ring, uint32_t binding, float pixels_per_unit, float error_pixels, struct draw_queue *queue, const struct draw_packet *base);
+
+
+//structs
+
+//what the vertex shader gets per instance, 24 bytes
+//transform is a translation in xyz and a uniform scale in w applied after the mesh's position transform,
+//color is rgba8 multiplied into the vertex colour and id is whatever the application wants to tell instances apart by
+struct instance_data{
+	float transform[4];
+	uint32_t color;
+	uint32_t id;
+};
+
+//the instances as the application last set them, copied into the frame ring every frame so they can change freely
+//lods is the level each instance was drawn with last frame, kept so the hysteresis has something to stick to
+struct instance_set{
+	struct instance_data *instances;
+	uint8_t *lods;
+	uint32_t count;
+	//the draws the last queue_instances call queued, at most one per level of detail
+	uint32_t draw_count;
+};
@@ -9,11 +9,40 @@
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
+#include "host_allocator.h"
+#include "gpu_timer.h"
 #include "vulkan_helpers.h"
+#include "frame_ring.h"
+#include "upload_manager.h"
+#include "mesh.h"
+#include "obj_import.h"
+#include "mesh_optimize.h"
+#include "vertex_quantize.h"
+#include "meshlet.h"
+#include "mesh_simplify.h"
+#include "instancing.h"
+#include "object_cull.h"
+#include "draw_queue.h"
+#include "basic_helpers.h"
+#include "telemetry.h"
+#include "benchmark.h"
+#include "profiler.h"
 
 //function declarations
-void mainLoop(GLFWwindow* window, VkDevice device, VkQueue graphics_queue, VkQueue presentation_queue, VkSwapchainKHR swap_chain, VkCommandBuffer *command_buffers, VkSemaphore image_availible_semaphore, VkSemaphore render_finished_semaphore);
-void CleanUp(GLFWwindow *window, VkInstance instance, VkDevice device, VkDebugUtilsMessengerEXT debug_messenger, VkSurfaceKHR surface, VkSwapchainKHR swap_chain, VkImageView *image_views, int image_count, VkPipelineLayout pipeline_layout, VkRenderPass render_pass, VkPipeline graphics_pipeline, VkFramebuffer *framebuffers, VkCommandPool command_pool, VkSemaphore image_availible_semaphore, VkSemaphore render_finished_semaphore);
+void mainLoop(GLFWwindow* window, VkPhysicalDevice physical_device, VkSurfaceKHR surface, VkDevice device, VkQueue graphics_queue, VkQueue presentation_queue, struct renderer *renderer, struct swap_chain_resources *swap_chain_resources, struct frame_context *frame_context, enum present_mode_goal present_goal, struct benchmark *benchmark);
+void headless_loop(VkDevice device, VkQueue graphics_queue, struct renderer *renderer, struct swap_chain_resources *swap_chain_resources, struct frame_context *frame_context, uint64_t frame_count, struct benchmark *benchmark);
+void instance_benchmark_loop(VkDevice device, VkQueue graphics_queue, struct gpu_allocator *gpu_allocator, struct renderer *renderer, struct swap_chain_resources *swap_chain_resources, struct frame_context *frame_context, uint32_t warmup_frames, uint32_t measured_frames);
+void record_frame_timings(struct benchmark *benchmark, struct frame_timings *timings, uint64_t frame_ns, bool presented);
+void record_gpu_timings(struct benchmark *benchmark, struct gpu_timer *gpu_timer, uint64_t *last_gpu_frame);
+void CleanUp(GLFWwindow *window, VkInstance instance, VkDevice device, VkDebugUtilsMessengerEXT debug_messenger, VkSurfaceKHR surface, struct gpu_allocator *gpu_allocator, struct swap_chain_resources *swap_chain_resources, struct renderer *renderer, struct frame_context *frame_context);
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
+void framebuffer_size_callback(GLFWwindow *window, int width, int height);
+
+//state written by the glfw callbacks and read back by the main loop
+struct window_state{
+	enum present_mode_goal requested_goal;
+	bool framebuffer_resized;
+};
 
 //enables validation layers depending of whether it was compiled in debug mode of not
 #ifdef NDEBUG
@@ -22,7 +51,135 @@ void CleanUp(GLFWwindow *window, VkInstance instance, VkDevice device, VkDebugUt
 	static const bool enableValidationLayers = true;
 #endif
 
-int main() {
+//how many frames the cpu may record ahead of the gpu, 1 is lowest latency, 2-3 gives the gpu more work queued up
+#define FRAMES_IN_FLIGHT 2
+
+//the size and format of the window and of the offscreen targets in headless runs
+#define WINDOW_WIDTH 400
+#define WINDOW_HEIGHT 400
+#define OFFSCREEN_FORMAT VK_FORMAT_B8G8R8A8_UNORM
+
+//bytes of per frame data each frame in flight can stream through the frame ring
+#define FRAME_RING_REGION_SIZE (1024 * 1024)
+
+//staging memory for uploads, split between the batches so one can fill while another copies
+#define UPLOAD_STAGING_SIZE (8 * 1024 * 1024)
+
+//the triangle, one array per attribute so the mesh can pack them into either vertex stream layout
+static const float triangle_positions[] = {0.0f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f};
+static const float triangle_colors[] = {1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+static const uint32_t triangle_indices[] = {0, 1, 2};
+static const VkFormat triangle_formats[] = {VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT};
+
+int main(int argc, char **argv) {
+	//everything up to the first frame is one span so cold and warm starts can be compared with --trace <file>
+	PROFILE_BEGIN("startup");
+
+	//the present mode goal can be picked with --present latency|throughput|power and changed while running with the 1/2/3 keys
+	//--telemetry <file> writes binary telemetry records to a file instead of text to stderr
+	//--headless renders --frames n frames into offscreen images with no window, surface or swap chain
+	//--benchmark m runs --warmup w frames then measures m frames and reports them with --benchmark-format json|csv
+	//to stdout or to --benchmark-output <file>, the program exits once it is done
+	//--trace <file> writes the startup phases as a chrome trace event json file
+	//--vertex-streams interleaved|split picks whether the position gets a vertex buffer of its own
+	//--mesh <file> draws a binary mesh file instead of the triangle, --import <file> imports an obj file instead
+	//and --save-mesh <file> writes whichever of the two was built out as a mesh file
+	//--vertex-quantize none|snorm16|half stores imported positions in 16 bits and normals octahedral
+	//--cluster-cull splits an imported mesh into meshlets and culls them in a compute pass before drawing
+	//--lods n simplifies an imported mesh into up to n levels of detail, --lod-error <pixels> is how much error on screen
+	//is allowed before a finer level is drawn
+	//--instances n draws n copies of the mesh in a grid with one draw per level of detail in use
+	//--gpu-cull uploads the instances once and culls them and picks their levels of detail in a compute pass that writes the draws
+	//--instance-benchmark draws headless with 1, 4, 16 and so on instances up to a million triangles and reports instances per second
+	enum present_mode_goal present_goal = PRESENT_GOAL_POWER_SAVING;
+	const char *telemetry_file = NULL;
+	bool headless = false;
+	uint64_t headless_frames = 1000;
+	uint32_t benchmark_frames = 0;
+	uint32_t warmup_frames = 100;
+	enum benchmark_format benchmark_format = BENCH_FORMAT_JSON;
+	const char *benchmark_file = NULL;
+	const char *trace_file = NULL;
+	enum vertex_stream_mode vertex_streams = VERTEX_STREAMS_SPLIT;
+	const char *mesh_file = NULL;
+	const char *save_mesh = NULL;
+	const char *import_file = NULL;
+	enum vertex_quantization vertex_quantization = VERTEX_QUANTIZE_NONE;
+	bool cluster_cull = false;
+	uint32_t max_lods = MESH_MAX_LODS;
+	float lod_error_pixels = LOD_ERROR_PIXELS;
+	uint32_t instance_count = 1;
+	bool instance_benchmark = false;
+	bool gpu_cull = false;
+	for (int i = 1; i < argc; i++){
+		if (strcmp(argv[i], "--present") == 0 && i + 1 < argc){
+			if (!parse_present_mode_goal(argv[++i], &present_goal))
+				printf("Error: unknown present mode goal: %s\n", argv[i]);
+		} else if (strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc){
+			telemetry_file = argv[++i];
+		} else if (strcmp(argv[i], "--headless") == 0){
+			headless = true;
+		} else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc){
+			headless_frames = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc){
+			benchmark_frames = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc){
+			warmup_frames = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--benchmark-format") == 0 && i + 1 < argc){
+			if (!parse_benchmark_format(argv[++i], &benchmark_format))
+				printf("Error: unknown benchmark format: %s\n", argv[i]);
+		} else if (strcmp(argv[i], "--benchmark-output") == 0 && i + 1 < argc){
+			benchmark_file = argv[++i];
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc){
+			trace_file = argv[++i];
+		} else if (strcmp(argv[i], "--vertex-streams") == 0 && i + 1 < argc){
+			if (!parse_vertex_stream_mode(argv[++i], &vertex_streams))
+				printf("Error: unknown vertex stream mode: %s\n", argv[i]);
+		} else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc){
+			mesh_file = argv[++i];
+		} else if (strcmp(argv[i], "--import") == 0 && i + 1 < argc){
+			import_file = argv[++i];
+		} else if (strcmp(argv[i], "--save-mesh") == 0 && i + 1 < argc){
+			save_mesh = argv[++i];
+		} else if (strcmp(argv[i], "--vertex-quantize") == 0 && i + 1 < argc){
+			if (!parse_vertex_quantization(argv[++i], &vertex_quantization))
+				printf("Error: unknown vertex quantization: %s\n", argv[i]);
+		} else if (strcmp(argv[i], "--cluster-cull") == 0){
+			cluster_cull = true;
+		} else if (strcmp(argv[i], "--lods") == 0 && i + 1 < argc){
+			max_lods = (uint32_t)strtoul(argv[++i], NULL, 10);
+			max_lods = max_lods < 1 ? 1 : max_lods > MESH_MAX_LODS ? MESH_MAX_LODS : max_lods;
+		} else if (strcmp(argv[i], "--lod-error") == 0 && i + 1 < argc){
+			lod_error_pixels = strtof(argv[++i], NULL);
+		} else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc){
+			instance_count = (uint32_t)strtoul(argv[++i], NULL, 10);
+			instance_count = instance_count < 1 ? 1 : instance_count;
+		} else if (strcmp(argv[i], "--gpu-cull") == 0){
+			gpu_cull = true;
+		} else if (strcmp(argv[i], "--instance-benchmark") == 0){
+			instance_benchmark = true;
+			headless = true;
+		}
+	}
+
+	//the clusters are culled where the untransformed mesh sits, which only a single instance of the grid does
+	if (cluster_cull && instance_count > 1){
+		printf("Error: --cluster-cull only culls the untransformed mesh and cant be used with --instances\n");
+		return 1;
+	}
+	//it would only ever draw the first instance while reporting every one of them
+	if (cluster_cull && instance_benchmark){
+		printf("Error: --cluster-cull cant be used with --instance-benchmark\n");
+		return 1;
+	}
+
+	//started first so the debug messenger has somewhere to send messages from instance creation onwards
+#if TELEMETRY_LEVEL > 0
+	telemetry_start(telemetry_file);
+#else
+	(void)telemetry_file;
+#endif
+
 	//declare important variables used frequently
 	//for vulkan setup and config
 	GLFWwindow* window;
@@ -31,125 +188,443 @@ int main() {
 	VkSurfaceKHR surface;
 	VkPhysicalDevice physical_device;
 	VkDevice device;
-	VkSwapchainKHR swap_chain;
-	VkImage *images;
-	int image_count;
-	VkImageView *image_views;
-	VkFormat format;
-	VkExtent2D extent;
+	uint32_t api_version;
+	bool timeline_semaphores;
+	bool pipeline_statistics;
+	bool draw_indirect_count;
+	struct gpu_allocator gpu_allocator;
+	struct frame_ring frame_ring;
+	struct upload_manager upload_manager;
+	struct vertex_layout vertex_layout;
+	struct mesh mesh;
+	struct cluster_culler culler = {0};
+	struct object_culler object_culler = {0};
+	struct draw_queue draw_queue;
+	struct swap_chain_resources swap_chain_resources = {0};
 
 	struct queue_family_indices queue_family_indicies;
 	VkQueue graphics_queue;
-	VkQueue presentation_queue;
+	VkQueue presentation_queue = VK_NULL_HANDLE;
+	VkQueue transfer_queue;
 
 
 	//define them
-	window = InitialiseGLFW(400, 400);
+	//headless runs never touch glfw, a null window and surface is what tells the helpers to skip presenting
+	PROFILE_SCOPE("InitialiseGLFW") window = headless ? NULL : InitialiseGLFW(WINDOW_WIDTH, WINDOW_HEIGHT);
+
+	PROFILE_SCOPE("negotiate_api_version") api_version = negotiate_api_version();
+	PROFILE_SCOPE("create_vk_instance") instance = create_vk_instance(api_version, headless);
+
+	PROFILE_SCOPE("setup_debug_messenger") setup_debug_messenger(instance, &debug_messenger);
 
-	instance = create_vk_instance();
+	PROFILE_SCOPE("create_surface") surface = headless ? VK_NULL_HANDLE : create_surface(instance, window);
 
-	setup_debug_messenger(instance, &debug_messenger);
+	PROFILE_SCOPE("pick_physical_device") physical_device = pick_physical_device(instance, surface);
 
-	surface = create_surface(instance, window);
+	//timeline semaphores need 1.2 on both the instance and device, without them we fall back to fences
+	timeline_semaphores = query_timeline_semaphore_support(instance, physical_device, api_version);
+	printf("Frame scheduling with %s\n", timeline_semaphores ? "timeline semaphores" : "fences");
 
-	physical_device = pick_physical_device(instance, surface);
+	//the counters cost a little on some drivers so they are only turned on when something will report them
+	pipeline_statistics = benchmark_frames > 0 && query_pipeline_statistics_support(physical_device);
+	if (benchmark_frames > 0)
+		printf("Pipeline statistics %s\n", pipeline_statistics ? "enabled" : "not supported");
 
-	device = create_logical_device(physical_device, surface);
+	//a 1.2 feature, without it gpu culling writes a draw for every object and zeroes the ones it culls
+	draw_indirect_count = gpu_cull && query_draw_indirect_count_support(instance, physical_device, api_version);
+
+	PROFILE_SCOPE("create_logical_device") device = create_logical_device(physical_device, surface, timeline_semaphores, pipeline_statistics, draw_indirect_count);
 
 	queue_family_indicies = find_queue_families(physical_device, surface);
 	vkGetDeviceQueue(device, queue_family_indicies.graphics_family, 0, &graphics_queue);
-	vkGetDeviceQueue(device, queue_family_indicies.presentation_family, 0, &presentation_queue);
+	if (!headless)
+		vkGetDeviceQueue(device, queue_family_indicies.presentation_family, 0, &presentation_queue);
+	vkGetDeviceQueue(device, queue_family_indicies.transfer_family, 0, &transfer_queue);
+	printf("Uploads on %s\n", queue_family_indicies.transfer_family != queue_family_indicies.graphics_family ? "a dedicated transfer queue" : "the graphics queue");
+
+	PROFILE_SCOPE("create_gpu_allocator") gpu_allocator = create_gpu_allocator(physical_device, device);
+	PROFILE_SCOPE("create_upload_manager") upload_manager = create_upload_manager(device, &gpu_allocator, queue_family_indicies, transfer_queue, graphics_queue, UPLOAD_STAGING_SIZE);
+
+	//a mesh file brings its own vertex layout, the triangle is the fallback when there is none or it fails to load
+	mesh = (struct mesh){0};
+	if (mesh_file)
+		mesh = load_mesh_file(device, &gpu_allocator, &upload_manager, mesh_file, &vertex_layout);
+	if (!mesh.index_count && import_file){
+		struct imported_mesh imported = import_obj(import_file, 0);
+		if (imported.index_count){
+			//done before saving so a mesh file carries the optimised order and loading it costs nothing extra
+			PROFILE_SCOPE("optimize_imported_mesh") optimize_imported_mesh(&imported);
+			//the coarser levels are appended after the full mesh's indices, they all share its vertices
+			struct mesh_lod lods[MESH_MAX_LODS];
+			uint32_t lod_count = generate_mesh_lods(&imported, lods, max_lods);
+			//built from the float positions before quantising, which is the space the vertex shader decodes back into
+			struct meshlet_set meshlets = {0};
+			if (cluster_cull)
+				meshlets = build_meshlets(imported.indices, lods[0].index_count, imported.positions, imported.vertex_count);
+			struct quantized_vertices vertices = quantize_imported_mesh(&imported, vertex_quantization);
+			printf("Vertices are %u bytes with %s positions\n", vertices.vertex_size, vertex_quantization_name(vertices.owned[0] ? vertex_quantization : VERTEX_QUANTIZE_NONE));
+			vertex_layout = create_vertex_layout(vertex_streams, vertices.formats, vertices.attribute_count);
+			mesh = create_mesh(device, &gpu_allocator, &upload_manager, &vertex_layout, vertices.attributes, imported.vertex_count, imported.indices, imported.index_count, &vertices.transform, lods, lod_count);
+			if (save_mesh)
+				save_mesh_file(save_mesh, vertex_streams, vertices.formats, vertices.attribute_count, vertices.attributes, imported.vertex_count, imported.indices, imported.index_count, &vertices.transform, lods, lod_count);
+			destroy_quantized_vertices(&vertices);
+
+			//the cull pass is recorded on the graphics queue so it needs to take compute work too
+			const struct device_capabilities *capabilities = get_device_capabilities(physical_device, VK_NULL_HANDLE);
+			if (meshlets.meshlet_count && capabilities->queue_families[queue_family_indicies.graphics_family].queueFlags & VK_QUEUE_COMPUTE_BIT)
+				culler = create_cluster_culler(device, &gpu_allocator, &upload_manager, &mesh, &meshlets);
+			destroy_meshlets(&meshlets);
+		}
+		destroy_imported_mesh(&imported);
+	}
+	if (!mesh.index_count){
+		PROFILE_SCOPE("create_mesh"){
+			vertex_layout = create_vertex_layout(vertex_streams, triangle_formats, ARR_SIZE(triangle_formats));
+			const void *triangle_attributes[] = {triangle_positions, triangle_colors};
+			mesh = create_mesh(device, &gpu_allocator, &upload_manager, &vertex_layout, triangle_attributes, 3, triangle_indices, ARR_SIZE(triangle_indices), NULL, NULL, 0);
+			if (save_mesh)
+				save_mesh_file(save_mesh, vertex_streams, triangle_formats, ARR_SIZE(triangle_formats), triangle_attributes, 3, triangle_indices, ARR_SIZE(triangle_indices), NULL, NULL, 0);
+		}
+	}
+	printf("Drawing %u vertices with %s vertex streams\n", mesh.vertex_count, vertex_layout.binding_count > 1 ? "split" : "interleaved");
+
+	//instances are streamed through the frame ring every frame, so it has to have room for the most that will be drawn
+	uint32_t mesh_triangles = MAX(mesh.lods[0].index_count / 3, 1);
+	uint32_t max_instances = instance_benchmark ? MAX(INSTANCE_BENCHMARK_MAX_TRIANGLES / mesh_triangles, 1) : instance_count;
+	VkDeviceSize frame_ring_size = FRAME_RING_REGION_SIZE + sizeof(struct instance_data) * (VkDeviceSize)max_instances;
+	PROFILE_SCOPE("create_frame_ring") frame_ring = create_frame_ring(physical_device, device, &gpu_allocator, frame_ring_size, FRAMES_IN_FLIGHT);
+
+	//the instance binding goes after the mesh's own, which is where mesh_bind leaves it
+	uint32_t instance_binding = vertex_layout_add_instances(&vertex_layout);
+	struct instance_set instances = create_instance_grid(instance_count);
+	if (instance_count > 1)
+		printf("Drawing %u instances\n", instances.count);
+
+	//every object is its own indirect draw with its own first instance, and the cull pass runs on the graphics queue
+	if (gpu_cull && !culler.enabled){
+		const struct device_capabilities *capabilities = get_device_capabilities(physical_device, VK_NULL_HANDLE);
+		uint32_t most_objects = instance_benchmark ? max_instances : instances.count;
+		if (capabilities->features.multiDrawIndirect && capabilities->features.drawIndirectFirstInstance &&
+			capabilities->properties.limits.maxDrawIndirectCount >= most_objects &&
+			capabilities->queue_families[queue_family_indicies.graphics_family].queueFlags & VK_QUEUE_COMPUTE_BIT)
+			object_culler = create_object_culler(device, &gpu_allocator, &upload_manager, &mesh, &instances, draw_indirect_count);
+		else
+			printf("Gpu driven drawing needs multi draw indirect with a first instance, the instances are drawn from the cpu\n");
+	}
 
-	struct swap_chain_info swap_chain_info = create_swap_chain(physical_device, surface, window, device);
-	swap_chain = swap_chain_info.swap_chain;
-	images = swap_chain_info.images;
-	image_count = swap_chain_info.image_count;
-	printf("Using %d images in the swapchain\n\n", image_count);
-	format = swap_chain_info.format;
-	extent = swap_chain_info.extent;
+	PROFILE_BEGIN("create_swap_chain");
+	if (headless){
+		VkExtent2D offscreen_extent = {WINDOW_WIDTH, WINDOW_HEIGHT};
+		swap_chain_resources.info = create_offscreen_targets(device, &gpu_allocator, OFFSCREEN_FORMAT, offscreen_extent, FRAMES_IN_FLIGHT);
+		printf("Using %d offscreen images\n\n", swap_chain_resources.info.image_count);
+	} else {
+		swap_chain_resources.info = create_swap_chain(physical_device, surface, window, device, present_goal, VK_NULL_HANDLE);
+		printf("Using %d images in the swapchain\n\n", swap_chain_resources.info.image_count);
+	}
 
-	image_views = create_image_views(images, image_count, format, device);
+	swap_chain_resources.image_views = create_image_views(swap_chain_resources.info.images, swap_chain_resources.info.image_count, swap_chain_resources.info.format, device);
+	PROFILE_END();
 
 	//the graphics pipeline setup
 	//declarations
-	VkRenderPass render_pass;
-	VkPipelineLayout pipeline_layout;
-	VkPipeline graphics_pipeline;
-	VkFramebuffer* framebuffers;
+	struct renderer renderer = {0};
+	renderer.frame_ring = &frame_ring;
+	renderer.upload_manager = &upload_manager;
+	renderer.mesh = &mesh;
+	renderer.culler = culler.meshlet_count ? &culler : NULL;
+	renderer.object_culler = object_culler.object_count ? &object_culler : NULL;
+	draw_queue = create_draw_queue(DRAW_QUEUE_CAPACITY);
+	renderer.draw_queue = &draw_queue;
+	renderer.instances = &instances;
+	renderer.instance_binding = instance_binding;
+	renderer.lod_error_pixels = lod_error_pixels;
 
 	//definitions
-	render_pass = create_render_pass(format, device);
-	pipeline_layout = create_graphics_pipeline_layout(device);
-	graphics_pipeline = create_graphics_pipeline(device, extent, render_pass, pipeline_layout);
-	framebuffers = create_swap_chain_framebuffers(device, image_count, render_pass, image_views, extent);
+	PROFILE_SCOPE("create_render_pass") renderer.render_pass = create_render_pass(swap_chain_resources.info.format, headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, device);
+	PROFILE_SCOPE("create_graphics_pipeline"){
+		renderer.pipeline_layout = create_graphics_pipeline_layout(device);
+		renderer.pipeline = create_graphics_pipeline(device, renderer.render_pass, renderer.pipeline_layout, &vertex_layout);
+	}
+	PROFILE_SCOPE("create_gpu_timer") renderer.gpu_timer = create_gpu_timer(physical_device, device, queue_family_indicies.graphics_family, FRAMES_IN_FLIGHT, pipeline_statistics);
+	PROFILE_SCOPE("create_swap_chain_framebuffers") swap_chain_resources.framebuffers = create_swap_chain_framebuffers(device, swap_chain_resources.info.image_count, renderer.render_pass, swap_chain_resources.image_views, swap_chain_resources.info.extent);
 
 	//control stuff
 	//declarations
-	VkCommandPool command_pool;
-	VkCommandBuffer *command_buffers;
-	VkSemaphore image_availible_semaphore;
-	VkSemaphore render_finished_semaphore;
+	struct frame_context frame_context;
 
 	//definitions
-	command_pool = create_command_pool(device, queue_family_indicies.graphics_family);
-	command_buffers = create_command_buffers(device, command_pool, render_pass, graphics_pipeline, framebuffers, extent, image_count);
-	image_availible_semaphore = create_semaphore(device);
-	render_finished_semaphore = create_semaphore(device);
+	PROFILE_SCOPE("create_frame_context") frame_context = create_frame_context(device, FRAMES_IN_FLIGHT, swap_chain_resources.info.image_count, timeline_semaphores, queue_family_indicies.graphics_family);
 
 	//printf("Do you have the required layers installed: %s", CheckValidationLayerSupport() ? "YES\n" : "NO\n");
 
+	//the benchmark is allocated before the loop starts so it never allocates while measuring
+	//the instance benchmark runs a benchmark of its own for every instance count instead
+	struct benchmark benchmark = {0};
+	bool run_benchmark = benchmark_frames && !instance_benchmark;
+	if (run_benchmark){
+		benchmark = create_benchmark(warmup_frames, benchmark_frames);
+		headless_frames = (uint64_t)warmup_frames + benchmark_frames;
+	}
+	struct benchmark *active_benchmark = run_benchmark ? &benchmark : NULL;
+
+	PROFILE_END();
+	print_gpu_allocator_stats(&gpu_allocator);
+#if PROFILER_ENABLED
+	printf("Startup took %.3f ms\n", profiler_span_ms("startup"));
+	if (trace_file)
+		profiler_write_trace(trace_file);
+#else
+	(void)trace_file;
+#endif
+
+	//every enumeration result startup needed is dead now, the device snapshots stay for swap chain rebuilds
+	reset_vulkan_scratch();
+
 	//the mainloop
-	mainLoop(window, device, graphics_queue, presentation_queue, swap_chain, command_buffers, image_availible_semaphore, render_finished_semaphore);
+	if (instance_benchmark)
+		instance_benchmark_loop(device, graphics_queue, &gpu_allocator, &renderer, &swap_chain_resources, &frame_context, warmup_frames, benchmark_frames ? benchmark_frames : 100);
+	else if (headless)
+		headless_loop(device, graphics_queue, &renderer, &swap_chain_resources, &frame_context, headless_frames, active_benchmark);
+	else
+		mainLoop(window, physical_device, surface, device, graphics_queue, presentation_queue, &renderer, &swap_chain_resources, &frame_context, present_goal, active_benchmark);
+
+	if (active_benchmark){
+		benchmark_report(active_benchmark, benchmark_file, benchmark_format);
+		destroy_benchmark(active_benchmark);
+	}
 	
 
+	destroy_instance_set(&instances);
+
 	//the clean up after main loop ends
-	CleanUp(window, instance, device, debug_messenger, surface, swap_chain, image_views, image_count, pipeline_layout, render_pass, graphics_pipeline, framebuffers, command_pool, image_availible_semaphore, render_finished_semaphore);
+	CleanUp(window, instance, device, debug_messenger, surface, &gpu_allocator, &swap_chain_resources, &renderer, &frame_context);
 
 	return 0;
 }
 
 
-void mainLoop(GLFWwindow* window, VkDevice device, VkQueue graphics_queue, VkQueue presentation_queue, VkSwapchainKHR swap_chain, VkCommandBuffer *command_buffers, VkSemaphore image_availible_semaphore, VkSemaphore render_finished_semaphore) {
+void mainLoop(GLFWwindow* window, VkPhysicalDevice physical_device, VkSurfaceKHR surface, VkDevice device, VkQueue graphics_queue, VkQueue presentation_queue, struct renderer *renderer, struct swap_chain_resources *swap_chain_resources, struct frame_context *frame_context, enum present_mode_goal present_goal, struct benchmark *benchmark) {
+	//the callbacks write what the user asks for in here, the swap chain is only rebuilt when something actually changed
+	struct window_state window_state = {
+		.requested_goal = present_goal,
+		.framebuffer_resized = false
+	};
+	glfwSetWindowUserPointer(window, &window_state);
+	glfwSetKeyCallback(window, key_callback);
+	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+	bool needs_recreate = false;
+	uint64_t last_gpu_frame = 0;
+
 	while (!glfwWindowShouldClose(window)) {
+		uint64_t frame_start = get_time_ns();
 		glfwPollEvents();
-		draw_frame(device, graphics_queue, presentation_queue, swap_chain, command_buffers, image_availible_semaphore, render_finished_semaphore);
+
+		if (window_state.requested_goal != present_goal){
+			present_goal = window_state.requested_goal;
+			needs_recreate = true;
+			printf("Switching to present goal %s\n", present_mode_goal_name(present_goal));
+		}
+
+		if (needs_recreate || window_state.framebuffer_resized){
+			//a minimised window has a zero sized framebuffer which can't have a swap chain so sleep until it comes back
+			int width = 0, height = 0;
+			glfwGetFramebufferSize(window, &width, &height);
+			while ((width == 0 || height == 0) && !glfwWindowShouldClose(window)){
+				glfwWaitEvents();
+				glfwGetFramebufferSize(window, &width, &height);
+			}
+
+			recreate_swap_chain(physical_device, surface, window, device, renderer->render_pass, present_goal, swap_chain_resources, frame_context);
+			window_state.framebuffer_resized = false;
+			needs_recreate = false;
+		}
+
+		struct frame_timings timings = {0};
+		uint64_t frames_before = frame_context->frame_number;
+		needs_recreate = draw_frame(device, graphics_queue, presentation_queue, swap_chain_resources, frame_context, renderer, &timings);
+
+		//a frame that bailed out because the swap chain was out of date never submitted anything so it is not counted
+		if (benchmark && frame_context->frame_number != frames_before){
+			record_frame_timings(benchmark, &timings, get_time_ns() - frame_start, true);
+			record_gpu_timings(benchmark, &renderer->gpu_timer, &last_gpu_frame);
+			if (benchmark_finished(benchmark))
+				glfwSetWindowShouldClose(window, GLFW_TRUE);
+		}
 	}
 
 	vkDeviceWaitIdle(device);
 }
 
-void CleanUp(GLFWwindow *window, VkInstance instance, VkDevice device, VkDebugUtilsMessengerEXT debug_messenger, VkSurfaceKHR surface, VkSwapchainKHR swap_chain, VkImageView *image_views, int image_count, VkPipelineLayout pipeline_layout, VkRenderPass render_pass, VkPipeline graphics_pipeline, VkFramebuffer *framebuffers, VkCommandPool command_pool, VkSemaphore image_availible_semaphore, VkSemaphore render_finished_semaphore) {
+void headless_loop(VkDevice device, VkQueue graphics_queue, struct renderer *renderer, struct swap_chain_resources *swap_chain_resources, struct frame_context *frame_context, uint64_t frame_count, struct benchmark *benchmark) {
+	uint64_t last_gpu_frame = 0;
 
-	vkDestroySemaphore(device, image_availible_semaphore, NULL);
-	vkDestroySemaphore(device, render_finished_semaphore, NULL);
+	for (uint64_t i = 0; i < frame_count; i++) {
+		uint64_t frame_start = get_time_ns();
+		struct frame_timings timings = {0};
+		draw_offscreen_frame(device, graphics_queue, swap_chain_resources, frame_context, renderer, &timings);
 
-	vkDestroyCommandPool(device, command_pool, NULL);
+		if (benchmark){
+			record_frame_timings(benchmark, &timings, get_time_ns() - frame_start, false);
+			record_gpu_timings(benchmark, &renderer->gpu_timer, &last_gpu_frame);
+		}
+	}
+
+	vkDeviceWaitIdle(device);
+}
 
-	for (int i = 0; i < image_count; i++){
-		vkDestroyFramebuffer(device, framebuffers[i], NULL);
+void instance_benchmark_loop(VkDevice device, VkQueue graphics_queue, struct gpu_allocator *gpu_allocator, struct renderer *renderer, struct swap_chain_resources *swap_chain_resources, struct frame_context *frame_context, uint32_t warmup_frames, uint32_t measured_frames) {
+	struct instance_set *original = renderer->instances;
+	const struct mesh *mesh = renderer->mesh;
+	uint32_t mesh_triangles = MAX(mesh->lods[0].index_count / 3, 1);
+	//gpu culling keeps its own copy of the instances so it is rebuilt for every count, the loop has waited for idle by then
+	struct object_culler *object_culler = renderer->object_culler;
+	bool draw_indirect_count = object_culler && object_culler->compact;
+	float pixels_per_unit = swap_chain_resources->info.extent.height * 0.5f;
+
+	//frames are pipelined so the wall clock frame time is what bounds throughput, the gpu time shows how much of it is drawing
+	printf("instances,triangles,draws,frame_ms,gpu_frame_ms,instances_per_second,triangles_per_second\n");
+	for (uint64_t count = 1; count * mesh_triangles <= INSTANCE_BENCHMARK_MAX_TRIANGLES; count *= 4){
+		struct instance_set set = create_instance_grid((uint32_t)count);
+		if (!set.count)
+			break;
+		renderer->instances = &set;
+		if (object_culler){
+			destroy_object_culler(device, object_culler);
+			*object_culler = create_object_culler(device, gpu_allocator, renderer->upload_manager, mesh, &set, draw_indirect_count);
+		}
+
+		struct benchmark benchmark = create_benchmark(warmup_frames, measured_frames);
+		headless_loop(device, graphics_queue, renderer, swap_chain_resources, frame_context, (uint64_t)warmup_frames + measured_frames, &benchmark);
+		struct benchmark_summary frame = benchmark_summarise_metric(&benchmark, BENCH_FRAME_MS);
+		struct benchmark_summary gpu_frame = benchmark_summarise_metric(&benchmark, BENCH_GPU_FRAME_MS);
+
+		//coarser levels draw fewer triangles, so they are counted from the levels the last frame picked
+		//the gpu's picks never come back, but with every object the same size they match a fresh pick on the cpu
+		uint64_t triangles = 0;
+		for (uint32_t i = 0; i < set.count; i++){
+			uint32_t lod = object_culler ? select_mesh_lod(mesh, pixels_per_unit * set.instances[i].transform[3], renderer->lod_error_pixels, 0) : set.lods[i];
+			triangles += mesh->lods[lod].index_count / 3;
+		}
+		uint32_t draws = object_culler ? 1 : set.draw_count;
+		double seconds = frame.mean / 1e3;
+		printf("%u,%llu,%u,%.4f,%.4f,%.0f,%.0f\n", set.count, (unsigned long long)triangles, draws, frame.mean, gpu_frame.mean,
+			seconds > 0.0 ? set.count / seconds : 0.0, seconds > 0.0 ? triangles / seconds : 0.0);
+
+		destroy_benchmark(&benchmark);
+		destroy_instance_set(&set);
 	}
+	renderer->instances = original;
+}
 
-		vkDestroyPipeline(device, graphics_pipeline, NULL);
-	vkDestroyPipelineLayout(device, pipeline_layout, NULL);
-	vkDestroyRenderPass(device, render_pass, NULL);
-	//order here is extremly important
-	for (int j = 0; j < image_count; j++){
-		vkDestroyImageView(device, image_views[j], NULL);
+void record_frame_timings(struct benchmark *benchmark, struct frame_timings *timings, uint64_t frame_ns, bool presented) {
+	benchmark_record(benchmark, BENCH_WAIT_MS, timings->wait_ns / 1e6);
+	benchmark_record(benchmark, BENCH_SUBMIT_MS, timings->submit_ns / 1e6);
+	//headless frames have no acquire or present so they are left out rather than reported as zero
+	if (presented){
+		benchmark_record(benchmark, BENCH_ACQUIRE_MS, timings->acquire_ns / 1e6);
+		benchmark_record(benchmark, BENCH_PRESENT_MS, timings->present_ns / 1e6);
 	}
+	benchmark_record(benchmark, BENCH_FRAME_MS, frame_ns / 1e6);
+	benchmark_next_frame(benchmark);
+}
+
+void record_gpu_timings(struct benchmark *benchmark, struct gpu_timer *gpu_timer, uint64_t *last_gpu_frame) {
+	//gpu results arrive frames_in_flight frames late so only record each completed frame once
+	struct gpu_frame_timings gpu_timings;
+	if (!gpu_timer_latest(gpu_timer, &gpu_timings) || gpu_timings.frame <= *last_gpu_frame)
+		return;
+
+	benchmark_record(benchmark, BENCH_GPU_FRAME_MS, gpu_timings.total_ms);
+	if (gpu_timings.has_statistics){
+		struct gpu_pipeline_statistics *s = &gpu_timings.statistics;
+		benchmark_record(benchmark, BENCH_IA_VERTICES, (double)s->input_assembly_vertices);
+		benchmark_record(benchmark, BENCH_IA_PRIMITIVES, (double)s->input_assembly_primitives);
+		benchmark_record(benchmark, BENCH_VS_INVOCATIONS, (double)s->vertex_shader_invocations);
+		benchmark_record(benchmark, BENCH_CLIPPING_INVOCATIONS, (double)s->clipping_invocations);
+		benchmark_record(benchmark, BENCH_CLIPPING_PRIMITIVES, (double)s->clipping_primitives);
+		benchmark_record(benchmark, BENCH_FS_INVOCATIONS, (double)s->fragment_shader_invocations);
+	}
+	*last_gpu_frame = gpu_timings.frame;
+}
+
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+	(void)scancode;
+	(void)mods;
+	struct window_state *window_state = glfwGetWindowUserPointer(window);
+	if (action != GLFW_PRESS || !window_state) return;
+
+	switch (key){
+		case GLFW_KEY_1: window_state->requested_goal = PRESENT_GOAL_LOW_LATENCY; break;
+		case GLFW_KEY_2: window_state->requested_goal = PRESENT_GOAL_MAX_THROUGHPUT; break;
+		case GLFW_KEY_3: window_state->requested_goal = PRESENT_GOAL_POWER_SAVING; break;
+	}
+}
 
-	vkDestroySwapchainKHR(device, swap_chain, NULL);
+void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
+	(void)width;
+	(void)height;
+	struct window_state *window_state = glfwGetWindowUserPointer(window);
+	if (!window_state) return;
 
-	vkDestroyDevice(device, NULL);
+	//the resize is handled by the main loop, vulkan may not report out of date for every resize so we track it ourselves
+	window_state->framebuffer_resized = true;
+}
+
+void CleanUp(GLFWwindow *window, VkInstance instance, VkDevice device, VkDebugUtilsMessengerEXT debug_messenger, VkSurfaceKHR surface, struct gpu_allocator *gpu_allocator, struct swap_chain_resources *swap_chain_resources, struct renderer *renderer, struct frame_context *frame_context) {
+
+	destroy_frame_context(device, frame_context);
+
+	destroy_swap_chain_resources(device, swap_chain_resources);
+
+	destroy_gpu_timer(device, &renderer->gpu_timer);
+	vkDestroyPipeline(device, renderer->pipeline, HOST_ALLOCATOR);
+	vkDestroyPipelineLayout(device, renderer->pipeline_layout, HOST_ALLOCATOR);
+	vkDestroyRenderPass(device, renderer->render_pass, HOST_ALLOCATOR);
+
+	printf("Frame ring: %llu of %llu bytes used at most per frame, %llu allocations didnt fit\n", (unsigned long long)renderer->frame_ring->high_water,
+		(unsigned long long)renderer->frame_ring->region_size, (unsigned long long)renderer->frame_ring->failed_allocations);
+	destroy_frame_ring(device, renderer->frame_ring);
+	printf("Draw queue: %llu draws, %llu pipeline, %llu descriptor set and %llu mesh binds, %llu binds skipped, %llu draws didnt fit\n",
+		(unsigned long long)renderer->draw_queue->draws, (unsigned long long)renderer->draw_queue->pipeline_binds, (unsigned long long)renderer->draw_queue->set_binds,
+		(unsigned long long)renderer->draw_queue->mesh_binds, (unsigned long long)renderer->draw_queue->skipped_binds, (unsigned long long)renderer->draw_queue->dropped_draws);
+	destroy_draw_queue(renderer->draw_queue);
+	if (renderer->culler)
+		destroy_cluster_culler(device, renderer->culler);
+	if (renderer->object_culler)
+		destroy_object_culler(device, renderer->object_culler);
+	destroy_mesh(device, renderer->mesh);
+	destroy_upload_manager(device, renderer->upload_manager);
+
+	//everything allocated from it has to be gone by now
+	destroy_gpu_allocator(device, gpu_allocator);
+
+	vkDestroyDevice(device, HOST_ALLOCATOR);
+	destroy_device_capabilities();
+	destroy_vulkan_scratch();
 
 	if (enableValidationLayers) {
-		DestroyDebugUtilsMessengerEXT(instance, debug_messenger, NULL);
+		DestroyDebugUtilsMessengerEXT(instance, debug_messenger, HOST_ALLOCATOR);
 	}
 
-	vkDestroySurfaceKHR(instance, surface, NULL);
+	//headless runs have no surface or window and never initialised glfw
+	if (surface != VK_NULL_HANDLE)
+		vkDestroySurfaceKHR(instance, surface, HOST_ALLOCATOR);
+
+	vkDestroyInstance(instance, HOST_ALLOCATOR);
 
-	vkDestroyInstance(instance, NULL);
+	if (window){
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
 
-	glfwDestroyWindow(window);
+	//anything still live here is something vulkan was never told to destroy
+#if HOST_ALLOCATOR_ENABLED
+	print_host_allocator_stats();
+	destroy_host_allocator();
+#endif
 
-	glfwTerminate();
-}
\ No newline at end of file
+#if TELEMETRY_LEVEL > 0
+	telemetry_stop();
+#endif
+}
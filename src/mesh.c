@@ -0,0 +1,496 @@
+//plain old C headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+//GLFW header
+#define GLFW_INCLUDE_VULKAN
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include "host_allocator.h"
+#include "gpu_timer.h"
+#include "vulkan_helpers.h"
+#include "upload_manager.h"
+#include "mesh.h"
+#include "basic_helpers.h"
+#include "profiler.h"
+
+static const char *vertex_stream_mode_names[VERTEX_STREAMS_COUNT] = {
+	[VERTEX_STREAMS_INTERLEAVED] = "interleaved",
+	[VERTEX_STREAMS_SPLIT] = "split"
+};
+
+//what meshes with float positions are drawn with
+static const struct position_transform identity_position_transform = {.scale = {1.0f, 1.0f, 1.0f, 1.0f}, .offset = {0.0f, 0.0f, 0.0f, 0.0f}};
+
+uint32_t vertex_format_size(VkFormat format){
+	switch (format){
+	case VK_FORMAT_R8G8_SNORM:
+		return 2;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SNORM:
+	case VK_FORMAT_R8G8B8A8_UINT:
+	case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+	case VK_FORMAT_A2B10G10R10_SNORM_PACK32:
+	case VK_FORMAT_R16G16_UNORM:
+	case VK_FORMAT_R16G16_SNORM:
+	case VK_FORMAT_R16G16_SFLOAT:
+	case VK_FORMAT_R32_SFLOAT:
+	case VK_FORMAT_R32_UINT:
+		return 4;
+	case VK_FORMAT_R16G16B16A16_UNORM:
+	case VK_FORMAT_R16G16B16A16_SNORM:
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+	case VK_FORMAT_R32G32_SFLOAT:
+		return 8;
+	case VK_FORMAT_R32G32B32_SFLOAT:
+		return 12;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		return 16;
+	default:
+		printf("Error: unknown vertex format %d\n", format);
+		return 0;
+	}
+}
+
+uint32_t vertex_layout_add_binding(struct vertex_layout *layout, VkVertexInputRate input_rate){
+	if (layout->binding_count == VERTEX_MAX_BINDINGS){
+		printf("Error: vertex layout is out of bindings");
+		return VERTEX_MAX_BINDINGS - 1;
+	}
+
+	uint32_t binding = layout->binding_count++;
+	layout->bindings[binding].binding = binding;
+	layout->bindings[binding].stride = 0;
+	layout->bindings[binding].inputRate = input_rate;
+	return binding;
+}
+
+void vertex_layout_add_attribute(struct vertex_layout *layout, uint32_t binding, uint32_t location, VkFormat format){
+	if (layout->attribute_count == VERTEX_MAX_ATTRIBUTES || binding >= layout->binding_count){
+		printf("Error: cant add vertex attribute %u to binding %u", location, binding);
+		return;
+	}
+
+	//attributes are packed one after another, so the offset is just how big the binding's vertex is so far
+	VkVertexInputAttributeDescription *attribute = &layout->attributes[layout->attribute_count++];
+	attribute->location = location;
+	attribute->binding = binding;
+	attribute->format = format;
+	attribute->offset = layout->bindings[binding].stride;
+
+	layout->bindings[binding].stride += vertex_format_size(format);
+}
+
+struct vertex_layout create_vertex_layout(enum vertex_stream_mode mode, const VkFormat *formats, uint32_t format_count){
+	struct vertex_layout layout = {0};
+	if (format_count == 0)
+		return layout;
+
+	uint32_t position_binding = vertex_layout_add_binding(&layout, VK_VERTEX_INPUT_RATE_VERTEX);
+	vertex_layout_add_attribute(&layout, position_binding, 0, formats[0]);
+
+	//everything that isnt the position still shares one buffer, only the position gets a stream of its own
+	uint32_t attribute_binding = position_binding;
+	if (mode == VERTEX_STREAMS_SPLIT && format_count > 1)
+		attribute_binding = vertex_layout_add_binding(&layout, VK_VERTEX_INPUT_RATE_VERTEX);
+
+	for (uint32_t i = 1; i < format_count; i++)
+		vertex_layout_add_attribute(&layout, attribute_binding, i, formats[i]);
+
+	return layout;
+}
+
+struct vertex_layout vertex_layout_position_only(const struct vertex_layout *layout){
+	struct vertex_layout position_layout = {0};
+	if (layout->attribute_count == 0)
+		return position_layout;
+
+	//the stride is kept as it was, with an interleaved layout this still works but fetches whole vertices
+	const VkVertexInputAttributeDescription *position = &layout->attributes[0];
+	position_layout.bindings[0] = layout->bindings[position->binding];
+	position_layout.bindings[0].binding = 0;
+	position_layout.binding_count = 1;
+	position_layout.attributes[0] = *position;
+	position_layout.attributes[0].binding = 0;
+	position_layout.attribute_count = 1;
+	return position_layout;
+}
+
+VkPipelineVertexInputStateCreateInfo vertex_layout_input_state(const struct vertex_layout *layout){
+	//points into the layout, so the layout has to outlive the pipeline creation
+	VkPipelineVertexInputStateCreateInfo vertex_input_info = {0};
+	vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertex_input_info.vertexBindingDescriptionCount = layout->binding_count;
+	vertex_input_info.pVertexBindingDescriptions = layout->bindings;
+	vertex_input_info.vertexAttributeDescriptionCount = layout->attribute_count;
+	vertex_input_info.pVertexAttributeDescriptions = layout->attributes;
+	return vertex_input_info;
+}
+
+const char *vertex_stream_mode_name(enum vertex_stream_mode mode){
+	if (mode < 0 || mode >= VERTEX_STREAMS_COUNT)
+		return "unknown";
+	return vertex_stream_mode_names[mode];
+}
+
+bool parse_vertex_stream_mode(const char *name, enum vertex_stream_mode *mode){
+	for (int i = 0; i < VERTEX_STREAMS_COUNT; i++){
+		if (strcmp(name, vertex_stream_mode_names[i]) == 0){
+			*mode = (enum vertex_stream_mode)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+struct vertex_decode_constants vertex_layout_decode_constants(const struct vertex_layout *layout){
+	struct vertex_decode_constants constants = {0};
+	for (uint32_t a = 0; a < layout->attribute_count; a++){
+		const VkVertexInputAttributeDescription *attribute = &layout->attributes[a];
+		if (attribute->location == 1)
+			constants.octahedral_color = attribute->format == VK_FORMAT_R16G16_SNORM || attribute->format == VK_FORMAT_R8G8_SNORM;
+	}
+	return constants;
+}
+
+//a device local buffer that is filled through the upload manager, or written on the gpu
+VkBuffer create_device_buffer(VkDevice device, struct gpu_allocator *allocator, VkDeviceSize size, VkBufferUsageFlags usage, struct gpu_allocation *allocation){
+	VkBufferCreateInfo create_info = {0};
+	create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	create_info.size = size;
+	create_info.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkBuffer buffer = VK_NULL_HANDLE;
+	if (vkCreateBuffer(device, &create_info, HOST_ALLOCATOR, &buffer) != VK_SUCCESS){
+		printf("Error: failed to create device buffer");
+		return VK_NULL_HANDLE;
+	}
+
+	*allocation = gpu_allocate_buffer(device, allocator, buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+	return buffer;
+}
+
+//packs one binding's worth of vertices out of the tightly packed per attribute arrays, the caller frees it
+static unsigned char *pack_vertex_stream(const struct vertex_layout *layout, uint32_t binding, const void *const *attributes, uint32_t vertex_count){
+	uint32_t stride = layout->bindings[binding].stride;
+	unsigned char *packed = malloc((size_t)stride * vertex_count);
+	if (!packed){
+		printf("Error: failed to allocate vertex stream");
+		return NULL;
+	}
+
+	for (uint32_t a = 0; a < layout->attribute_count; a++){
+		const VkVertexInputAttributeDescription *attribute = &layout->attributes[a];
+		if (attribute->binding != binding)
+			continue;
+
+		uint32_t element_size = vertex_format_size(attribute->format);
+		const unsigned char *source = attributes[a];
+		for (uint32_t v = 0; v < vertex_count; v++)
+			memcpy(packed + (size_t)v * stride + attribute->offset, source + (size_t)v * element_size, element_size);
+	}
+	return packed;
+}
+
+//anything up to 65536 vertices can be addressed with 16 bits, the caller frees the result
+static void *narrow_indices(const uint32_t *indices, uint32_t index_count, uint32_t vertex_count, uint32_t *index_size){
+	*index_size = vertex_count <= 65536 ? 2 : 4;
+	void *narrowed = malloc((size_t)index_count * *index_size);
+	if (!narrowed){
+		printf("Error: failed to allocate indices");
+		return NULL;
+	}
+
+	if (*index_size == 4){
+		memcpy(narrowed, indices, (size_t)index_count * 4);
+	} else {
+		uint16_t *short_indices = narrowed;
+		for (uint32_t i = 0; i < index_count; i++)
+			short_indices[i] = (uint16_t)indices[i];
+	}
+	return narrowed;
+}
+
+struct mesh_bounds compute_mesh_bounds(VkFormat position_format, const void *positions, uint32_t vertex_count){
+	struct mesh_bounds bounds = {0};
+	//only float positions can be bounded here, anything quantised carries its bounds some other way
+	uint32_t components = position_format == VK_FORMAT_R32G32B32_SFLOAT ? 3 : position_format == VK_FORMAT_R32G32_SFLOAT ? 2 : 0;
+	if (!components || !vertex_count)
+		return bounds;
+
+	const float *position = positions;
+	for (uint32_t c = 0; c < components; c++)
+		bounds.min[c] = bounds.max[c] = position[c];
+	for (uint32_t v = 1; v < vertex_count; v++){
+		position += components;
+		for (uint32_t c = 0; c < components; c++){
+			bounds.min[c] = MIN(bounds.min[c], position[c]);
+			bounds.max[c] = MAX(bounds.max[c], position[c]);
+		}
+	}
+	return bounds;
+}
+
+//float positions are bounded directly, quantised ones already span -1 to 1 so their bounds come from the transform
+static struct mesh_bounds position_bounds(VkFormat position_format, const void *positions, uint32_t vertex_count, const struct position_transform *transform){
+	if (position_format == VK_FORMAT_R32G32B32_SFLOAT || position_format == VK_FORMAT_R32G32_SFLOAT)
+		return compute_mesh_bounds(position_format, positions, vertex_count);
+
+	struct mesh_bounds bounds;
+	for (int c = 0; c < 3; c++){
+		bounds.min[c] = transform->offset[c] - transform->scale[c];
+		bounds.max[c] = transform->offset[c] + transform->scale[c];
+	}
+	return bounds;
+}
+
+//every buffer the mesh needs, sized from the layout and the counts already in the mesh
+static void create_mesh_buffers(VkDevice device, struct gpu_allocator *allocator, const struct vertex_layout *layout, struct mesh *mesh, uint32_t index_size){
+	mesh->binding_count = layout->binding_count;
+	for (uint32_t b = 0; b < layout->binding_count; b++){
+		VkDeviceSize size = (VkDeviceSize)layout->bindings[b].stride * mesh->vertex_count;
+		mesh->vertex_buffers[b] = create_device_buffer(device, allocator, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &mesh->vertex_allocations[b]);
+	}
+
+	//compute passes read the indices as whole uints, so 16 bit ones are padded out to a multiple of 4 bytes
+	mesh->index_type = index_size == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	VkDeviceSize index_bytes = ((VkDeviceSize)mesh->index_count * index_size + 3) & ~(VkDeviceSize)3;
+	mesh->index_buffer = create_device_buffer(device, allocator, index_bytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &mesh->index_allocation);
+}
+
+//attributes holds one tightly packed array per attribute of the layout, in the order they were added to it
+//transform is how quantised positions are decoded, NULL for float positions
+//lods are ranges of indices finest first, NULL draws the whole index buffer as the only level
+struct mesh create_mesh(VkDevice device, struct gpu_allocator *allocator, struct upload_manager *uploads, const struct vertex_layout *layout, const void *const *attributes, uint32_t vertex_count, const uint32_t *indices, uint32_t index_count, const struct position_transform *transform, const struct mesh_lod *lods, uint32_t lod_count){
+	struct mesh mesh = {0};
+	mesh.vertex_count = vertex_count;
+	mesh.index_count = index_count;
+	if (!transform)
+		transform = &identity_position_transform;
+	mesh.position_transform = *transform;
+
+	uint32_t index_size;
+	void *narrowed = narrow_indices(indices, index_count, vertex_count, &index_size);
+	create_mesh_buffers(device, allocator, layout, &mesh, index_size);
+
+	//the upload manager copies the packed streams into staging straight away so they can be freed right after
+	for (uint32_t b = 0; b < layout->binding_count; b++){
+		unsigned char *packed = pack_vertex_stream(layout, b, attributes, vertex_count);
+		if (packed)
+			upload_buffer(device, uploads, mesh.vertex_buffers[b], 0, packed, (VkDeviceSize)layout->bindings[b].stride * vertex_count);
+		free(packed);
+	}
+	if (narrowed)
+		upload_buffer(device, uploads, mesh.index_buffer, 0, narrowed, (VkDeviceSize)index_count * index_size);
+	free(narrowed);
+
+	if (layout->attribute_count)
+		mesh.bounds = position_bounds(layout->attributes[0].format, attributes[0], vertex_count, transform);
+	if (lods && lod_count > 0 && lod_count <= MESH_MAX_LODS){
+		memcpy(mesh.lods, lods, sizeof *lods * lod_count);
+		mesh.lod_count = lod_count;
+	} else {
+		mesh.lods[0] = (struct mesh_lod){.first_index = 0, .index_count = index_count, .error = 0.0f};
+		mesh.lod_count = 1;
+	}
+
+	//the acquire half of the upload runs on the graphics queue, so draws submitted after this see the data
+	upload_flush(device, uploads);
+	return mesh;
+}
+
+//returns where the blob starts, 0 if writing failed which is never a valid blob offset as the header comes first
+static uint64_t write_blob(FILE *file, const void *data, uint64_t size, uint64_t *offset){
+	static const unsigned char zeros[MESH_FILE_ALIGNMENT] = {0};
+	uint64_t padding = (MESH_FILE_ALIGNMENT - *offset % MESH_FILE_ALIGNMENT) % MESH_FILE_ALIGNMENT;
+	if (fwrite(zeros, 1, padding, file) != padding)
+		return 0;
+	*offset += padding;
+
+	uint64_t start = *offset;
+	if (size && fwrite(data, 1, size, file) != size)
+		return 0;
+	*offset += size;
+	return start;
+}
+
+bool save_mesh_file(const char *file_name, enum vertex_stream_mode mode, const VkFormat *formats, uint32_t format_count, const void *const *attributes, uint32_t vertex_count, const uint32_t *indices, uint32_t index_count, const struct position_transform *transform, const struct mesh_lod *lods, uint32_t lod_count){
+	if (format_count == 0 || format_count > VERTEX_MAX_ATTRIBUTES || lod_count > MESH_MAX_LODS){
+		printf("Error: mesh cant be written to %s\n", file_name);
+		return false;
+	}
+
+	struct vertex_layout layout = create_vertex_layout(mode, formats, format_count);
+
+	//without a lod table the whole mesh is the only level
+	struct mesh_lod whole = {.first_index = 0, .index_count = index_count, .error = 0.0f};
+	if (!lods || lod_count == 0){
+		lods = &whole;
+		lod_count = 1;
+	}
+
+	struct mesh_file_header header = {0};
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.vertex_count = vertex_count;
+	header.index_count = index_count;
+	header.stream_mode = mode;
+	header.attribute_count = format_count;
+	header.lod_count = lod_count;
+	for (uint32_t i = 0; i < format_count; i++)
+		header.attribute_formats[i] = formats[i];
+	if (!transform)
+		transform = &identity_position_transform;
+	header.position_transform = *transform;
+	header.bounds = position_bounds(formats[0], attributes[0], vertex_count, transform);
+
+	FILE *file = fopen(file_name, "wb");
+	if (!file){
+		printf("Error: failed to open %s for writing\n", file_name);
+		return false;
+	}
+
+	//the header is written twice, once to hold its place and again once every offset is known
+	bool ok = fwrite(&header, sizeof header, 1, file) == 1;
+	uint64_t offset = sizeof header;
+
+	for (uint32_t b = 0; ok && b < layout.binding_count; b++){
+		unsigned char *packed = pack_vertex_stream(&layout, b, attributes, vertex_count);
+		header.stream_sizes[b] = (uint64_t)layout.bindings[b].stride * vertex_count;
+		ok = packed && (header.stream_offsets[b] = write_blob(file, packed, header.stream_sizes[b], &offset));
+		free(packed);
+	}
+
+	void *narrowed = ok ? narrow_indices(indices, index_count, vertex_count, &header.index_size) : NULL;
+	header.index_bytes = (uint64_t)index_count * header.index_size;
+	ok = ok && narrowed && (header.index_offset = write_blob(file, narrowed, header.index_bytes, &offset));
+	free(narrowed);
+
+	ok = ok && (header.lod_offset = write_blob(file, lods, sizeof *lods * lod_count, &offset));
+
+	ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof header, 1, file) == 1;
+	if (fclose(file) != 0)
+		ok = false;
+
+	if (!ok)
+		printf("Error: failed to write mesh to %s\n", file_name);
+	return ok;
+}
+
+//true if size bytes at offset lie inside the file and start on the blob alignment
+static bool blob_in_file(const struct mapped_file *file, uint64_t offset, uint64_t size){
+	return offset % MESH_FILE_ALIGNMENT == 0 && offset <= file->size && size <= file->size - offset;
+}
+
+struct mesh load_mesh_file(VkDevice device, struct gpu_allocator *allocator, struct upload_manager *uploads, const char *file_name, struct vertex_layout *layout){
+	PROFILE_BEGIN_DETAIL("load_mesh_file", file_name);
+	struct mesh mesh = {0};
+	*layout = (struct vertex_layout){0};
+
+	struct mapped_file file = map_file(file_name);
+	if (!file.data){
+		PROFILE_END();
+		return mesh;
+	}
+
+	//the header, its formats, the blob bounds and the lod ranges are checked, the vertices and indices are trusted to be what save_mesh_file wrote
+	const struct mesh_file_header *header = file.data;
+	bool valid = file.size >= sizeof *header && header->magic == MESH_FILE_MAGIC && header->version == MESH_FILE_VERSION &&
+		header->stream_mode < VERTEX_STREAMS_COUNT && header->attribute_count > 0 && header->attribute_count <= VERTEX_MAX_ATTRIBUTES &&
+		header->lod_count > 0 && header->lod_count <= MESH_MAX_LODS && (header->index_size == 2 || header->index_size == 4);
+
+	//a format vertex_format_size doesnt know has no size, it would pass the stream size check and reach the pipeline
+	VkFormat formats[VERTEX_MAX_ATTRIBUTES];
+	for (uint32_t i = 0; valid && i < header->attribute_count; i++){
+		formats[i] = (VkFormat)header->attribute_formats[i];
+		valid = vertex_format_size(formats[i]) != 0;
+	}
+
+	if (valid){
+		*layout = create_vertex_layout((enum vertex_stream_mode)header->stream_mode, formats, header->attribute_count);
+
+		for (uint32_t b = 0; b < layout->binding_count; b++){
+			valid = valid && layout->bindings[b].stride != 0 &&
+				header->stream_sizes[b] == (uint64_t)layout->bindings[b].stride * header->vertex_count &&
+				blob_in_file(&file, header->stream_offsets[b], header->stream_sizes[b]);
+		}
+		valid = valid && header->index_bytes == (uint64_t)header->index_count * header->index_size &&
+			blob_in_file(&file, header->index_offset, header->index_bytes) &&
+			blob_in_file(&file, header->lod_offset, sizeof(struct mesh_lod) * header->lod_count);
+
+		//every lod is drawn straight from the index buffer so it has to be whole triangles inside it
+		const struct mesh_lod *lods = (const void *)((const unsigned char *)file.data + header->lod_offset);
+		for (uint32_t l = 0; valid && l < header->lod_count; l++){
+			valid = lods[l].index_count % 3 == 0 &&
+				(uint64_t)lods[l].first_index + lods[l].index_count <= header->index_count;
+		}
+	}
+
+	if (!valid){
+		printf("Error: %s is not a valid mesh file\n", file_name);
+		*layout = (struct vertex_layout){0};
+		unmap_file(&file);
+		PROFILE_END();
+		return mesh;
+	}
+
+	mesh.vertex_count = header->vertex_count;
+	mesh.index_count = header->index_count;
+	mesh.bounds = header->bounds;
+	mesh.position_transform = header->position_transform;
+	mesh.lod_count = header->lod_count;
+	memcpy(mesh.lods, (const unsigned char *)file.data + header->lod_offset, sizeof(struct mesh_lod) * header->lod_count);
+	create_mesh_buffers(device, allocator, layout, &mesh, header->index_size);
+
+	//the only copy is from the mapping into staging, the pages are faulted in as the upload manager reads them
+	const unsigned char *base = file.data;
+	for (uint32_t b = 0; b < layout->binding_count; b++)
+		upload_buffer(device, uploads, mesh.vertex_buffers[b], 0, base + header->stream_offsets[b], header->stream_sizes[b]);
+	upload_buffer(device, uploads, mesh.index_buffer, 0, base + header->index_offset, header->index_bytes);
+
+	upload_flush(device, uploads);
+	unmap_file(&file);
+
+	PROFILE_END();
+	return mesh;
+}
+
+void destroy_mesh(VkDevice device, struct mesh *mesh){
+	for (uint32_t b = 0; b < mesh->binding_count; b++){
+		vkDestroyBuffer(device, mesh->vertex_buffers[b], HOST_ALLOCATOR);
+		gpu_free(device, &mesh->vertex_allocations[b]);
+	}
+	vkDestroyBuffer(device, mesh->index_buffer, HOST_ALLOCATOR);
+	gpu_free(device, &mesh->index_allocation);
+}
+
+void mesh_bind(VkCommandBuffer command_buffer, const struct mesh *mesh, bool positions_only){
+	//binding 0 always holds the position, on its own for split layouts
+	VkDeviceSize offsets[VERTEX_MAX_BINDINGS] = {0};
+	uint32_t binding_count = positions_only ? 1 : mesh->binding_count;
+	vkCmdBindVertexBuffers(command_buffer, 0, binding_count, mesh->vertex_buffers, offsets);
+	vkCmdBindIndexBuffer(command_buffer, mesh->index_buffer, 0, mesh->index_type);
+}
+
+void mesh_draw(VkCommandBuffer command_buffer, const struct mesh *mesh, uint32_t lod, uint32_t first_instance, uint32_t instance_count){
+	const struct mesh_lod *level = &mesh->lods[lod < mesh->lod_count ? lod : mesh->lod_count - 1];
+	vkCmdDrawIndexed(command_buffer, level->index_count, instance_count, level->first_index, 0, first_instance);
+}
+
+//the coarsest level whose error covers no more than error_pixels, pixels_per_unit is how big one mesh unit is on screen
+//levels coarser than the current one have to beat the threshold by LOD_HYSTERESIS so the choice settles
+uint32_t select_mesh_lod(const struct mesh *mesh, float pixels_per_unit, float error_pixels, uint32_t current_lod){
+	uint32_t lod = 0;
+	for (uint32_t l = 1; l < mesh->lod_count; l++){
+		float threshold = l > current_lod ? error_pixels * (1.0f - LOD_HYSTERESIS) : error_pixels;
+		if (mesh->lods[l].error * pixels_per_unit > threshold)
+			break;
+		lod = l;
+	}
+	return lod;
+}
@@ -0,0 +1,138 @@
+//forward declarations of structs defined further down that are passed around by pointer
+struct mesh_lod;
+struct position_transform;
+
+//the most vertex buffers and attributes one layout can describe
+#define VERTEX_MAX_BINDINGS 4
+#define VERTEX_MAX_ATTRIBUTES 8
+//the most levels of detail a mesh carries
+#define MESH_MAX_LODS 8
+//how many pixels a level's error can cover on screen before a finer one is drawn instead
+#define LOD_ERROR_PIXELS 1.0f
+//a coarser level has to fit under this fraction less than the threshold before it is switched to, so a mesh sitting
+//right at the boundary doesnt flicker between two levels every frame
+#define LOD_HYSTERESIS 0.25f
+
+//the binary mesh container, "MSH1" read as a little endian uint32
+#define MESH_FILE_MAGIC 0x3148534du
+#define MESH_FILE_VERSION 2
+//every blob in the file starts on this boundary
+#define MESH_FILE_ALIGNMENT 16
+
+//enums
+
+//how the attributes of a layout are spread over vertex buffers
+//split keeps position alone in binding 0 so depth only and shadow passes fetch nothing else
+enum vertex_stream_mode{
+	VERTEX_STREAMS_INTERLEAVED,
+	VERTEX_STREAMS_SPLIT,
+	VERTEX_STREAMS_COUNT
+};
+
+//functions
+
+//vertex layout functions, attribute locations are given in order starting from 0 which is always the position
+struct vertex_layout create_vertex_layout(enum vertex_stream_mode mode, const VkFormat *formats, uint32_t format_count);
+uint32_t vertex_layout_add_binding(struct vertex_layout *layout, VkVertexInputRate input_rate);
+void vertex_layout_add_attribute(struct vertex_layout *layout, uint32_t binding, uint32_t location, VkFormat format);
+struct vertex_layout vertex_layout_position_only(const struct vertex_layout *layout);
+VkPipelineVertexInputStateCreateInfo vertex_layout_input_state(const struct vertex_layout *layout);
+uint32_t vertex_format_size(VkFormat format);
+const char *vertex_stream_mode_name(enum vertex_stream_mode mode);
+bool parse_vertex_stream_mode(const char *name, enum vertex_stream_mode *mode);
+struct vertex_decode_constants vertex_layout_decode_constants(const struct vertex_layout *layout);
+
+//mesh functions
+struct mesh create_mesh(VkDevice device, struct gpu_allocator *allocator, struct upload_manager *uploads, const struct vertex_layout *layout, const void *const *attributes, uint32_t vertex_count, const uint32_t *indices, uint32_t index_count, const struct position_transform *transform, const struct mesh_lod *lods, uint32_t lod_count);
+void destroy_mesh(VkDevice device, struct mesh *mesh);
+void mesh_bind(VkCommandBuffer command_buffer, const struct mesh *mesh, bool positions_only);
+void mesh_draw(VkCommandBuffer command_buffer, const struct mesh *mesh, uint32_t lod, uint32_t first_instance, uint32_t instance_count);
+uint32_t select_mesh_lod(const struct mesh *mesh, float pixels_per_unit, float error_pixels, uint32_t current_lod);
+struct mesh_bounds compute_mesh_bounds(VkFormat position_format, const void *positions, uint32_t vertex_count);
+VkBuffer create_device_buffer(VkDevice device, struct gpu_allocator *allocator, VkDeviceSize size, VkBufferUsageFlags usage, struct gpu_allocation *allocation);
+
+//binary mesh file functions
+bool save_mesh_file(const char *file_name, enum vertex_stream_mode mode, const VkFormat *formats, uint32_t format_count, const void *const *attributes, uint32_t vertex_count, const uint32_t *indices, uint32_t index_count, const struct position_transform *transform, const struct mesh_lod *lods, uint32_t lod_count);
+struct mesh load_mesh_file(VkDevice device, struct gpu_allocator *allocator, struct upload_manager *uploads, const char *file_name, struct vertex_layout *layout);
+
+
+//structs
+
+//the binding and attribute descriptions a pipeline is built with, strides and offsets are filled in as attributes are added
+struct vertex_layout{
+	VkVertexInputBindingDescription bindings[VERTEX_MAX_BINDINGS];
+	uint32_t binding_count;
+	VkVertexInputAttributeDescription attributes[VERTEX_MAX_ATTRIBUTES];
+	uint32_t attribute_count;
+};
+
+//how the vertex shader gets a position back out of whatever the position attribute holds, position = offset + scale * stored
+//float positions use the identity, quantised ones are stored in -1 to 1 over the mesh bounds, vec4s so it is pushed as is
+struct position_transform{
+	float scale[4];
+	float offset[4];
+};
+
+//the vertex shader's specialisation constants, each one picks a decode path for a quantised attribute format
+//octahedral_color is set when location 1 is a two component snorm, which is taken to be an octahedral normal
+struct vertex_decode_constants{
+	VkBool32 octahedral_color;
+};
+
+//an axis aligned box around every position
+struct mesh_bounds{
+	float min[3];
+	float max[3];
+};
+
+//a range of the index buffer drawing the mesh at some level of detail, error is how far it is from the full mesh
+struct mesh_lod{
+	uint32_t first_index;
+	uint32_t index_count;
+	float error;
+};
+
+//the start of a mesh file, the rest is the vertex streams exactly as the layout binds them, the indices already
+//narrowed to index_size bytes and the lod table, each at its offset and aligned to MESH_FILE_ALIGNMENT
+//so loading is a map and a copy per blob with nothing to parse
+struct mesh_file_header{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertex_count;
+	uint32_t index_count;
+	uint32_t index_size;
+	uint32_t stream_mode;
+	uint32_t attribute_count;
+	uint32_t lod_count;
+	uint32_t attribute_formats[VERTEX_MAX_ATTRIBUTES];
+	struct mesh_bounds bounds;
+	struct position_transform position_transform;
+	uint64_t stream_offsets[VERTEX_MAX_BINDINGS];
+	uint64_t stream_sizes[VERTEX_MAX_BINDINGS];
+	uint64_t index_offset;
+	uint64_t index_bytes;
+	uint64_t lod_offset;
+};
+
+//device local vertex streams, one buffer per binding of the layout it was made with, plus the index buffer
+//the data goes up through the upload manager so the first draw has to be submitted after the upload batch
+struct mesh{
+	VkBuffer vertex_buffers[VERTEX_MAX_BINDINGS];
+	struct gpu_allocation vertex_allocations[VERTEX_MAX_BINDINGS];
+	uint32_t binding_count;
+
+	VkBuffer index_buffer;
+	struct gpu_allocation index_allocation;
+	//16 bit indices whenever the vertex count allows, it halves the index fetch bandwidth
+	VkIndexType index_type;
+
+	uint32_t vertex_count;
+	uint32_t index_count;
+
+	struct mesh_bounds bounds;
+	//pushed before drawing so the vertex shader can undo the position quantisation
+	struct position_transform position_transform;
+	//lod 0 is always the whole index buffer
+	struct mesh_lod lods[MESH_MAX_LODS];
+	uint32_t lod_count;
+};
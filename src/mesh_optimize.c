@@ -0,0 +1,363 @@
+//plain old C headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "basic_helpers.h"
+#include "profiler.h"
+#include "obj_import.h"
+#include "mesh_optimize.h"
+
+//forsyth's scores, worked out ahead of time so nothing here needs libm
+//by position in the lru cache, the three most recent are flattened so the triangle just drawn isnt favoured over its neighbours
+static const float cache_position_scores[VERTEX_CACHE_OPTIMIZE_SIZE] = {
+	0.750000f, 0.750000f, 0.750000f, 1.000000f, 0.948724f, 0.898356f, 0.848913f, 0.800411f,
+	0.752870f, 0.706309f, 0.660750f, 0.616215f, 0.572727f, 0.530314f, 0.489003f, 0.448824f,
+	0.409810f, 0.371997f, 0.335425f, 0.300136f, 0.266180f, 0.233610f, 0.202490f, 0.172889f,
+	0.144890f, 0.118591f, 0.094109f, 0.071591f, 0.051226f, 0.033272f, 0.018111f, 0.006403f
+};
+//2 / sqrt(triangles left), vertices with few triangles left are finished off first so they can leave the cache
+static const float valence_scores[32] = {
+	2.000000f, 1.414214f, 1.154701f, 1.000000f, 0.894427f, 0.816497f, 0.755929f, 0.707107f,
+	0.666667f, 0.632456f, 0.603023f, 0.577350f, 0.554700f, 0.534522f, 0.516398f, 0.500000f,
+	0.485071f, 0.471405f, 0.458831f, 0.447214f, 0.436436f, 0.426401f, 0.417029f, 0.408248f,
+	0.400000f, 0.392232f, 0.384900f, 0.377964f, 0.371391f, 0.365148f, 0.359211f, 0.353553f
+};
+
+struct vertex_cache_stats analyze_vertex_cache(const uint32_t *indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size){
+	struct vertex_cache_stats stats = {0};
+	uint32_t *timestamps = calloc(vertex_count ? vertex_count : 1, sizeof *timestamps);
+	if (!timestamps || index_count < 3)
+		return free(timestamps), stats;
+
+	//a fifo, a vertex is still cached if fewer than cache_size others went in after it
+	uint32_t time = cache_size + 1;
+	for (uint32_t i = 0; i < index_count; i++){
+		uint32_t v = indices[i];
+		if (time - timestamps[v] > cache_size){
+			timestamps[v] = time++;
+			stats.transformed++;
+		}
+	}
+	free(timestamps);
+
+	stats.acmr = (float)stats.transformed / (index_count / 3);
+	stats.atvr = vertex_count ? (float)stats.transformed / vertex_count : 0.0f;
+	return stats;
+}
+
+static float vertex_score(int32_t cache_position, uint32_t live_triangles){
+	if (live_triangles == 0)
+		return -1.0f;
+
+	float score = cache_position >= 0 ? cache_position_scores[cache_position] : 0.0f;
+	return score + valence_scores[(live_triangles < 32 ? live_triangles : 32) - 1];
+}
+
+void optimize_vertex_cache(uint32_t *indices, uint32_t index_count, uint32_t vertex_count){
+	PROFILE_BEGIN("optimize_vertex_cache");
+	uint32_t triangle_count = index_count / 3;
+
+	uint32_t *live = calloc(vertex_count, sizeof *live);
+	uint32_t *offsets = malloc(sizeof *offsets * (vertex_count + 1));
+	uint32_t *adjacency = malloc(sizeof *adjacency * index_count);
+	int32_t *cache_position = malloc(sizeof *cache_position * vertex_count);
+	float *scores = malloc(sizeof *scores * vertex_count);
+	float *triangle_scores = malloc(sizeof *triangle_scores * triangle_count);
+	bool *emitted = calloc(triangle_count, sizeof *emitted);
+	uint32_t *output = malloc(sizeof *output * index_count);
+
+	if (!live || !offsets || !adjacency || !cache_position || !scores || !triangle_scores || !emitted || !output){
+		printf("Error: failed to allocate vertex cache optimiser");
+		goto done;
+	}
+
+	//every vertex's triangles in one array, a vertex's live ones are kept at the front of its range
+	for (uint32_t i = 0; i < index_count; i++)
+		live[indices[i]]++;
+	offsets[0] = 0;
+	for (uint32_t v = 0; v < vertex_count; v++)
+		offsets[v + 1] = offsets[v] + live[v];
+	for (uint32_t v = 0; v < vertex_count; v++)
+		live[v] = 0;
+	for (uint32_t t = 0; t < triangle_count; t++){
+		for (int k = 0; k < 3; k++){
+			uint32_t v = indices[t * 3 + k];
+			adjacency[offsets[v] + live[v]++] = t;
+		}
+	}
+
+	for (uint32_t v = 0; v < vertex_count; v++){
+		cache_position[v] = -1;
+		scores[v] = vertex_score(-1, live[v]);
+	}
+
+	int64_t best = -1;
+	float best_score = -1.0f;
+	for (uint32_t t = 0; t < triangle_count; t++){
+		triangle_scores[t] = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+		if (triangle_scores[t] > best_score){
+			best_score = triangle_scores[t];
+			best = t;
+		}
+	}
+
+	uint32_t cache[VERTEX_CACHE_OPTIMIZE_SIZE + 3];
+	uint32_t cache_count = 0;
+	//when nothing in the cache has triangles left the next unemitted one in input order is taken
+	uint32_t cursor = 0;
+
+	for (uint32_t out = 0; out < triangle_count; out++){
+		if (best < 0){
+			while (emitted[cursor])
+				cursor++;
+			best = cursor;
+		}
+
+		uint32_t t = (uint32_t)best;
+		const uint32_t *triangle = &indices[t * 3];
+		memcpy(&output[out * 3], triangle, sizeof *triangle * 3);
+		emitted[t] = true;
+
+		//takes the triangle out of each of its vertices' live ranges
+		for (int k = 0; k < 3; k++){
+			uint32_t v = triangle[k];
+			uint32_t *list = &adjacency[offsets[v]];
+			for (uint32_t j = 0; j < live[v]; j++){
+				if (list[j] == t){
+					list[j] = list[--live[v]];
+					list[live[v]] = t;
+					break;
+				}
+			}
+		}
+
+		//the triangle's vertices go to the front, everything else moves back and whatever falls off the end is evicted
+		uint32_t next[VERTEX_CACHE_OPTIMIZE_SIZE + 3];
+		uint32_t next_count = 0;
+		for (int k = 0; k < 3; k++){
+			if (k == 0 || triangle[k] != triangle[0]){
+				if (k < 2 || triangle[2] != triangle[1])
+					next[next_count++] = triangle[k];
+			}
+		}
+		for (uint32_t i = 0; i < cache_count; i++){
+			uint32_t v = cache[i];
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				next[next_count++] = v;
+		}
+
+		for (uint32_t i = 0; i < next_count; i++){
+			uint32_t v = next[i];
+			cache_position[v] = i < VERTEX_CACHE_OPTIMIZE_SIZE ? (int32_t)i : -1;
+			scores[v] = vertex_score(cache_position[v], live[v]);
+		}
+
+		//only triangles touching the cache are considered, anything else is left to the cursor
+		best = -1;
+		best_score = -1.0f;
+		for (uint32_t i = 0; i < next_count; i++){
+			uint32_t v = next[i];
+			const uint32_t *list = &adjacency[offsets[v]];
+			for (uint32_t j = 0; j < live[v]; j++){
+				uint32_t other = list[j];
+				float score = scores[indices[other * 3]] + scores[indices[other * 3 + 1]] + scores[indices[other * 3 + 2]];
+				triangle_scores[other] = score;
+				if (i < VERTEX_CACHE_OPTIMIZE_SIZE && score > best_score){
+					best_score = score;
+					best = other;
+				}
+			}
+		}
+
+		cache_count = next_count < VERTEX_CACHE_OPTIMIZE_SIZE ? next_count : VERTEX_CACHE_OPTIMIZE_SIZE;
+		memcpy(cache, next, sizeof *cache * cache_count);
+	}
+
+	memcpy(indices, output, sizeof *indices * triangle_count * 3);
+
+done:
+	free(live);
+	free(offsets);
+	free(adjacency);
+	free(cache_position);
+	free(scores);
+	free(triangle_scores);
+	free(emitted);
+	free(output);
+	PROFILE_END();
+}
+
+//a run of triangles that is kept together, the key decides where it goes
+struct overdraw_cluster{
+	uint32_t start;
+	uint32_t count;
+	float key;
+};
+
+static int compare_clusters(const void *a, const void *b){
+	float ka = ((const struct overdraw_cluster *)a)->key;
+	float kb = ((const struct overdraw_cluster *)b)->key;
+	return ka < kb ? 1 : ka > kb ? -1 : 0;
+}
+
+//clusters of the cache optimised order are sorted so the ones facing out from the middle of the mesh are drawn first,
+//they are the ones likely to hide the rest, a cluster is only cut where the acmr up to that point stays within
+//threshold of the whole mesh's so the cache order is mostly kept
+void optimize_overdraw(uint32_t *indices, uint32_t index_count, const float *positions, uint32_t position_stride, uint32_t vertex_count, float threshold){
+	PROFILE_BEGIN("optimize_overdraw");
+	uint32_t triangle_count = index_count / 3;
+	struct vertex_cache_stats stats = analyze_vertex_cache(indices, index_count, vertex_count, VERTEX_CACHE_SIMULATED_SIZE);
+
+	struct overdraw_cluster *clusters = malloc(sizeof *clusters * (triangle_count + 1));
+	uint32_t *timestamps = calloc(vertex_count, sizeof *timestamps);
+	uint32_t *sorted = malloc(sizeof *sorted * index_count);
+	if (!clusters || !timestamps || !sorted || triangle_count == 0){
+		free(clusters);
+		free(timestamps);
+		free(sorted);
+		PROFILE_END();
+		return;
+	}
+
+	uint32_t cluster_count = 0;
+	uint32_t time = VERTEX_CACHE_SIMULATED_SIZE + 1;
+	uint32_t misses = 0;
+	uint32_t cluster_start = 0;
+	for (uint32_t t = 0; t < triangle_count; t++){
+		uint32_t triangle_misses = 0;
+		for (int k = 0; k < 3; k++){
+			uint32_t v = indices[t * 3 + k];
+			if (time - timestamps[v] > VERTEX_CACHE_SIMULATED_SIZE){
+				timestamps[v] = time++;
+				triangle_misses++;
+			}
+		}
+		misses += triangle_misses;
+
+		//three misses means the cache order already jumped here so the cut costs nothing
+		bool hard = triangle_misses == 3 && t > cluster_start;
+		bool soft = (float)misses / (t + 1 - cluster_start) <= threshold * stats.acmr;
+		if (hard || soft || t == triangle_count - 1){
+			uint32_t end = hard ? t : t + 1;
+			clusters[cluster_count++] = (struct overdraw_cluster){.start = cluster_start, .count = end - cluster_start};
+			cluster_start = end;
+			misses = hard ? triangle_misses : 0;
+			//the next cluster is simulated as if it started with an empty cache, wherever it ends up being drawn
+			if (!hard)
+				time += VERTEX_CACHE_SIMULATED_SIZE + 1;
+		}
+	}
+	if (cluster_start < triangle_count)
+		clusters[cluster_count++] = (struct overdraw_cluster){.start = cluster_start, .count = triangle_count - cluster_start};
+
+	//the middle of the mesh, every triangle centre weighted the same
+	double middle[3] = {0};
+	for (uint32_t i = 0; i < index_count; i++){
+		const float *p = positions + (size_t)indices[i] * position_stride;
+		for (int c = 0; c < 3; c++)
+			middle[c] += p[c];
+	}
+	for (int c = 0; c < 3; c++)
+		middle[c] /= index_count;
+
+	for (uint32_t i = 0; i < cluster_count; i++){
+		struct overdraw_cluster *cluster = &clusters[i];
+		double centre[3] = {0};
+		double normal[3] = {0};
+		for (uint32_t t = cluster->start; t < cluster->start + cluster->count; t++){
+			const float *a = positions + (size_t)indices[t * 3] * position_stride;
+			const float *b = positions + (size_t)indices[t * 3 + 1] * position_stride;
+			const float *c = positions + (size_t)indices[t * 3 + 2] * position_stride;
+			double ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+			double ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+			//the cross product is twice the area long so bigger triangles count for more
+			normal[0] += ab[1] * ac[2] - ab[2] * ac[1];
+			normal[1] += ab[2] * ac[0] - ab[0] * ac[2];
+			normal[2] += ab[0] * ac[1] - ab[1] * ac[0];
+			for (int k = 0; k < 3; k++)
+				centre[k] += (a[k] + b[k] + c[k]) / 3.0;
+		}
+
+		double facing = 0.0;
+		double length_squared = 0.0;
+		for (int k = 0; k < 3; k++){
+			facing += (centre[k] / cluster->count - middle[k]) * normal[k];
+			length_squared += normal[k] * normal[k];
+		}
+		//the distance along the unit normal, squared with its sign kept which orders the same without a square root
+		cluster->key = length_squared > 0.0 ? (float)(facing * (facing < 0.0 ? -facing : facing) / length_squared) : 0.0f;
+	}
+
+	qsort(clusters, cluster_count, sizeof *clusters, compare_clusters);
+
+	uint32_t written = 0;
+	for (uint32_t i = 0; i < cluster_count; i++){
+		memcpy(&sorted[written], &indices[clusters[i].start * 3], sizeof *sorted * clusters[i].count * 3);
+		written += clusters[i].count * 3;
+	}
+	memcpy(indices, sorted, sizeof *indices * written);
+
+	free(clusters);
+	free(timestamps);
+	free(sorted);
+	PROFILE_END();
+}
+
+//renumbers vertices in the order the indices first use them so vertex fetch walks memory forwards,
+//unused vertices are dropped and the new vertex count is returned, NULL attributes are skipped
+uint32_t optimize_vertex_fetch(uint32_t *indices, uint32_t index_count, uint32_t vertex_count, void *const *attributes, const uint32_t *attribute_sizes, uint32_t attribute_count){
+	PROFILE_BEGIN("optimize_vertex_fetch");
+	uint32_t *remap = malloc(sizeof *remap * vertex_count);
+	if (!remap){
+		PROFILE_END();
+		return vertex_count;
+	}
+	memset(remap, 0xFF, sizeof *remap * vertex_count);
+
+	uint32_t used = 0;
+	for (uint32_t i = 0; i < index_count; i++){
+		uint32_t v = indices[i];
+		if (remap[v] == UINT32_MAX)
+			remap[v] = used++;
+		indices[i] = remap[v];
+	}
+
+	for (uint32_t a = 0; a < attribute_count; a++){
+		unsigned char *data = attributes[a];
+		uint32_t size = attribute_sizes[a];
+		unsigned char *reordered = data ? malloc((size_t)size * (used ? used : 1)) : NULL;
+		if (!reordered)
+			continue;
+		for (uint32_t v = 0; v < vertex_count; v++){
+			if (remap[v] != UINT32_MAX)
+				memcpy(reordered + (size_t)remap[v] * size, data + (size_t)v * size, size);
+		}
+		memcpy(data, reordered, (size_t)size * used);
+		free(reordered);
+	}
+
+	free(remap);
+	PROFILE_END();
+	return used;
+}
+
+void optimize_imported_mesh(struct imported_mesh *mesh){
+	if (!mesh->index_count)
+		return;
+
+	struct vertex_cache_stats before = analyze_vertex_cache(mesh->indices, mesh->index_count, mesh->vertex_count, VERTEX_CACHE_SIMULATED_SIZE);
+	optimize_vertex_cache(mesh->indices, mesh->index_count, mesh->vertex_count);
+	struct vertex_cache_stats cached = analyze_vertex_cache(mesh->indices, mesh->index_count, mesh->vertex_count, VERTEX_CACHE_SIMULATED_SIZE);
+	optimize_overdraw(mesh->indices, mesh->index_count, mesh->positions, 3, mesh->vertex_count, OVERDRAW_ACMR_THRESHOLD);
+
+	void *attributes[] = {mesh->positions, mesh->normals, mesh->texcoords};
+	uint32_t attribute_sizes[] = {sizeof(float) * 3, sizeof(float) * 3, sizeof(float) * 2};
+	mesh->vertex_count = optimize_vertex_fetch(mesh->indices, mesh->index_count, mesh->vertex_count, attributes, attribute_sizes, 3);
+	struct vertex_cache_stats after = analyze_vertex_cache(mesh->indices, mesh->index_count, mesh->vertex_count, VERTEX_CACHE_SIMULATED_SIZE);
+
+	printf("Vertex cache (fifo %d): acmr %.3f -> %.3f after reordering -> %.3f after overdraw sorting, atvr %.3f -> %.3f\n", VERTEX_CACHE_SIMULATED_SIZE,
+		before.acmr, cached.acmr, after.acmr, before.atvr, after.atvr);
+}
@@ -0,0 +1,29 @@
+//the fifo size the stats are simulated with, small enough to stand in for most hardware
+#define VERTEX_CACHE_SIMULATED_SIZE 16
+//the lru size the cache optimiser scores for, the tables in mesh_optimize.c are built for it
+#define VERTEX_CACHE_OPTIMIZE_SIZE 32
+//how much worse than the cache optimised order the overdraw clusters may make the acmr
+#define OVERDRAW_ACMR_THRESHOLD 1.05f
+
+//forward declarations of structs defined further down that are passed around by pointer
+struct imported_mesh;
+
+//functions
+
+//index and vertex reordering, none of them change what is drawn only the order it is drawn and fetched in
+struct vertex_cache_stats analyze_vertex_cache(const uint32_t *indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size);
+void optimize_vertex_cache(uint32_t *indices, uint32_t index_count, uint32_t vertex_count);
+void optimize_overdraw(uint32_t *indices, uint32_t index_count, const float *positions, uint32_t position_stride, uint32_t vertex_count, float threshold);
+uint32_t optimize_vertex_fetch(uint32_t *indices, uint32_t index_count, uint32_t vertex_count, void *const *attributes, const uint32_t *attribute_sizes, uint32_t attribute_count);
+void optimize_imported_mesh(struct imported_mesh *mesh);
+
+
+//structs
+
+//acmr is vertex shader runs per triangle, 0.5 is about the best a regular grid can do and 3 the worst
+//atvr is runs per vertex, 1 means every vertex was only ever transformed once
+struct vertex_cache_stats{
+	uint32_t transformed;
+	float acmr;
+	float atvr;
+};
@@ -0,0 +1,401 @@
+//plain old C headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+//GLFW header
+#define GLFW_INCLUDE_VULKAN
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include "host_allocator.h"
+#include "gpu_timer.h"
+#include "vulkan_helpers.h"
+#include "upload_manager.h"
+#include "mesh.h"
+#include "obj_import.h"
+#include "mesh_optimize.h"
+#include "mesh_simplify.h"
+#include "basic_helpers.h"
+#include "profiler.h"
+
+//the sum of squared distances to a set of planes, each weighted by its triangle's area, as a symmetric 4x4 matrix
+//dividing by the total weight turns an evaluation into a mean so the cost doesnt grow with how much got merged
+struct quadric{
+	float a00, a11, a22, a01, a02, a12;
+	float b0, b1, b2;
+	float c;
+	float w;
+};
+
+//one possible collapse of u onto v, u disappears and its triangles are stretched over to v
+struct collapse{
+	float cost;
+	uint32_t u;
+	uint32_t v;
+};
+
+static struct quadric plane_quadric(const float n[3], float d, float w){
+	struct quadric q;
+	q.a00 = w * n[0] * n[0];
+	q.a11 = w * n[1] * n[1];
+	q.a22 = w * n[2] * n[2];
+	q.a01 = w * n[0] * n[1];
+	q.a02 = w * n[0] * n[2];
+	q.a12 = w * n[1] * n[2];
+	q.b0 = w * n[0] * d;
+	q.b1 = w * n[1] * d;
+	q.b2 = w * n[2] * d;
+	q.c = w * d * d;
+	q.w = w;
+	return q;
+}
+
+static void quadric_add(struct quadric *q, const struct quadric *r){
+	q->a00 += r->a00;
+	q->a11 += r->a11;
+	q->a22 += r->a22;
+	q->a01 += r->a01;
+	q->a02 += r->a02;
+	q->a12 += r->a12;
+	q->b0 += r->b0;
+	q->b1 += r->b1;
+	q->b2 += r->b2;
+	q->c += r->c;
+	q->w += r->w;
+}
+
+static float quadric_error(const struct quadric *q, const float p[3]){
+	float x = p[0], y = p[1], z = p[2];
+	float r = q->a00 * x * x + q->a11 * y * y + q->a22 * z * z;
+	r += 2.0f * (q->a01 * x * y + q->a02 * x * z + q->a12 * y * z);
+	r += 2.0f * (q->b0 * x + q->b1 * y + q->b2 * z);
+	r += q->c;
+	//rounding can take a true 0 slightly negative
+	r = r < 0.0f ? -r : r;
+	return q->w > 0.0f ? r / q->w : r;
+}
+
+static void triangle_normal(const float *a, const float *b, const float *c, float n[3]){
+	float ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+	float ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+	n[0] = ab[1] * ac[2] - ab[2] * ac[1];
+	n[1] = ab[2] * ac[0] - ab[0] * ac[2];
+	n[2] = ab[0] * ac[1] - ab[1] * ac[0];
+}
+
+//costs are never negative so their bits sort the same way the floats do, three 11 bit radix passes beat qsort by a lot here
+//ping pongs between the two arrays and returns whichever ended up holding the sorted order
+static struct collapse *sort_collapses(struct collapse *collapses, struct collapse *scratch, uint32_t count){
+	uint32_t histogram[3][2048] = {{0}};
+	for (uint32_t i = 0; i < count; i++){
+		uint32_t key;
+		memcpy(&key, &collapses[i].cost, sizeof key);
+		histogram[0][key & 2047]++;
+		histogram[1][(key >> 11) & 2047]++;
+		histogram[2][key >> 22]++;
+	}
+
+	for (int pass = 0; pass < 3; pass++){
+		uint32_t sum = 0;
+		for (uint32_t d = 0; d < 2048; d++){
+			uint32_t bucket = histogram[pass][d];
+			histogram[pass][d] = sum;
+			sum += bucket;
+		}
+		for (uint32_t i = 0; i < count; i++){
+			uint32_t key;
+			memcpy(&key, &collapses[i].cost, sizeof key);
+			scratch[histogram[pass][(key >> (pass * 11)) & 2047]++] = collapses[i];
+		}
+		struct collapse *sorted = scratch;
+		scratch = collapses;
+		collapses = sorted;
+	}
+	return collapses;
+}
+
+static uint32_t hash_position(const float *p){
+	uint32_t bits[3];
+	memcpy(bits, p, sizeof bits);
+	return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+}
+
+//points every vertex at the first one sharing its position, copies split by a normal or texcoord seam end up together
+static void remap_positions(const float *positions, uint32_t vertex_count, uint32_t *remap){
+	uint32_t table_size = 1;
+	while (table_size < vertex_count * 2)
+		table_size *= 2;
+	uint32_t *table = malloc(sizeof *table * table_size);
+	if (!table){
+		for (uint32_t v = 0; v < vertex_count; v++)
+			remap[v] = v;
+		return;
+	}
+	memset(table, 0xFF, sizeof *table * table_size);
+
+	for (uint32_t v = 0; v < vertex_count; v++){
+		uint32_t slot = hash_position(&positions[v * 3]) & (table_size - 1);
+		while (table[slot] != UINT32_MAX && memcmp(&positions[table[slot] * 3], &positions[v * 3], sizeof(float) * 3) != 0)
+			slot = (slot + 1) & (table_size - 1);
+		if (table[slot] == UINT32_MAX)
+			table[slot] = v;
+		remap[v] = table[slot];
+	}
+	free(table);
+}
+
+//every position's triangles in one array, rebuilt whenever the triangles change
+static void build_adjacency(const uint32_t *indices, uint32_t index_count, const uint32_t *remap, uint32_t vertex_count, uint32_t *offsets, uint32_t *adjacency){
+	memset(offsets, 0, sizeof *offsets * (vertex_count + 1));
+	for (uint32_t i = 0; i < index_count; i++)
+		offsets[remap[indices[i]] + 1]++;
+	for (uint32_t v = 0; v < vertex_count; v++)
+		offsets[v + 1] += offsets[v];
+	for (uint32_t i = 0; i < index_count; i++){
+		uint32_t v = remap[indices[i]];
+		adjacency[offsets[v]++] = i / 3;
+	}
+	//the fill moved every offset along to the next one's start
+	for (uint32_t v = vertex_count; v > 0; v--)
+		offsets[v] = offsets[v - 1];
+	offsets[0] = 0;
+}
+
+//true if moving u's position to v's turns any of u's remaining triangles over
+static bool collapse_flips(const uint32_t *indices, const uint32_t *remap, const uint32_t *offsets, const uint32_t *adjacency, const float *positions, uint32_t ru, uint32_t rv, uint32_t v){
+	for (uint32_t j = offsets[ru]; j < offsets[ru + 1]; j++){
+		const uint32_t *triangle = &indices[adjacency[j] * 3];
+		uint32_t r[3] = {remap[triangle[0]], remap[triangle[1]], remap[triangle[2]]};
+		//triangles along the edge are about to disappear
+		if (r[0] == rv || r[1] == rv || r[2] == rv)
+			continue;
+
+		const float *p[3];
+		const float *moved[3];
+		for (int k = 0; k < 3; k++){
+			p[k] = &positions[r[k] * 3];
+			moved[k] = r[k] == ru ? &positions[v * 3] : p[k];
+		}
+		float before[3], after[3];
+		triangle_normal(p[0], p[1], p[2], before);
+		triangle_normal(moved[0], moved[1], moved[2], after);
+		if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0f)
+			return true;
+	}
+	return false;
+}
+
+uint32_t simplify_mesh(uint32_t *destination, const uint32_t *indices, uint32_t index_count, const float *positions, uint32_t vertex_count, uint32_t target_index_count, float *error){
+	PROFILE_BEGIN("simplify_mesh");
+	*error = 0.0f;
+	index_count -= index_count % 3;
+	memmove(destination, indices, sizeof *indices * index_count);
+	if (index_count <= target_index_count || vertex_count == 0){
+		PROFILE_END();
+		return index_count;
+	}
+
+	uint32_t *remap = malloc(sizeof *remap * vertex_count);
+	uint32_t *group_size = calloc(vertex_count, sizeof *group_size);
+	float *scaled = malloc(sizeof *scaled * 3 * vertex_count);
+	struct quadric *quadrics = calloc(vertex_count, sizeof *quadrics);
+	uint32_t *offsets = malloc(sizeof *offsets * (vertex_count + 1));
+	uint32_t *adjacency = malloc(sizeof *adjacency * index_count);
+	struct collapse *collapse_buffers[2] = {malloc(sizeof(struct collapse) * index_count), malloc(sizeof(struct collapse) * index_count)};
+	uint32_t *collapse_to = malloc(sizeof *collapse_to * vertex_count);
+	bool *touched = malloc(sizeof *touched * vertex_count);
+	if (!remap || !group_size || !scaled || !quadrics || !offsets || !adjacency || !collapse_buffers[0] || !collapse_buffers[1] || !collapse_to || !touched){
+		printf("Error: failed to allocate mesh simplifier");
+		goto done;
+	}
+
+	//quadrics are kept in floats so everything is scaled into a unit box first, the error is scaled back at the end
+	struct mesh_bounds bounds = compute_mesh_bounds(VK_FORMAT_R32G32B32_SFLOAT, positions, vertex_count);
+	float extent = 0.0f;
+	for (int c = 0; c < 3; c++)
+		extent = MAX(extent, bounds.max[c] - bounds.min[c]);
+	float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+	for (uint32_t v = 0; v < vertex_count; v++){
+		for (int c = 0; c < 3; c++)
+			scaled[v * 3 + c] = (positions[v * 3 + c] - bounds.min[c]) * scale;
+	}
+
+	//a position used by more than one vertex sits on a seam, moving it would tear the seam open so it stays put
+	remap_positions(positions, vertex_count, remap);
+	for (uint32_t v = 0; v < vertex_count; v++)
+		collapse_to[v] = v;
+	for (uint32_t i = 0; i < index_count; i++){
+		uint32_t v = destination[i];
+		if (collapse_to[v] == v){
+			collapse_to[v] = UINT32_MAX;
+			group_size[remap[v]]++;
+		}
+	}
+	for (uint32_t v = 0; v < vertex_count; v++)
+		collapse_to[v] = v;
+
+	build_adjacency(destination, index_count, remap, vertex_count, offsets, adjacency);
+	for (uint32_t t = 0; t < index_count / 3; t++){
+		const uint32_t *triangle = &destination[t * 3];
+		uint32_t r[3] = {remap[triangle[0]], remap[triangle[1]], remap[triangle[2]]};
+		float n[3];
+		triangle_normal(&scaled[r[0] * 3], &scaled[r[1] * 3], &scaled[r[2] * 3], n);
+		float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0.0f)
+			continue;
+		for (int k = 0; k < 3; k++)
+			n[k] /= length;
+
+		const float *a = &scaled[r[0] * 3];
+		struct quadric plane = plane_quadric(n, -(n[0] * a[0] + n[1] * a[1] + n[2] * a[2]), length * 0.5f);
+		for (int k = 0; k < 3; k++)
+			quadric_add(&quadrics[r[k]], &plane);
+
+		//an edge with no triangle running back along it is a border, it gets a wall standing up from the triangle
+		for (int k = 0; k < 3; k++){
+			uint32_t ra = r[k], rb = r[(k + 1) % 3];
+			bool shared = false;
+			for (uint32_t j = offsets[rb]; j < offsets[rb + 1] && !shared; j++){
+				const uint32_t *other = &destination[adjacency[j] * 3];
+				for (int m = 0; m < 3; m++)
+					shared |= remap[other[m]] == rb && remap[other[(m + 1) % 3]] == ra;
+			}
+			if (shared)
+				continue;
+
+			const float *pa = &scaled[ra * 3], *pb = &scaled[rb * 3];
+			float edge[3] = {pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2]};
+			float wall[3] = {edge[1] * n[2] - edge[2] * n[1], edge[2] * n[0] - edge[0] * n[2], edge[0] * n[1] - edge[1] * n[0]};
+			float wall_length = sqrtf(wall[0] * wall[0] + wall[1] * wall[1] + wall[2] * wall[2]);
+			if (wall_length == 0.0f)
+				continue;
+			for (int c = 0; c < 3; c++)
+				wall[c] /= wall_length;
+			float edge_squared = edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2];
+			struct quadric border = plane_quadric(wall, -(wall[0] * pa[0] + wall[1] * pa[1] + wall[2] * pa[2]), edge_squared * SIMPLIFY_BORDER_WEIGHT);
+			quadric_add(&quadrics[ra], &border);
+			quadric_add(&quadrics[rb], &border);
+		}
+	}
+
+	//each pass takes the cheapest collapses that dont touch each other's neighbourhoods, then rebuilds and goes again
+	float max_cost = 0.0f;
+	while (index_count > target_index_count){
+		build_adjacency(destination, index_count, remap, vertex_count, offsets, adjacency);
+
+		struct collapse *collapses = collapse_buffers[0];
+		uint32_t candidate_count = 0;
+		for (uint32_t i = 0; i < index_count; i++){
+			uint32_t u = destination[i];
+			uint32_t v = destination[i - i % 3 + (i + 1) % 3];
+			uint32_t ru = remap[u], rv = remap[v];
+			if (ru == rv || group_size[ru] != 1)
+				continue;
+			struct quadric merged = quadrics[ru];
+			quadric_add(&merged, &quadrics[rv]);
+			collapses[candidate_count++] = (struct collapse){.cost = quadric_error(&merged, &scaled[rv * 3]), .u = u, .v = v};
+		}
+		collapses = sort_collapses(collapses, collapse_buffers[1], candidate_count);
+
+		//every collapse takes about two triangles with it, and the ones far dearer than the cheapest that would be enough
+		//are left for a later pass, when the neighbourhoods blocked this time may have cheaper ones to offer
+		uint32_t wanted = (index_count - target_index_count) / 6 + 1;
+		float cost_limit = candidate_count ? collapses[MIN(wanted, candidate_count - 1)].cost * 1.5f : 0.0f;
+		uint32_t applied = 0;
+		memset(touched, 0, sizeof *touched * vertex_count);
+		for (uint32_t c = 0; c < candidate_count && applied < wanted && collapses[c].cost <= cost_limit; c++){
+			uint32_t u = collapses[c].u, v = collapses[c].v;
+			uint32_t ru = remap[u], rv = remap[v];
+			if (touched[ru] || touched[rv] || collapse_flips(destination, remap, offsets, adjacency, scaled, ru, rv, v))
+				continue;
+
+			collapse_to[u] = v;
+			quadric_add(&quadrics[rv], &quadrics[ru]);
+			max_cost = MAX(max_cost, collapses[c].cost);
+			applied++;
+
+			//the ring around u is about to change shape, so nothing in it can be judged on this pass's adjacency again
+			for (uint32_t j = offsets[ru]; j < offsets[ru + 1]; j++){
+				const uint32_t *triangle = &destination[adjacency[j] * 3];
+				for (int k = 0; k < 3; k++)
+					touched[remap[triangle[k]]] = true;
+			}
+		}
+		if (applied == 0)
+			break;
+
+		//triangles that lost an edge are dropped, the rest are compacted in place keeping their order
+		uint32_t written = 0;
+		for (uint32_t i = 0; i < index_count; i += 3){
+			uint32_t a = collapse_to[destination[i]], b = collapse_to[destination[i + 1]], c = collapse_to[destination[i + 2]];
+			if (remap[a] == remap[b] || remap[b] == remap[c] || remap[a] == remap[c])
+				continue;
+			destination[written++] = a;
+			destination[written++] = b;
+			destination[written++] = c;
+		}
+		index_count = written;
+		for (uint32_t c = 0; c < candidate_count; c++)
+			collapse_to[collapses[c].u] = collapses[c].u;
+	}
+
+	*error = sqrtf(max_cost) * extent;
+
+done:
+	free(remap);
+	free(group_size);
+	free(scaled);
+	free(quadrics);
+	free(offsets);
+	free(adjacency);
+	free(collapse_buffers[0]);
+	free(collapse_buffers[1]);
+	free(collapse_to);
+	free(touched);
+	PROFILE_END();
+	return index_count;
+}
+
+uint32_t generate_mesh_lods(struct imported_mesh *mesh, struct mesh_lod *lods, uint32_t max_lods){
+	PROFILE_BEGIN("generate_mesh_lods");
+	uint64_t start = get_time_ns();
+	lods[0] = (struct mesh_lod){.first_index = 0, .index_count = mesh->index_count, .error = 0.0f};
+	uint32_t lod_count = 1;
+
+	uint32_t *level = malloc(sizeof *level * (mesh->index_count ? mesh->index_count : 1));
+	while (level && lod_count < max_lods){
+		const struct mesh_lod *previous = &lods[lod_count - 1];
+		if (previous->index_count / 3 <= LOD_MIN_TRIANGLES)
+			break;
+
+		uint32_t target = (uint32_t)(previous->index_count / 3 * LOD_REDUCTION) * 3;
+		float error;
+		uint32_t count = simplify_mesh(level, mesh->indices + previous->first_index, previous->index_count, mesh->positions, mesh->vertex_count, target, &error);
+		if (count == 0 || count > previous->index_count * LOD_MIN_REDUCTION)
+			break;
+
+		uint32_t *grown = realloc(mesh->indices, sizeof *grown * ((size_t)mesh->index_count + count));
+		if (!grown){
+			printf("Error: failed to grow indices for lod %u", lod_count);
+			break;
+		}
+		mesh->indices = grown;
+		optimize_vertex_cache(level, count, mesh->vertex_count);
+		memcpy(mesh->indices + mesh->index_count, level, sizeof *level * count);
+
+		//each level is simplified from the one before, so its distance from the full mesh is at most the sum of the steps
+		lods[lod_count] = (struct mesh_lod){.first_index = mesh->index_count, .index_count = count, .error = previous->error + error};
+		mesh->index_count += count;
+		lod_count++;
+	}
+	free(level);
+
+	printf("Generated %u levels of detail from %u down to %u triangles in %.1f ms\n", lod_count, lods[0].index_count / 3,
+		lods[lod_count - 1].index_count / 3, (get_time_ns() - start) / 1e6);
+	PROFILE_END();
+	return lod_count;
+}
@@ -0,0 +1,21 @@
+//each level aims for this fraction of the triangles of the one before it
+#define LOD_REDUCTION 0.5f
+//a level that cant get below this fraction of the one before it isnt worth the index memory, and the chain stops there
+#define LOD_MIN_REDUCTION 0.85f
+//no point simplifying below this many triangles
+#define LOD_MIN_TRIANGLES 64
+//border edges get a plane perpendicular to their triangle this many times heavier than the triangle's own, so holes keep their outline
+#define SIMPLIFY_BORDER_WEIGHT 10.0f
+
+//forward declarations of structs defined further down that are passed around by pointer
+struct imported_mesh;
+struct mesh_lod;
+
+//functions
+
+//quadric error edge collapse onto existing vertices, so every level shares the vertex buffer
+//vertices on attribute seams are never moved, error is how far the result strays from the input in position units
+uint32_t simplify_mesh(uint32_t *destination, const uint32_t *indices, uint32_t index_count, const float *positions, uint32_t vertex_count, uint32_t target_index_count, float *error);
+
+//appends every level after the first to the mesh's indices and fills in the table, returns how many levels there are
+uint32_t generate_mesh_lods(struct imported_mesh *mesh, struct mesh_lod *lods, uint32_t max_lods);
@@ -0,0 +1,361 @@
+//plain old C headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+
+//GLFW header
+#define GLFW_INCLUDE_VULKAN
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include "host_allocator.h"
+#include "gpu_timer.h"
+#include "vulkan_helpers.h"
+#include "upload_manager.h"
+#include "mesh.h"
+#include "meshlet.h"
+#include "basic_helpers.h"
+#include "profiler.h"
+
+//fills in the sphere and cone once every triangle of the meshlet is known
+static void bound_meshlet(struct meshlet *meshlet, const uint32_t *indices, const float *positions){
+	const uint32_t *triangles = &indices[meshlet->first_index];
+	uint32_t triangle_count = meshlet->index_count / 3;
+
+	//the sphere is centred on the box around the vertices, not the tightest sphere but close enough for culling
+	float min[3], max[3];
+	for (int c = 0; c < 3; c++)
+		min[c] = max[c] = positions[triangles[0] * 3 + c];
+	for (uint32_t i = 1; i < meshlet->index_count; i++){
+		const float *p = &positions[triangles[i] * 3];
+		for (int c = 0; c < 3; c++){
+			min[c] = MIN(min[c], p[c]);
+			max[c] = MAX(max[c], p[c]);
+		}
+	}
+	float radius_squared = 0.0f;
+	for (int c = 0; c < 3; c++)
+		meshlet->center[c] = (min[c] + max[c]) * 0.5f;
+	for (uint32_t i = 0; i < meshlet->index_count; i++){
+		const float *p = &positions[triangles[i] * 3];
+		float dx = p[0] - meshlet->center[0], dy = p[1] - meshlet->center[1], dz = p[2] - meshlet->center[2];
+		radius_squared = MAX(radius_squared, dx * dx + dy * dy + dz * dz);
+	}
+	meshlet->radius = sqrtf(radius_squared);
+
+	//the cone axis is the average of the unit normals and its width is the normal furthest from it
+	float normals[MESHLET_MAX_TRIANGLES][3];
+	uint32_t normal_count = 0;
+	float axis[3] = {0.0f, 0.0f, 0.0f};
+	for (uint32_t t = 0; t < triangle_count; t++){
+		const float *a = &positions[triangles[t * 3] * 3];
+		const float *b = &positions[triangles[t * 3 + 1] * 3];
+		const float *c = &positions[triangles[t * 3 + 2] * 3];
+		float ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+		float ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+		float n[3] = {ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0]};
+		float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		//degenerate triangles never get drawn so they dont get a say in the cone
+		if (length == 0.0f)
+			continue;
+		for (int k = 0; k < 3; k++){
+			normals[normal_count][k] = n[k] / length;
+			axis[k] += normals[normal_count][k];
+		}
+		normal_count++;
+	}
+
+	float axis_length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	meshlet->cone_cutoff = 2.0f;
+	if (normal_count == 0 || axis_length == 0.0f)
+		return;
+	for (int k = 0; k < 3; k++)
+		meshlet->cone_axis[k] = axis[k] / axis_length;
+
+	float min_dot = 1.0f;
+	for (uint32_t i = 0; i < normal_count; i++){
+		float dot = normals[i][0] * meshlet->cone_axis[0] + normals[i][1] * meshlet->cone_axis[1] + normals[i][2] * meshlet->cone_axis[2];
+		min_dot = MIN(min_dot, dot);
+	}
+	//every normal is within acos(min_dot) of the axis, so all of them face away once the view is within asin(min_dot)
+	//of the axis, which is cos of the view angle being above sqrt(1 - min_dot^2)
+	if (min_dot > MESHLET_CONE_MIN_DOT)
+		meshlet->cone_cutoff = sqrtf(1.0f - min_dot * min_dot);
+}
+
+//bounds the finished meshlet and appends it, growing the array as needed
+static bool push_meshlet(struct meshlet_set *set, uint32_t *capacity, struct meshlet *meshlet, const uint32_t *indices, const float *positions){
+	if (set->meshlet_count == *capacity){
+		struct meshlet *grown = realloc(set->meshlets, sizeof *set->meshlets * *capacity * 2);
+		if (!grown){
+			printf("Error: failed to grow meshlets");
+			return false;
+		}
+		set->meshlets = grown;
+		*capacity *= 2;
+	}
+
+	bound_meshlet(meshlet, indices, positions);
+	set->meshlets[set->meshlet_count++] = *meshlet;
+	return true;
+}
+
+struct meshlet_set build_meshlets(const uint32_t *indices, uint32_t index_count, const float *positions, uint32_t vertex_count){
+	PROFILE_BEGIN("build_meshlets");
+	struct meshlet_set set = {0};
+	uint32_t triangle_count = index_count / 3;
+
+	//which meshlet last used each vertex, so a vertex is only counted once per meshlet
+	uint32_t *last_meshlet = malloc(sizeof *last_meshlet * (vertex_count ? vertex_count : 1));
+	uint32_t capacity = triangle_count / MESHLET_MAX_TRIANGLES * 2 + 1;
+	set.meshlets = malloc(sizeof *set.meshlets * capacity);
+	if (!last_meshlet || !set.meshlets){
+		printf("Error: failed to allocate meshlets");
+		free(last_meshlet);
+		free(set.meshlets);
+		PROFILE_END();
+		return (struct meshlet_set){0};
+	}
+	memset(last_meshlet, 0xFF, sizeof *last_meshlet * vertex_count);
+
+	bool ok = true;
+	struct meshlet current = {0};
+	for (uint32_t t = 0; ok && t < triangle_count; t++){
+		const uint32_t *triangle = &indices[t * 3];
+		uint32_t new_vertices = 0;
+		uint32_t distinct = 0;
+		for (int k = 0; k < 3; k++){
+			bool repeated = (k > 0 && triangle[k] == triangle[0]) || (k > 1 && triangle[k] == triangle[1]);
+			new_vertices += !repeated && last_meshlet[triangle[k]] != set.meshlet_count;
+			distinct += !repeated;
+		}
+
+		//a triangle that doesnt fit starts the next meshlet, where all of its vertices are new
+		if (current.vertex_count + new_vertices > MESHLET_MAX_VERTICES || current.index_count == MESHLET_MAX_TRIANGLES * 3){
+			ok = push_meshlet(&set, &capacity, &current, indices, positions);
+			current = (struct meshlet){.first_index = t * 3};
+			new_vertices = distinct;
+		}
+
+		for (int k = 0; k < 3; k++)
+			last_meshlet[triangle[k]] = set.meshlet_count;
+		current.vertex_count += new_vertices;
+		current.index_count += 3;
+	}
+	if (ok && current.index_count)
+		ok = push_meshlet(&set, &capacity, &current, indices, positions);
+	free(last_meshlet);
+
+	if (!ok){
+		destroy_meshlets(&set);
+		PROFILE_END();
+		return set;
+	}
+
+	printf("Built %u meshlets of up to %d vertices and %d triangles\n", set.meshlet_count, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+	PROFILE_END();
+	return set;
+}
+
+void destroy_meshlets(struct meshlet_set *meshlets){
+	free(meshlets->meshlets);
+	*meshlets = (struct meshlet_set){0};
+}
+
+static VkDescriptorSetLayout create_cluster_cull_set_layout(VkDevice device){
+	//meshlets, the mesh's indices, the compacted indices and the indirect draw, in that order
+	VkDescriptorSetLayoutBinding bindings[4] = {0};
+	for (uint32_t i = 0; i < ARR_SIZE(bindings); i++){
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo create_info = {0};
+	create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	create_info.bindingCount = ARR_SIZE(bindings);
+	create_info.pBindings = bindings;
+
+	VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+	if (vkCreateDescriptorSetLayout(device, &create_info, HOST_ALLOCATOR, &set_layout) != VK_SUCCESS)
+		printf("Error: failed to create cluster cull descriptor set layout");
+	return set_layout;
+}
+
+static void write_cluster_cull_set(VkDevice device, struct cluster_culler *culler){
+	VkDescriptorBufferInfo buffers[4] = {
+		{culler->meshlet_buffer, 0, VK_WHOLE_SIZE},
+		{culler->source_indices, 0, VK_WHOLE_SIZE},
+		{culler->index_buffer, 0, VK_WHOLE_SIZE},
+		{culler->draw_buffer, 0, VK_WHOLE_SIZE}
+	};
+
+	VkWriteDescriptorSet writes[4] = {0};
+	for (uint32_t i = 0; i < ARR_SIZE(writes); i++){
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = culler->descriptor_set;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &buffers[i];
+	}
+	vkUpdateDescriptorSets(device, ARR_SIZE(writes), writes, 0, NULL);
+}
+
+static VkPipeline create_cluster_cull_pipeline(VkDevice device, VkPipelineLayout pipeline_layout, const struct mapped_file *shader){
+	//spir-v has to be 4 byte aligned, which a mapping always is
+	VkShaderModule shader_module = create_shader_module((char *)shader->data, (long)shader->size, device);
+
+	VkComputePipelineCreateInfo pipeline_info = {0};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeline_info.stage.module = shader_module;
+	pipeline_info.stage.pName = "main";
+	pipeline_info.layout = pipeline_layout;
+	pipeline_info.basePipelineIndex = -1;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, HOST_ALLOCATOR, &pipeline) != VK_SUCCESS)
+		printf("Error: failed to create cluster cull pipeline");
+
+	vkDestroyShaderModule(device, shader_module, HOST_ALLOCATOR);
+	return pipeline;
+}
+
+struct cluster_culler create_cluster_culler(VkDevice device, struct gpu_allocator *allocator, struct upload_manager *uploads, const struct mesh *mesh, const struct meshlet_set *meshlets){
+	PROFILE_BEGIN("create_cluster_culler");
+	struct cluster_culler culler = {0};
+	if (meshlets->meshlet_count == 0){
+		PROFILE_END();
+		return culler;
+	}
+
+	struct mapped_file shader = map_file(CLUSTER_CULL_SHADER);
+	if (!shader.data){
+		printf("Cluster culling disabled, the mesh is drawn whole\n");
+		PROFILE_END();
+		return culler;
+	}
+
+	culler.meshlet_count = meshlets->meshlet_count;
+	culler.short_indices = mesh->index_type == VK_INDEX_TYPE_UINT16;
+	culler.source_indices = mesh->index_buffer;
+
+	//the compacted indices are always 32 bit, the worst case is every cluster of the finest level surviving
+	VkDeviceSize meshlet_bytes = sizeof(struct meshlet) * meshlets->meshlet_count;
+	culler.meshlet_buffer = create_device_buffer(device, allocator, meshlet_bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &culler.meshlet_allocation);
+	culler.index_buffer = create_device_buffer(device, allocator, (VkDeviceSize)mesh->lods[0].index_count * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &culler.index_allocation);
+	culler.draw_buffer = create_device_buffer(device, allocator, sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &culler.draw_allocation);
+	upload_buffer(device, uploads, culler.meshlet_buffer, 0, meshlets->meshlets, meshlet_bytes);
+	upload_flush(device, uploads);
+
+	culler.set_layout = create_cluster_cull_set_layout(device);
+
+	VkDescriptorPoolSize pool_size = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4};
+	VkDescriptorPoolCreateInfo pool_info = {0};
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.maxSets = 1;
+	pool_info.poolSizeCount = 1;
+	pool_info.pPoolSizes = &pool_size;
+	if (vkCreateDescriptorPool(device, &pool_info, HOST_ALLOCATOR, &culler.descriptor_pool) != VK_SUCCESS)
+		printf("Error: failed to create cluster cull descriptor pool");
+
+	VkDescriptorSetAllocateInfo set_info = {0};
+	set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	set_info.descriptorPool = culler.descriptor_pool;
+	set_info.descriptorSetCount = 1;
+	set_info.pSetLayouts = &culler.set_layout;
+	if (vkAllocateDescriptorSets(device, &set_info, &culler.descriptor_set) != VK_SUCCESS)
+		printf("Error: failed to allocate cluster cull descriptor set");
+	write_cluster_cull_set(device, &culler);
+
+	VkPushConstantRange push_constant_range = {0};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(struct cluster_cull_constants);
+
+	VkPipelineLayoutCreateInfo layout_info = {0};
+	layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layout_info.setLayoutCount = 1;
+	layout_info.pSetLayouts = &culler.set_layout;
+	layout_info.pushConstantRangeCount = 1;
+	layout_info.pPushConstantRanges = &push_constant_range;
+	if (vkCreatePipelineLayout(device, &layout_info, HOST_ALLOCATOR, &culler.pipeline_layout) != VK_SUCCESS)
+		printf("Error: failed to create cluster cull pipeline layout");
+
+	culler.pipeline = create_cluster_cull_pipeline(device, culler.pipeline_layout, &shader);
+	unmap_file(&shader);
+
+	culler.enabled = culler.pipeline != VK_NULL_HANDLE;
+	printf("Culling %u clusters on the gpu before drawing\n", culler.meshlet_count);
+	PROFILE_END();
+	return culler;
+}
+
+void destroy_cluster_culler(VkDevice device, struct cluster_culler *culler){
+	if (culler->meshlet_count == 0 || culler->set_layout == VK_NULL_HANDLE)
+		return;
+
+	vkDestroyPipeline(device, culler->pipeline, HOST_ALLOCATOR);
+	vkDestroyPipelineLayout(device, culler->pipeline_layout, HOST_ALLOCATOR);
+	//the set goes with its pool
+	vkDestroyDescriptorPool(device, culler->descriptor_pool, HOST_ALLOCATOR);
+	vkDestroyDescriptorSetLayout(device, culler->set_layout, HOST_ALLOCATOR);
+
+	vkDestroyBuffer(device, culler->meshlet_buffer, HOST_ALLOCATOR);
+	gpu_free(device, &culler->meshlet_allocation);
+	vkDestroyBuffer(device, culler->index_buffer, HOST_ALLOCATOR);
+	gpu_free(device, &culler->index_allocation);
+	vkDestroyBuffer(device, culler->draw_buffer, HOST_ALLOCATOR);
+	gpu_free(device, &culler->draw_allocation);
+	*culler = (struct cluster_culler){0};
+}
+
+void cluster_cull_record(VkCommandBuffer command_buffer, const struct cluster_culler *culler, VkExtent2D extent){
+	//the last frame's draw may still be reading the compacted indices, an execution dependency is enough to stop them being overwritten
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 0, NULL);
+
+	//one instance of nothing, the shader adds each surviving cluster's indices to the count
+	VkDrawIndexedIndirectCommand reset = {.indexCount = 0, .instanceCount = 1, .firstIndex = 0, .vertexOffset = 0, .firstInstance = 0};
+	vkCmdUpdateBuffer(command_buffer, culler->draw_buffer, 0, sizeof reset, &reset);
+
+	VkMemoryBarrier reset_barrier = {0};
+	reset_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	reset_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	reset_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &reset_barrier, 0, NULL, 0, NULL);
+
+	struct cluster_cull_constants constants = {0};
+	constants.view_direction[2] = -1.0f;
+	constants.viewport_size[0] = (float)extent.width;
+	constants.viewport_size[1] = (float)extent.height;
+	constants.meshlet_count = culler->meshlet_count;
+	constants.short_indices = culler->short_indices;
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culler->pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culler->pipeline_layout, 0, 1, &culler->descriptor_set, 0, NULL);
+	vkCmdPushConstants(command_buffer, culler->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof constants, &constants);
+
+	uint32_t groups_x = MIN(culler->meshlet_count, CLUSTER_CULL_MAX_GROUPS_X);
+	uint32_t groups_y = (culler->meshlet_count + groups_x - 1) / groups_x;
+	vkCmdDispatch(command_buffer, groups_x, groups_y, 1);
+
+	VkMemoryBarrier cull_barrier = {0};
+	cull_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cull_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cull_barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &cull_barrier, 0, NULL, 0, NULL);
+}
+
+void cluster_cull_draw(VkCommandBuffer command_buffer, const struct cluster_culler *culler){
+	//the mesh's vertex buffers stay bound, only the indices are swapped for the compacted ones
+	vkCmdBindIndexBuffer(command_buffer, culler->index_buffer, 0, VK_INDEX_TYPE_UINT32);
+	vkCmdDrawIndexedIndirect(command_buffer, culler->draw_buffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+}
@@ -0,0 +1,80 @@
+//forward declarations of structs defined further down that are passed around by pointer
+struct meshlet_set;
+struct cluster_culler;
+
+//the usual mesh shader limits, kept so the same clusters could feed one later
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+//a cone whose normals spread further than this from its axis can never be entirely back facing, so it isnt worth testing
+#define MESHLET_CONE_MIN_DOT 0.1f
+//the compiled cluster_cull.comp, culling is switched off when it isnt there
+#define CLUSTER_CULL_SHADER "shaders/cluster_cull.spv"
+//the cull shader's workgroup size, one workgroup per meshlet with its threads copying the indices
+#define CLUSTER_CULL_GROUP_SIZE 64
+//the most workgroups one dispatch dimension is guaranteed to take, bigger meshlet counts spill into y
+#define CLUSTER_CULL_MAX_GROUPS_X 65535
+
+//functions
+
+//meshlet functions, clusters are runs of whole triangles in index order so optimising the order first makes them tighter
+struct meshlet_set build_meshlets(const uint32_t *indices, uint32_t index_count, const float *positions, uint32_t vertex_count);
+void destroy_meshlets(struct meshlet_set *meshlets);
+
+//cluster culling functions, record runs a compute pass outside the render pass and draw replaces mesh_draw inside it
+struct cluster_culler create_cluster_culler(VkDevice device, struct gpu_allocator *allocator, struct upload_manager *uploads, const struct mesh *mesh, const struct meshlet_set *meshlets);
+void destroy_cluster_culler(VkDevice device, struct cluster_culler *culler);
+void cluster_cull_record(VkCommandBuffer command_buffer, const struct cluster_culler *culler, VkExtent2D extent);
+void cluster_cull_draw(VkCommandBuffer command_buffer, const struct cluster_culler *culler);
+
+
+//structs
+
+//one cluster as the cull shader reads it, three std430 vec4s
+//the sphere bounds every vertex, the cone bounds every triangle normal and a cutoff above 1 means it never culls
+//the cluster's triangles are index_count indices from first_index in the mesh's own index buffer
+struct meshlet{
+	float center[3];
+	float radius;
+	float cone_axis[3];
+	float cone_cutoff;
+	uint32_t first_index;
+	uint32_t index_count;
+	uint32_t vertex_count;
+	uint32_t padding;
+};
+
+struct meshlet_set{
+	struct meshlet *meshlets;
+	uint32_t meshlet_count;
+};
+
+//what the cull shader gets pushed each frame
+//with positions drawn straight into clip space and clockwise front faces a triangle faces away when its normal points at -z
+struct cluster_cull_constants{
+	float view_direction[4];
+	float viewport_size[2];
+	uint32_t meshlet_count;
+	VkBool32 short_indices;
+};
+
+//the meshlets, the compacted index buffer the surviving clusters are copied into and the indirect draw that covers them
+//enabled is false when the device or the missing cull shader means the mesh has to be drawn whole
+struct cluster_culler{
+	bool enabled;
+	uint32_t meshlet_count;
+	VkBool32 short_indices;
+
+	VkBuffer source_indices;
+	VkBuffer meshlet_buffer;
+	struct gpu_allocation meshlet_allocation;
+	VkBuffer index_buffer;
+	struct gpu_allocation index_allocation;
+	VkBuffer draw_buffer;
+	struct gpu_allocation draw_allocation;
+
+	VkDescriptorSetLayout set_layout;
+	VkDescriptorPool descriptor_pool;
+	VkDescriptorSet descriptor_set;
+	VkPipelineLayout pipeline_layout;
+	VkPipeline pipeline;
+};
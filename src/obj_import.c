@@ -0,0 +1,534 @@
+//plain old C headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "basic_helpers.h"
+#include "profiler.h"
+#include "obj_import.h"
+
+//a face corner that left out its texcoord or normal
+#define OBJ_MISSING UINT32_MAX
+
+//a triangle corner as indices into the position, texcoord and normal arrays, also the key vertices are deduplicated on
+struct obj_corner{
+	uint32_t position;
+	uint32_t texcoord;
+	uint32_t normal;
+};
+
+//everything the workers fill in, each chunk writes its own range of every array so no locking is needed
+struct obj_arrays{
+	float *positions;
+	float *texcoords;
+	float *normals;
+	struct obj_corner *corners;
+	uint32_t position_count;
+	uint32_t texcoord_count;
+	uint32_t normal_count;
+};
+
+//one worker's slice of the file, it always starts at the beginning of a line
+//the first pass counts what is in it, the prefix sum of those counts gives the bases the second pass writes at
+struct obj_chunk{
+	const char *start;
+	const char *end;
+
+	uint32_t positions;
+	uint32_t texcoords;
+	uint32_t normals;
+	uint64_t corners;
+
+	uint32_t position_base;
+	uint32_t texcoord_base;
+	uint32_t normal_base;
+	uint64_t corner_base;
+
+	struct obj_arrays *arrays;
+	uint64_t invalid_corners;
+};
+
+static const double powers_of_ten[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool is_space(char c){
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool is_digit(char c){
+	return (unsigned char)(c - '0') < 10;
+}
+
+//swar digit handling, a whole 8 byte load is checked and converted in a few multiplies instead of one digit at a time
+//the loads are little endian which every platform this builds for is
+static inline bool is_eight_digits(uint64_t chars){
+	return ((chars & 0xF0F0F0F0F0F0F0F0ull) | (((chars + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+}
+
+static inline uint32_t parse_eight_digits(uint64_t chars){
+	chars -= 0x3030303030303030ull;
+	chars = chars * 10 + (chars >> 8);
+	chars = (((chars & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+		(((chars >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+	return (uint32_t)chars;
+}
+
+//accumulates a run of digits into value, kept is how many digits value holds and stops growing at 19 so it cant overflow,
+//total is every digit in the run including any that didnt fit
+static const char *parse_digits(const char *p, const char *end, uint64_t *value, int *kept, int *total){
+	uint64_t v = *value;
+	int n = *kept;
+	int count = 0;
+
+	while (end - p >= 8 && n <= 11){
+		uint64_t chars;
+		memcpy(&chars, p, 8);
+		if (!is_eight_digits(chars))
+			break;
+		v = v * 100000000ull + parse_eight_digits(chars);
+		n += 8;
+		count += 8;
+		p += 8;
+	}
+
+	while (p < end && is_digit(*p)){
+		if (n < 19){
+			v = v * 10 + (uint64_t)(*p - '0');
+			n++;
+		}
+		count++;
+		p++;
+	}
+
+	*value = v;
+	*kept = n;
+	*total = count;
+	return p;
+}
+
+static double scale_by_power_of_ten(double value, int exponent){
+	//up to 22 the power is exact so a mantissa under 2^53 comes out correctly rounded
+	while (exponent > 22){
+		value *= 1e22;
+		exponent -= 22;
+	}
+	while (exponent < -22){
+		value /= 1e22;
+		exponent += 22;
+	}
+	return exponent >= 0 ? value * powers_of_ten[exponent] : value / powers_of_ten[-exponent];
+}
+
+static const char *parse_float(const char *p, const char *end, float *out){
+	while (p < end && is_space(*p))
+		p++;
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')){
+		negative = *p == '-';
+		p++;
+	}
+
+	uint64_t mantissa = 0;
+	int kept = 0;
+	int total = 0;
+	p = parse_digits(p, end, &mantissa, &kept, &total);
+	//integer digits that didnt fit still count towards the magnitude
+	int exponent = total - kept;
+
+	if (p < end && *p == '.'){
+		int kept_before = kept;
+		p = parse_digits(p + 1, end, &mantissa, &kept, &total);
+		exponent -= kept - kept_before;
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E')){
+		p++;
+		bool negative_exponent = false;
+		if (p < end && (*p == '-' || *p == '+')){
+			negative_exponent = *p == '-';
+			p++;
+		}
+		int e = 0;
+		while (p < end && is_digit(*p)){
+			if (e < 10000)
+				e = e * 10 + (*p - '0');
+			p++;
+		}
+		exponent += negative_exponent ? -e : e;
+	}
+
+	double value = mantissa ? scale_by_power_of_ten((double)mantissa, exponent) : 0.0;
+	*out = (float)(negative ? -value : value);
+	return p;
+}
+
+//0 when there is no number here, obj indices start at 1 so 0 is never a real one
+static const char *parse_index(const char *p, const char *end, int64_t *out){
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')){
+		negative = *p == '-';
+		p++;
+	}
+
+	uint64_t value = 0;
+	int kept = 0;
+	int total = 0;
+	p = parse_digits(p, end, &value, &kept, &total);
+	*out = value > INT32_MAX ? 0 : negative ? -(int64_t)value : (int64_t)value;
+	return p;
+}
+
+//a face token such as 7, 7/3, 7//2 or 7/3/2
+static const char *parse_corner(const char *p, const char *end, int64_t raw[3]){
+	raw[0] = raw[1] = raw[2] = 0;
+	p = parse_index(p, end, &raw[0]);
+	if (p < end && *p == '/'){
+		p++;
+		if (p < end && *p != '/')
+			p = parse_index(p, end, &raw[1]);
+		if (p < end && *p == '/')
+			p = parse_index(p + 1, end, &raw[2]);
+	}
+	//anything else stuck to the token is skipped
+	while (p < end && !is_space(*p))
+		p++;
+	return p;
+}
+
+//positive indices count from the start of the file, negative ones back from the last element read so far
+static uint32_t resolve_index(int64_t raw, uint32_t read_so_far, uint32_t count, uint64_t *invalid){
+	int64_t index = raw > 0 ? raw - 1 : (int64_t)read_so_far + raw;
+	if (raw == 0 || index < 0 || index >= count){
+		(*invalid)++;
+		return 0;
+	}
+	return (uint32_t)index;
+}
+
+static const char *line_end(const char *p, const char *end){
+	const char *newline = memchr(p, '\n', (size_t)(end - p));
+	return newline ? newline : end;
+}
+
+static const char *skip_space(const char *p, const char *end){
+	while (p < end && is_space(*p))
+		p++;
+	return p;
+}
+
+static uint32_t count_face_corners(const char *p, const char *end){
+	uint32_t corners = 0;
+	while (p < end && *p != '#'){
+		p = skip_space(p, end);
+		if (p == end || *p == '#')
+			break;
+		corners++;
+		while (p < end && !is_space(*p))
+			p++;
+	}
+	return corners;
+}
+
+static void count_chunk(void *arg){
+	struct obj_chunk *chunk = arg;
+	const char *p = chunk->start;
+
+	while (p < chunk->end){
+		const char *end = line_end(p, chunk->end);
+		p = skip_space(p, end);
+
+		//has to classify lines exactly the way parse_chunk does or the bases wont line up
+		if (end - p >= 2 && p[0] == 'v' && is_space(p[1])){
+			chunk->positions++;
+		} else if (end - p >= 3 && p[0] == 'v' && p[1] == 't' && is_space(p[2])){
+			chunk->texcoords++;
+		} else if (end - p >= 3 && p[0] == 'v' && p[1] == 'n' && is_space(p[2])){
+			chunk->normals++;
+		} else if (end - p >= 2 && p[0] == 'f' && is_space(p[1])){
+			uint32_t corners = count_face_corners(p + 1, end);
+			//faces are fanned into triangles
+			if (corners >= 3)
+				chunk->corners += (uint64_t)(corners - 2) * 3;
+		}
+		p = end < chunk->end ? end + 1 : end;
+	}
+}
+
+static void parse_chunk(void *arg){
+	struct obj_chunk *chunk = arg;
+	struct obj_arrays *arrays = chunk->arrays;
+	uint32_t position = chunk->position_base;
+	uint32_t texcoord = chunk->texcoord_base;
+	uint32_t normal = chunk->normal_base;
+	struct obj_corner *corner = arrays->corners + chunk->corner_base;
+
+	const char *p = chunk->start;
+	while (p < chunk->end){
+		const char *end = line_end(p, chunk->end);
+		p = skip_space(p, end);
+
+		if (end - p >= 2 && p[0] == 'v' && is_space(p[1])){
+			//a w or vertex colour after the xyz is ignored
+			float *out = arrays->positions + (size_t)position++ * 3;
+			p = parse_float(p + 1, end, &out[0]);
+			p = parse_float(p, end, &out[1]);
+			parse_float(p, end, &out[2]);
+		} else if (end - p >= 3 && p[0] == 'v' && p[1] == 't' && is_space(p[2])){
+			float *out = arrays->texcoords + (size_t)texcoord++ * 2;
+			p = parse_float(p + 2, end, &out[0]);
+			parse_float(p, end, &out[1]);
+		} else if (end - p >= 3 && p[0] == 'v' && p[1] == 'n' && is_space(p[2])){
+			float *out = arrays->normals + (size_t)normal++ * 3;
+			p = parse_float(p + 2, end, &out[0]);
+			p = parse_float(p, end, &out[1]);
+			parse_float(p, end, &out[2]);
+		} else if (end - p >= 2 && p[0] == 'f' && is_space(p[1])){
+			struct obj_corner first = {0};
+			struct obj_corner previous = {0};
+			uint32_t count = 0;
+			p++;
+
+			while (true){
+				p = skip_space(p, end);
+				if (p == end || *p == '#')
+					break;
+
+				int64_t raw[3];
+				p = parse_corner(p, end, raw);
+
+				struct obj_corner current;
+				current.position = resolve_index(raw[0], position, arrays->position_count, &chunk->invalid_corners);
+				current.texcoord = raw[1] ? resolve_index(raw[1], texcoord, arrays->texcoord_count, &chunk->invalid_corners) : OBJ_MISSING;
+				current.normal = raw[2] ? resolve_index(raw[2], normal, arrays->normal_count, &chunk->invalid_corners) : OBJ_MISSING;
+
+				if (count == 0){
+					first = current;
+				} else if (count >= 2){
+					corner[0] = first;
+					corner[1] = previous;
+					corner[2] = current;
+					corner += 3;
+				}
+				previous = current;
+				count++;
+			}
+		}
+		p = end < chunk->end ? end + 1 : end;
+	}
+}
+
+//the first chunk runs on the calling thread, a worker that fails to start has its chunk run here as well
+static void run_chunks(void (*func)(void *arg), struct obj_chunk *chunks, int count){
+	struct thread *threads[OBJ_IMPORT_MAX_THREADS] = {0};
+	for (int i = 1; i < count; i++)
+		threads[i] = start_thread(func, &chunks[i]);
+
+	func(&chunks[0]);
+
+	for (int i = 1; i < count; i++){
+		if (threads[i])
+			join_thread(threads[i]);
+		else
+			func(&chunks[i]);
+	}
+}
+
+static uint32_t hash_corner(struct obj_corner corner){
+	uint64_t hash = corner.position * 0x9E3779B97F4A7C15ull ^ corner.texcoord * 0xC2B2AE3D27D4EB4Full ^ corner.normal * 0x165667B19E3779F9ull;
+	return (uint32_t)(hash ^ hash >> 32);
+}
+
+//turns the corners into indices and the unique corners into vertices, kept in the order they first appear
+static bool deduplicate(struct obj_arrays *arrays, uint64_t corner_count, struct imported_mesh *mesh, struct obj_corner **unique){
+	mesh->indices = malloc(sizeof *mesh->indices * corner_count);
+	*unique = malloc(sizeof **unique * corner_count);
+	if (!mesh->indices || !*unique)
+		return false;
+
+	//with no texcoords or normals the position index alone is the vertex, which only needs a flat remap table
+	bool positions_only = arrays->texcoord_count == 0 && arrays->normal_count == 0;
+	uint64_t capacity = positions_only ? arrays->position_count : 1;
+	while (!positions_only && capacity < corner_count + corner_count / 2 + 1)
+		capacity *= 2;
+
+	uint32_t *table = malloc(sizeof *table * capacity);
+	if (!table)
+		return false;
+	memset(table, 0xFF, sizeof *table * capacity);
+
+	uint32_t vertex_count = 0;
+	for (uint64_t i = 0; i < corner_count; i++){
+		struct obj_corner corner = arrays->corners[i];
+		uint32_t *slot;
+		if (positions_only){
+			slot = &table[corner.position];
+		} else {
+			uint64_t h = hash_corner(corner) & (capacity - 1);
+			while (table[h] != UINT32_MAX){
+				struct obj_corner *other = &(*unique)[table[h]];
+				if (other->position == corner.position && other->texcoord == corner.texcoord && other->normal == corner.normal)
+					break;
+				h = (h + 1) & (capacity - 1);
+			}
+			slot = &table[h];
+		}
+
+		if (*slot == UINT32_MAX){
+			*slot = vertex_count;
+			(*unique)[vertex_count++] = corner;
+		}
+		mesh->indices[i] = *slot;
+	}
+
+	free(table);
+	mesh->vertex_count = vertex_count;
+	mesh->index_count = (uint32_t)corner_count;
+	return true;
+}
+
+static void gather_attributes(struct obj_arrays *arrays, const struct obj_corner *unique, struct imported_mesh *mesh){
+	uint32_t count = mesh->vertex_count;
+	mesh->positions = malloc(sizeof *mesh->positions * 3 * count);
+	if (arrays->normal_count)
+		mesh->normals = calloc((size_t)count * 3, sizeof *mesh->normals);
+	if (arrays->texcoord_count)
+		mesh->texcoords = calloc((size_t)count * 2, sizeof *mesh->texcoords);
+
+	for (uint32_t v = 0; v < count; v++){
+		memcpy(mesh->positions + (size_t)v * 3, arrays->positions + (size_t)unique[v].position * 3, sizeof(float) * 3);
+		//a corner that left one out keeps the zero from calloc
+		if (mesh->normals && unique[v].normal != OBJ_MISSING)
+			memcpy(mesh->normals + (size_t)v * 3, arrays->normals + (size_t)unique[v].normal * 3, sizeof(float) * 3);
+		if (mesh->texcoords && unique[v].texcoord != OBJ_MISSING)
+			memcpy(mesh->texcoords + (size_t)v * 2, arrays->texcoords + (size_t)unique[v].texcoord * 2, sizeof(float) * 2);
+	}
+}
+
+struct imported_mesh import_obj(const char *file_name, int thread_count){
+	PROFILE_BEGIN_DETAIL("import_obj", file_name);
+	uint64_t start_ns = get_time_ns();
+	struct imported_mesh mesh = {0};
+
+	struct mapped_file file = map_file(file_name);
+	if (!file.data){
+		PROFILE_END();
+		return mesh;
+	}
+
+	//no more threads than there are megabytes to go round
+	if (thread_count <= 0)
+		thread_count = get_cpu_count();
+	size_t most_chunks = file.size / OBJ_IMPORT_MIN_CHUNK + 1;
+	if ((size_t)thread_count > most_chunks)
+		thread_count = (int)most_chunks;
+	if (thread_count > OBJ_IMPORT_MAX_THREADS)
+		thread_count = OBJ_IMPORT_MAX_THREADS;
+	mesh.threads = thread_count;
+
+	//chunk boundaries are nudged forward to the next line so no line is split between two workers
+	struct obj_arrays arrays = {0};
+	struct obj_chunk chunks[OBJ_IMPORT_MAX_THREADS] = {0};
+	const char *data = file.data;
+	const char *data_end = data + file.size;
+	const char *chunk_start = data;
+	for (int i = 0; i < thread_count; i++){
+		const char *chunk_end = i == thread_count - 1 ? data_end : data + file.size / thread_count * (i + 1);
+		if (chunk_end < chunk_start)
+			chunk_end = chunk_start;
+		chunk_end = line_end(chunk_end, data_end);
+		if (chunk_end < data_end)
+			chunk_end++;
+
+		chunks[i].start = chunk_start;
+		chunks[i].end = chunk_end;
+		chunks[i].arrays = &arrays;
+		chunk_start = chunk_end;
+	}
+
+	PROFILE_BEGIN("count");
+	run_chunks(count_chunk, chunks, thread_count);
+	PROFILE_END();
+
+	uint64_t positions = 0, texcoords = 0, normals = 0, corners = 0;
+	for (int i = 0; i < thread_count; i++){
+		chunks[i].position_base = (uint32_t)positions;
+		chunks[i].texcoord_base = (uint32_t)texcoords;
+		chunks[i].normal_base = (uint32_t)normals;
+		chunks[i].corner_base = corners;
+		positions += chunks[i].positions;
+		texcoords += chunks[i].texcoords;
+		normals += chunks[i].normals;
+		corners += chunks[i].corners;
+	}
+
+	if (positions == 0 || corners == 0 || positions > UINT32_MAX || corners > UINT32_MAX){
+		printf("Error: %s has no triangles or too many to index with 32 bits\n", file_name);
+		unmap_file(&file);
+		PROFILE_END();
+		return mesh;
+	}
+
+	arrays.position_count = (uint32_t)positions;
+	arrays.texcoord_count = (uint32_t)texcoords;
+	arrays.normal_count = (uint32_t)normals;
+	arrays.positions = malloc(sizeof *arrays.positions * 3 * positions);
+	arrays.texcoords = malloc(sizeof *arrays.texcoords * 2 * texcoords + 1);
+	arrays.normals = malloc(sizeof *arrays.normals * 3 * normals + 1);
+	arrays.corners = malloc(sizeof *arrays.corners * corners);
+
+	struct obj_corner *unique = NULL;
+	bool ok = arrays.positions && arrays.texcoords && arrays.normals && arrays.corners;
+	if (ok){
+		PROFILE_BEGIN("parse");
+		run_chunks(parse_chunk, chunks, thread_count);
+		PROFILE_END();
+
+		for (int i = 0; i < thread_count; i++)
+			mesh.invalid_corners += chunks[i].invalid_corners;
+
+		PROFILE_BEGIN("deduplicate");
+		ok = deduplicate(&arrays, corners, &mesh, &unique);
+		if (ok)
+			gather_attributes(&arrays, unique, &mesh);
+		PROFILE_END();
+		ok = ok && mesh.positions && (mesh.normals || !normals) && (mesh.texcoords || !texcoords);
+	}
+	mesh.source_positions = arrays.position_count;
+	size_t file_size = file.size;
+
+	free(unique);
+	free(arrays.positions);
+	free(arrays.texcoords);
+	free(arrays.normals);
+	free(arrays.corners);
+	unmap_file(&file);
+
+	if (!ok){
+		printf("Error: failed to allocate memory importing %s\n", file_name);
+		destroy_imported_mesh(&mesh);
+		PROFILE_END();
+		return mesh;
+	}
+
+	if (mesh.invalid_corners)
+		printf("Error: %llu face corners in %s point outside the file\n", (unsigned long long)mesh.invalid_corners, file_name);
+
+	double ms = (get_time_ns() - start_ns) / 1e6;
+	printf("Imported %s: %u triangles, %u vertices from %u positions in %.1f ms on %d threads (%.0f MB/s)\n", file_name, mesh.index_count / 3,
+		mesh.vertex_count, mesh.source_positions, ms, mesh.threads, file_size / 1048576.0 / (ms / 1000.0));
+	PROFILE_END();
+	return mesh;
+}
+
+void destroy_imported_mesh(struct imported_mesh *mesh){
+	free(mesh->positions);
+	free(mesh->normals);
+	free(mesh->texcoords);
+	free(mesh->indices);
+	*mesh = (struct imported_mesh){0};
+}
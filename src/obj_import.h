@@ -0,0 +1,28 @@
+//chunks smaller than this arent worth a thread of their own
+#define OBJ_IMPORT_MIN_CHUNK (1024 * 1024)
+#define OBJ_IMPORT_MAX_THREADS 32
+
+//functions
+
+//obj import functions, a thread count of 0 uses one thread per cpu
+struct imported_mesh import_obj(const char *file_name, int thread_count);
+void destroy_imported_mesh(struct imported_mesh *mesh);
+
+
+//structs
+
+//deduplicated vertices as one tightly packed array per attribute, ready for create_mesh or save_mesh_file
+//normals and texcoords are NULL when the file had none, an empty mesh (index_count 0) means the import failed
+struct imported_mesh{
+	float *positions;
+	float *normals;
+	float *texcoords;
+	uint32_t *indices;
+	uint32_t vertex_count;
+	uint32_t index_count;
+
+	//what the file held before deduplication, and how many face corners pointed outside it
+	uint32_t source_positions;
+	uint64_t invalid_corners;
+	int threads;
+};
@@ -0,0 +1,285 @@
+//plain old C headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+//GLFW header
+#define GLFW_INCLUDE_VULKAN
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include "host_allocator.h"
+#include "gpu_timer.h"
+#include "vulkan_helpers.h"
+#include "upload_manager.h"
+#include "mesh.h"
+#include "instancing.h"
+#include "object_cull.h"
+#include "basic_helpers.h"
+#include "profiler.h"
+
+//the sides of clip space as inward planes, x >= -1, x <= 1, y >= -1 and y <= 1
+static const float clip_space_planes[4][4] = {
+	{1.0f, 0.0f, 0.0f, 1.0f},
+	{-1.0f, 0.0f, 0.0f, 1.0f},
+	{0.0f, 1.0f, 0.0f, 1.0f},
+	{0.0f, -1.0f, 0.0f, 1.0f}
+};
+
+static VkDescriptorSetLayout create_object_cull_set_layout(VkDevice device){
+	//objects, bounds, the lod table, the per object lod state and the draws, in that order
+	VkDescriptorSetLayoutBinding bindings[5] = {0};
+	for (uint32_t i = 0; i < ARR_SIZE(bindings); i++){
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo create_info = {0};
+	create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	create_info.bindingCount = ARR_SIZE(bindings);
+	create_info.pBindings = bindings;
+
+	VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+	if (vkCreateDescriptorSetLayout(device, &create_info, HOST_ALLOCATOR, &set_layout) != VK_SUCCESS)
+		printf("Error: failed to create object cull descriptor set layout");
+	return set_layout;
+}
+
+static void write_object_cull_set(VkDevice device, struct object_culler *culler){
+	VkDescriptorBufferInfo buffers[5] = {
+		{culler->object_buffer, 0, VK_WHOLE_SIZE},
+		{culler->bounds_buffer, 0, VK_WHOLE_SIZE},
+		{culler->lod_buffer, 0, VK_WHOLE_SIZE},
+		{culler->lod_state_buffer, 0, VK_WHOLE_SIZE},
+		{culler->draw_buffer, 0, VK_WHOLE_SIZE}
+	};
+
+	VkWriteDescriptorSet writes[5] = {0};
+	for (uint32_t i = 0; i < ARR_SIZE(writes); i++){
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = culler->descriptor_set;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &buffers[i];
+	}
+	vkUpdateDescriptorSets(device, ARR_SIZE(writes), writes, 0, NULL);
+}
+
+static VkPipeline create_object_cull_pipeline(VkDevice device, VkPipelineLayout pipeline_layout, const struct mapped_file *shader){
+	//spir-v has to be 4 byte aligned, which a mapping always is
+	VkShaderModule shader_module = create_shader_module((char *)shader->data, (long)shader->size, device);
+
+	VkComputePipelineCreateInfo pipeline_info = {0};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeline_info.stage.module = shader_module;
+	pipeline_info.stage.pName = "main";
+	pipeline_info.layout = pipeline_layout;
+	pipeline_info.basePipelineIndex = -1;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, HOST_ALLOCATOR, &pipeline) != VK_SUCCESS)
+		printf("Error: failed to create object cull pipeline");
+
+	vkDestroyShaderModule(device, shader_module, HOST_ALLOCATOR);
+	return pipeline;
+}
+
+//the mesh's box as a sphere, moved and scaled the same way the vertex shader moves and scales its positions
+static struct object_bounds *compute_object_bounds(const struct mesh *mesh, const struct instance_set *instances){
+	struct object_bounds *bounds = malloc(sizeof *bounds * instances->count);
+	if (!bounds){
+		printf("Error: failed to allocate object bounds");
+		return NULL;
+	}
+
+	float center[3], radius_squared = 0.0f;
+	for (int c = 0; c < 3; c++){
+		float half_extent = (mesh->bounds.max[c] - mesh->bounds.min[c]) * 0.5f;
+		center[c] = mesh->bounds.min[c] + half_extent;
+		radius_squared += half_extent * half_extent;
+	}
+	float radius = sqrtf(radius_squared);
+
+	for (uint32_t i = 0; i < instances->count; i++){
+		const float *transform = instances->instances[i].transform;
+		for (int c = 0; c < 3; c++)
+			bounds[i].center[c] = transform[c] + transform[3] * center[c];
+		bounds[i].radius = transform[3] * radius;
+	}
+	return bounds;
+}
+
+struct object_culler create_object_culler(VkDevice device, struct gpu_allocator *allocator, struct upload_manager *uploads, const struct mesh *mesh, const struct instance_set *instances, bool draw_indirect_count){
+	PROFILE_BEGIN("create_object_culler");
+	struct object_culler culler = {0};
+	if (instances->count == 0){
+		PROFILE_END();
+		return culler;
+	}
+
+	struct mapped_file shader = map_file(OBJECT_CULL_SHADER);
+	struct object_bounds *bounds = shader.data ? compute_object_bounds(mesh, instances) : NULL;
+	uint32_t *lod_state = shader.data ? calloc(instances->count, sizeof *lod_state) : NULL;
+	if (!bounds || !lod_state){
+		printf("Gpu driven drawing disabled, the instances are drawn from the cpu\n");
+		free(bounds);
+		free(lod_state);
+		unmap_file(&shader);
+		PROFILE_END();
+		return culler;
+	}
+
+	culler.object_count = instances->count;
+	culler.lod_count = mesh->lod_count;
+	if (draw_indirect_count)
+		culler.draw_indexed_indirect_count = (PFN_vkCmdDrawIndexedIndirectCount)vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCount");
+	culler.compact = culler.draw_indexed_indirect_count != NULL;
+
+	VkDeviceSize object_bytes = sizeof(struct instance_data) * instances->count;
+	VkDeviceSize bounds_bytes = sizeof(struct object_bounds) * instances->count;
+	VkDeviceSize lod_bytes = sizeof(struct mesh_lod) * mesh->lod_count;
+	VkDeviceSize lod_state_bytes = sizeof(uint32_t) * instances->count;
+	VkDeviceSize draw_bytes = OBJECT_CULL_DRAWS_OFFSET + sizeof(VkDrawIndexedIndirectCommand) * (VkDeviceSize)instances->count;
+	culler.object_buffer = create_device_buffer(device, allocator, object_bytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &culler.object_allocation);
+	culler.bounds_buffer = create_device_buffer(device, allocator, bounds_bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &culler.bounds_allocation);
+	culler.lod_buffer = create_device_buffer(device, allocator, lod_bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &culler.lod_allocation);
+	culler.lod_state_buffer = create_device_buffer(device, allocator, lod_state_bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &culler.lod_state_allocation);
+	culler.draw_buffer = create_device_buffer(device, allocator, draw_bytes, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &culler.draw_allocation);
+	upload_buffer(device, uploads, culler.object_buffer, 0, instances->instances, object_bytes);
+	upload_buffer(device, uploads, culler.bounds_buffer, 0, bounds, bounds_bytes);
+	upload_buffer(device, uploads, culler.lod_buffer, 0, mesh->lods, lod_bytes);
+	upload_buffer(device, uploads, culler.lod_state_buffer, 0, lod_state, lod_state_bytes);
+	upload_flush(device, uploads);
+	free(bounds);
+	free(lod_state);
+
+	culler.set_layout = create_object_cull_set_layout(device);
+
+	VkDescriptorPoolSize pool_size = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5};
+	VkDescriptorPoolCreateInfo pool_info = {0};
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.maxSets = 1;
+	pool_info.poolSizeCount = 1;
+	pool_info.pPoolSizes = &pool_size;
+	if (vkCreateDescriptorPool(device, &pool_info, HOST_ALLOCATOR, &culler.descriptor_pool) != VK_SUCCESS)
+		printf("Error: failed to create object cull descriptor pool");
+
+	VkDescriptorSetAllocateInfo set_info = {0};
+	set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	set_info.descriptorPool = culler.descriptor_pool;
+	set_info.descriptorSetCount = 1;
+	set_info.pSetLayouts = &culler.set_layout;
+	if (vkAllocateDescriptorSets(device, &set_info, &culler.descriptor_set) != VK_SUCCESS)
+		printf("Error: failed to allocate object cull descriptor set");
+	write_object_cull_set(device, &culler);
+
+	VkPushConstantRange push_constant_range = {0};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(struct object_cull_constants);
+
+	VkPipelineLayoutCreateInfo layout_info = {0};
+	layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layout_info.setLayoutCount = 1;
+	layout_info.pSetLayouts = &culler.set_layout;
+	layout_info.pushConstantRangeCount = 1;
+	layout_info.pPushConstantRanges = &push_constant_range;
+	if (vkCreatePipelineLayout(device, &layout_info, HOST_ALLOCATOR, &culler.pipeline_layout) != VK_SUCCESS)
+		printf("Error: failed to create object cull pipeline layout");
+
+	culler.pipeline = create_object_cull_pipeline(device, culler.pipeline_layout, &shader);
+	unmap_file(&shader);
+
+	culler.enabled = culler.pipeline != VK_NULL_HANDLE;
+	printf("Culling %u objects on the gpu and drawing them with %s\n", culler.object_count,
+		culler.compact ? "vkCmdDrawIndexedIndirectCount" : "a fixed count vkCmdDrawIndexedIndirect");
+	PROFILE_END();
+	return culler;
+}
+
+void destroy_object_culler(VkDevice device, struct object_culler *culler){
+	if (culler->object_count == 0 || culler->set_layout == VK_NULL_HANDLE)
+		return;
+
+	vkDestroyPipeline(device, culler->pipeline, HOST_ALLOCATOR);
+	vkDestroyPipelineLayout(device, culler->pipeline_layout, HOST_ALLOCATOR);
+	//the set goes with its pool
+	vkDestroyDescriptorPool(device, culler->descriptor_pool, HOST_ALLOCATOR);
+	vkDestroyDescriptorSetLayout(device, culler->set_layout, HOST_ALLOCATOR);
+
+	vkDestroyBuffer(device, culler->object_buffer, HOST_ALLOCATOR);
+	gpu_free(device, &culler->object_allocation);
+	vkDestroyBuffer(device, culler->bounds_buffer, HOST_ALLOCATOR);
+	gpu_free(device, &culler->bounds_allocation);
+	vkDestroyBuffer(device, culler->lod_buffer, HOST_ALLOCATOR);
+	gpu_free(device, &culler->lod_allocation);
+	vkDestroyBuffer(device, culler->lod_state_buffer, HOST_ALLOCATOR);
+	gpu_free(device, &culler->lod_state_allocation);
+	vkDestroyBuffer(device, culler->draw_buffer, HOST_ALLOCATOR);
+	gpu_free(device, &culler->draw_allocation);
+	*culler = (struct object_culler){0};
+}
+
+void object_cull_record(VkCommandBuffer command_buffer, const struct object_culler *culler, float pixels_per_unit, float error_pixels){
+	//the last frame's draws may still be reading the commands, and its dispatch wrote the lod state this one reads
+	VkMemoryBarrier previous_barrier = {0};
+	previous_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	previous_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	previous_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &previous_barrier, 0, NULL, 0, NULL);
+
+	//only the compacting path counts, the fixed count path writes every object's draw whether it survives or not
+	if (culler->compact){
+		uint32_t zero = 0;
+		vkCmdUpdateBuffer(command_buffer, culler->draw_buffer, 0, sizeof zero, &zero);
+
+		VkMemoryBarrier reset_barrier = {0};
+		reset_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		reset_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		reset_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &reset_barrier, 0, NULL, 0, NULL);
+	}
+
+	struct object_cull_constants constants = {0};
+	memcpy(constants.planes, clip_space_planes, sizeof constants.planes);
+	constants.pixels_per_unit = pixels_per_unit;
+	constants.error_pixels = error_pixels;
+	constants.hysteresis = LOD_HYSTERESIS;
+	constants.object_count = culler->object_count;
+	constants.lod_count = culler->lod_count;
+	constants.compact = culler->compact;
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culler->pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culler->pipeline_layout, 0, 1, &culler->descriptor_set, 0, NULL);
+	vkCmdPushConstants(command_buffer, culler->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof constants, &constants);
+
+	uint32_t groups = (culler->object_count + OBJECT_CULL_GROUP_SIZE - 1) / OBJECT_CULL_GROUP_SIZE;
+	uint32_t groups_x = MIN(groups, OBJECT_CULL_MAX_GROUPS_X);
+	uint32_t groups_y = (groups + groups_x - 1) / groups_x;
+	vkCmdDispatch(command_buffer, groups_x, groups_y, 1);
+
+	VkMemoryBarrier cull_barrier = {0};
+	cull_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cull_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cull_barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &cull_barrier, 0, NULL, 0, NULL);
+}
+
+void object_cull_draw(VkCommandBuffer command_buffer, const struct object_culler *culler, uint32_t instance_binding){
+	//every draw is one instance whose first instance is its object, so the vertex fetch reads straight from the object list
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(command_buffer, instance_binding, 1, &culler->object_buffer, &offset);
+	if (culler->compact)
+		culler->draw_indexed_indirect_count(command_buffer, culler->draw_buffer, OBJECT_CULL_DRAWS_OFFSET, culler->draw_buffer, 0, culler->object_count, sizeof(VkDrawIndexedIndirectCommand));
+	else
+		vkCmdDrawIndexedIndirect(command_buffer, culler->draw_buffer, OBJECT_CULL_DRAWS_OFFSET, culler->object_count, sizeof(VkDrawIndexedIndirectCommand));
+}
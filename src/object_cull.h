@@ -0,0 +1,71 @@
+//forward declarations of structs defined further down that are passed around by pointer
+struct object_culler;
+struct instance_set;
+
+//the compiled object_cull.comp, gpu driven drawing is switched off when it isnt there
+#define OBJECT_CULL_SHADER "shaders/object_cull.spv"
+//the cull shader's workgroup size, one thread per object
+#define OBJECT_CULL_GROUP_SIZE 64
+//the most workgroups one dispatch dimension is guaranteed to take, bigger object counts spill into y
+#define OBJECT_CULL_MAX_GROUPS_X 65535
+//the draw count sits at the start of the draw buffer and the commands follow from here
+#define OBJECT_CULL_DRAWS_OFFSET 16
+
+//functions
+
+//object culling functions, the instances are uploaded once and from then on the gpu decides what to draw each frame
+//with draw_indirect_count the survivors are compacted and counted, without it every object keeps a draw that culling zeroes
+struct object_culler create_object_culler(VkDevice device, struct gpu_allocator *allocator, struct upload_manager *uploads, const struct mesh *mesh, const struct instance_set *instances, bool draw_indirect_count);
+void destroy_object_culler(VkDevice device, struct object_culler *culler);
+void object_cull_record(VkCommandBuffer command_buffer, const struct object_culler *culler, float pixels_per_unit, float error_pixels);
+void object_cull_draw(VkCommandBuffer command_buffer, const struct object_culler *culler, uint32_t instance_binding);
+
+
+//structs
+
+//a sphere around one object in the space it is drawn in, the mesh's bounds moved by the instance transform
+struct object_bounds{
+	float center[3];
+	float radius;
+};
+
+//what the cull shader gets pushed each frame
+//planes point inwards, an object is culled when its sphere is entirely behind any one of them
+//with no camera yet they are the sides of clip space, near and far have nothing to cut as every vertex lands at depth 0
+struct object_cull_constants{
+	float planes[4][4];
+	float pixels_per_unit;
+	float error_pixels;
+	float hysteresis;
+	uint32_t object_count;
+	uint32_t lod_count;
+	VkBool32 compact;
+};
+
+//the objects, their bounds, the mesh's lod table, the level each object was drawn with last frame and the draws
+//enabled is false when the device or the missing cull shader means the instances have to be drawn from the cpu
+struct object_culler{
+	bool enabled;
+	uint32_t object_count;
+	uint32_t lod_count;
+	VkBool32 compact;
+	PFN_vkCmdDrawIndexedIndirectCount draw_indexed_indirect_count;
+
+	//the instance data, read by the cull shader for the scale and bound as the instance vertex stream for drawing
+	VkBuffer object_buffer;
+	struct gpu_allocation object_allocation;
+	VkBuffer bounds_buffer;
+	struct gpu_allocation bounds_allocation;
+	VkBuffer lod_buffer;
+	struct gpu_allocation lod_allocation;
+	VkBuffer lod_state_buffer;
+	struct gpu_allocation lod_state_allocation;
+	VkBuffer draw_buffer;
+	struct gpu_allocation draw_allocation;
+
+	VkDescriptorSetLayout set_layout;
+	VkDescriptorPool descriptor_pool;
+	VkDescriptorSet descriptor_set;
+	VkPipelineLayout pipeline_layout;
+	VkPipeline pipeline;
+};
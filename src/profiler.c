@@ -0,0 +1,108 @@
+//plain old C headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "basic_helpers.h"
+#include "profiler.h"
+
+//the profiler is only meant for the single threaded startup path so it is plain globals with no locking
+static struct profiler_span spans[PROFILER_MAX_SPANS];
+static uint32_t span_count = 0;
+static uint32_t dropped_spans = 0;
+static uint64_t origin_ns = 0;
+
+//indices into spans of the spans currently open, -1 for one that was dropped so the matching end still pops it
+static int32_t open_spans[PROFILER_MAX_DEPTH];
+static uint32_t open_count = 0;
+
+void profiler_begin(const char *name, const char *detail){
+	uint64_t now = get_time_ns();
+	if (span_count == 0 && dropped_spans == 0)
+		origin_ns = now;
+
+	int32_t index = -1;
+	if (span_count < PROFILER_MAX_SPANS && open_count < PROFILER_MAX_DEPTH){
+		index = (int32_t)span_count++;
+		spans[index] = (struct profiler_span){
+			.name = name,
+			.start_ns = now - origin_ns,
+			.duration_ns = 0,
+			.depth = open_count
+		};
+		if (detail)
+			snprintf(spans[index].detail, sizeof spans[index].detail, "%s", detail);
+	} else {
+		dropped_spans++;
+	}
+
+	if (open_count < PROFILER_MAX_DEPTH)
+		open_spans[open_count++] = index;
+}
+
+void profiler_end(){
+	uint64_t now = get_time_ns();
+	if (open_count == 0){
+		printf("Error: profiler_end called with no open span\n");
+		return;
+	}
+
+	int32_t index = open_spans[--open_count];
+	if (index >= 0)
+		spans[index].duration_ns = now - origin_ns - spans[index].start_ns;
+}
+
+//the total time of every finished span with this name, handy for printing a phase without opening the trace
+double profiler_span_ms(const char *name){
+	uint64_t total = 0;
+	for (uint32_t i = 0; i < span_count; i++){
+		if (strcmp(spans[i].name, name) == 0)
+			total += spans[i].duration_ns;
+	}
+	return total / 1e6;
+}
+
+//writes a string as the inside of a json string, details are file names and windows paths are full of backslashes
+static void write_json_string(FILE *f, const char *text){
+	for (const unsigned char *c = (const unsigned char *)text; *c; c++){
+		if (*c == '"' || *c == '\\')
+			fprintf(f, "\\%c", *c);
+		else if (*c < 0x20)
+			fprintf(f, "\\u%04x", *c);
+		else
+			fputc(*c, f);
+	}
+}
+
+//writes the chrome trace event format, which chrome://tracing, perfetto and speedscope all open
+//every span is a complete (ph X) event, times are in microseconds as the format expects
+bool profiler_write_trace(const char *file_name){
+	FILE *f = fopen(file_name, "w");
+	if (!f){
+		printf("Error: failed to open trace output %s\n", file_name);
+		return false;
+	}
+
+	if (open_count)
+		printf("Error: writing a trace with %u spans still open\n", open_count);
+
+	fprintf(f, "{\"displayTimeUnit\": \"ms\", \"otherData\": {\"dropped_spans\": %u}, \"traceEvents\": [\n", dropped_spans);
+	for (uint32_t i = 0; i < span_count; i++){
+		struct profiler_span *s = &spans[i];
+		fprintf(f, "\t{\"name\": \"");
+		write_json_string(f, s->name);
+		fprintf(f, "\", \"cat\": \"startup\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": %.3f, \"dur\": %.3f", s->start_ns / 1e3, s->duration_ns / 1e3);
+		if (s->detail[0]){
+			fprintf(f, ", \"args\": {\"detail\": \"");
+			write_json_string(f, s->detail);
+			fprintf(f, "\"}");
+		}
+		fprintf(f, "}%s\n", i + 1 < span_count ? "," : "");
+	}
+	fprintf(f, "]}\n");
+
+	fclose(f);
+	return true;
+}
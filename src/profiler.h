@@ -0,0 +1,43 @@
+//profiler functions
+void profiler_begin(const char *name, const char *detail);
+void profiler_end();
+double profiler_span_ms(const char *name);
+bool profiler_write_trace(const char *file_name);
+
+
+//structs
+
+//one finished or still open cpu span, the name is not copied so it has to be a string literal, the detail (a file name
+//say) is copied and cut short if needed, start is relative to the first span so traces from different runs line up at 0
+struct profiler_span{
+	const char *name;
+	char detail[64];
+	uint64_t start_ns;
+	uint64_t duration_ns;
+	uint32_t depth;
+};
+
+
+//macros
+
+//spans are kept in a fixed buffer so recording never allocates, anything past it is dropped and counted
+#define PROFILER_MAX_SPANS 1024
+#define PROFILER_MAX_DEPTH 32
+
+//build with -DPROFILER_ENABLED=0 to strip every span out
+#ifndef PROFILER_ENABLED
+	#define PROFILER_ENABLED 1
+#endif
+
+#if PROFILER_ENABLED
+	#define PROFILE_BEGIN(name) profiler_begin(name, NULL)
+	#define PROFILE_BEGIN_DETAIL(name, detail) profiler_begin(name, detail)
+	#define PROFILE_END() profiler_end()
+	//wraps the statement or block after it in a span, dont return or break out of it or the span is never closed
+	#define PROFILE_SCOPE(name) for (int profile_once_ = (profiler_begin(name, NULL), 1); profile_once_; profile_once_ = (profiler_end(), 0))
+#else
+	#define PROFILE_BEGIN(name) ((void)0)
+	#define PROFILE_BEGIN_DETAIL(name, detail) ((void)0)
+	#define PROFILE_END() ((void)0)
+	#define PROFILE_SCOPE(name)
+#endif
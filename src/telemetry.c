@@ -0,0 +1,160 @@
+//plain old C headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "basic_helpers.h"
+#include "telemetry.h"
+
+//must be a power of two so the index wrap is a mask, 4096 records is 512KB which covers well over a second of stalls
+#define TELEMETRY_RING_SIZE 4096
+
+//how long the drain thread sleeps when it finds the ring empty
+#define TELEMETRY_DRAIN_INTERVAL_MS 5
+
+//the ring is single producer single consumer, only the render thread pushes and only the drain thread pops
+//head and tail only ever increase and are masked on use, which means full and empty never look the same
+static struct telemetry_record telemetry_ring[TELEMETRY_RING_SIZE];
+static _Atomic uint64_t telemetry_head = 0;
+static _Atomic uint64_t telemetry_tail = 0;
+static _Atomic uint64_t telemetry_dropped = 0;
+static _Atomic bool telemetry_running = false;
+
+static struct thread *telemetry_thread = NULL;
+static FILE *telemetry_output = NULL;
+//a file gets the raw records which is cheaper to write, stderr gets them formatted as text
+static bool telemetry_binary = false;
+
+void telemetry_push(uint32_t type, uint64_t frame, int32_t result, int32_t detail, const char *message){
+	uint64_t head = atomic_load_explicit(&telemetry_head, memory_order_relaxed);
+	uint64_t tail = atomic_load_explicit(&telemetry_tail, memory_order_acquire);
+
+	//validation messages run to several hundred characters so they take as many records as they need, all or none of them
+	const size_t chunk_size = sizeof telemetry_ring[0].message - 1;
+	size_t length = message ? strlen(message) : 0;
+	uint64_t record_count = length > chunk_size ? (length + chunk_size - 1) / chunk_size : 1;
+
+	//never block the render thread, if the drain thread has fallen behind just count what was lost
+	if (head - tail + record_count > TELEMETRY_RING_SIZE){
+		atomic_fetch_add_explicit(&telemetry_dropped, 1, memory_order_relaxed);
+		return;
+	}
+
+	uint64_t timestamp = get_time_ns();
+	for (uint64_t i = 0; i < record_count; i++){
+		struct telemetry_record *record = &telemetry_ring[(head + i) & (TELEMETRY_RING_SIZE - 1)];
+		record->timestamp_ns = timestamp;
+		record->frame = frame;
+		record->type = i == 0 ? type : TELEMETRY_CONTINUATION;
+		record->result = result;
+		record->detail = detail;
+		record->continued = (uint32_t)(record_count - 1 - i);
+		size_t offset = i * chunk_size;
+		size_t piece = length - offset < chunk_size ? length - offset : chunk_size;
+		if (piece)
+			memcpy(record->message, message + offset, piece);
+		record->message[piece] = '\0';
+	}
+
+	//the release makes the record contents visible before the drain thread can see the new head
+	atomic_store_explicit(&telemetry_head, head + record_count, memory_order_release);
+}
+
+static void write_record(const struct telemetry_record *record){
+	if (telemetry_binary){
+		fwrite(record, sizeof *record, 1, telemetry_output);
+		return;
+	}
+
+	switch (record->type){
+		case TELEMETRY_FRAME:
+			fprintf(telemetry_output, "[%llu] frame %llu acquire %d present %d\n", (unsigned long long)record->timestamp_ns, (unsigned long long)record->frame, record->detail, record->result);
+			break;
+		//the line is only ended by the last piece of the message, a push always lands all of its pieces together
+		case TELEMETRY_DEBUG_MESSAGE:
+			fprintf(telemetry_output, "[%llu] Severity: %d\tType: %d\tMessage: %s", (unsigned long long)record->timestamp_ns, record->result, record->detail, record->message);
+			break;
+		case TELEMETRY_SWAP_CHAIN_RECREATED:
+			fprintf(telemetry_output, "[%llu] swap chain recreated at frame %llu: %s", (unsigned long long)record->timestamp_ns, (unsigned long long)record->frame, record->message);
+			break;
+		case TELEMETRY_CONTINUATION:
+			fputs(record->message, telemetry_output);
+			break;
+		default:
+			fprintf(telemetry_output, "[%llu] unknown record type %u\n", (unsigned long long)record->timestamp_ns, record->type);
+			return;
+	}
+	if (!record->continued)
+		fputc('\n', telemetry_output);
+}
+
+//returns how many records were written so the thread knows whether to sleep
+static uint64_t drain_ring(){
+	uint64_t tail = atomic_load_explicit(&telemetry_tail, memory_order_relaxed);
+	uint64_t head = atomic_load_explicit(&telemetry_head, memory_order_acquire);
+
+	for (uint64_t i = tail; i < head; i++){
+		write_record(&telemetry_ring[i & (TELEMETRY_RING_SIZE - 1)]);
+	}
+
+	//only hand the slots back once we are done reading them
+	atomic_store_explicit(&telemetry_tail, head, memory_order_release);
+	return head - tail;
+}
+
+static void drain_thread(void *arg){
+	(void)arg;
+	while (atomic_load_explicit(&telemetry_running, memory_order_acquire)){
+		if (drain_ring() == 0){
+			fflush(telemetry_output);
+			sleep_ms(TELEMETRY_DRAIN_INTERVAL_MS);
+		}
+	}
+
+	//pick up anything pushed between the last drain and being told to stop
+	drain_ring();
+	fflush(telemetry_output);
+}
+
+bool telemetry_start(const char *file_name){
+	if (file_name){
+		telemetry_output = fopen(file_name, "wb");
+		if (!telemetry_output){
+			printf("Error: failed to open telemetry file %s, using stderr\n", file_name);
+		}
+	}
+	telemetry_binary = telemetry_output != NULL;
+	if (!telemetry_output)
+		telemetry_output = stderr;
+
+	atomic_store_explicit(&telemetry_running, true, memory_order_release);
+	telemetry_thread = start_thread(drain_thread, NULL);
+	if (!telemetry_thread){
+		atomic_store_explicit(&telemetry_running, false, memory_order_release);
+		return false;
+	}
+	return true;
+}
+
+void telemetry_stop(){
+	if (!telemetry_thread) return;
+
+	atomic_store_explicit(&telemetry_running, false, memory_order_release);
+	join_thread(telemetry_thread);
+	telemetry_thread = NULL;
+
+	uint64_t dropped = telemetry_dropped_count();
+	if (dropped)
+		fprintf(stderr, "telemetry dropped %llu records\n", (unsigned long long)dropped);
+
+	if (telemetry_output != stderr)
+		fclose(telemetry_output);
+	telemetry_output = NULL;
+}
+
+uint64_t telemetry_dropped_count(){
+	return atomic_load_explicit(&telemetry_dropped, memory_order_relaxed);
+}
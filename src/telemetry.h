@@ -0,0 +1,54 @@
+//telemetry functions
+bool telemetry_start(const char *file_name);
+void telemetry_stop();
+void telemetry_push(uint32_t type, uint64_t frame, int32_t result, int32_t detail, const char *message);
+uint64_t telemetry_dropped_count();
+
+
+//enums
+
+//the kind of event a telemetry record holds, decides how the drain thread formats it
+enum telemetry_type{
+	TELEMETRY_FRAME,
+	TELEMETRY_DEBUG_MESSAGE,
+	TELEMETRY_SWAP_CHAIN_RECREATED,
+	//the next piece of the message of the record before it, for messages too long for one record
+	TELEMETRY_CONTINUATION
+};
+
+
+//structs
+
+//a fixed size record, 128 bytes so a record never straddles more cache lines than it has to
+//for frames result is the present result and detail the acquire result, for debug messages they are the severity and type
+//a message longer than one record spills into continuation records pushed straight after it, continued is how many follow
+struct telemetry_record{
+	uint64_t timestamp_ns;
+	uint64_t frame;
+	uint32_t type;
+	int32_t result;
+	int32_t detail;
+	uint32_t continued;
+	char message[96];
+};
+
+
+//macros
+
+//the compile time telemetry level, 0 removes every call, 1 keeps debug messages and rare events, 2 adds a record per frame
+//build with -DTELEMETRY_LEVEL=0 to strip it all out
+#ifndef TELEMETRY_LEVEL
+	#define TELEMETRY_LEVEL 2
+#endif
+
+#if TELEMETRY_LEVEL >= 1
+	#define TELEMETRY_EVENT(type, frame, result, detail, message) telemetry_push(type, frame, result, detail, message)
+#else
+	#define TELEMETRY_EVENT(type, frame, result, detail, message) ((void)0)
+#endif
+
+#if TELEMETRY_LEVEL >= 2
+	#define TELEMETRY_FRAME_EVENT(frame, present_result, acquire_result) telemetry_push(TELEMETRY_FRAME, frame, present_result, acquire_result, NULL)
+#else
+	#define TELEMETRY_FRAME_EVENT(frame, present_result, acquire_result) ((void)0)
+#endif
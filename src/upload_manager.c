@@ -0,0 +1,356 @@
+//plain old C headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+//GLFW header
+#define GLFW_INCLUDE_VULKAN
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include "host_allocator.h"
+#include "gpu_timer.h"
+#include "vulkan_helpers.h"
+#include "upload_manager.h"
+#include "profiler.h"
+
+//everything an uploaded resource could be read as once it is on the graphics queue, and the stages doing those reads
+//the stages are also where the acquire waits on the copies, so the wait and the barrier chain into one dependency
+#define UPLOAD_DST_ACCESS (VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | \
+	VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT)
+#define UPLOAD_DST_STAGES (VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | \
+	VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT)
+
+static VkCommandBuffer create_single_command_buffer(VkDevice device, VkCommandPool pool){
+	VkCommandBuffer *command_buffers = create_command_buffers(device, pool, 1);
+	VkCommandBuffer command_buffer = command_buffers[0];
+	free(command_buffers);
+	return command_buffer;
+}
+
+struct upload_manager create_upload_manager(VkDevice device, struct gpu_allocator *allocator, struct queue_family_indices indices, VkQueue transfer_queue, VkQueue graphics_queue, VkDeviceSize staging_size){
+	struct upload_manager manager = {0};
+	manager.transfer_family = indices.transfer_family;
+	manager.graphics_family = indices.graphics_family;
+	manager.transfer_queue = transfer_queue;
+	manager.graphics_queue = graphics_queue;
+	manager.next_batch = 1;
+
+	VkBufferCreateInfo create_info = {0};
+	create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	create_info.size = staging_size;
+	create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &create_info, HOST_ALLOCATOR, &manager.staging_buffer) != VK_SUCCESS){
+		printf("Error: failed to create staging buffer");
+		return manager;
+	}
+
+	//only ever written by the cpu in order, so write combined uncached memory is what we want and no flag is preferred
+	manager.staging_allocation = gpu_allocate_buffer(device, allocator, manager.staging_buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0);
+	if (!manager.staging_allocation.mapped)
+		printf("Error: failed to allocate mapped staging memory");
+
+	//each batch gets a slice, kept 16 byte aligned which covers the texel sizes buffer to image copies need
+	manager.batch_staging_size = staging_size / UPLOAD_BATCH_COUNT & ~(VkDeviceSize)15;
+
+	for (int i = 0; i < UPLOAD_BATCH_COUNT; i++){
+		struct upload_batch *batch = &manager.batches[i];
+		batch->staging_base = manager.batch_staging_size * i;
+
+		batch->transfer_pool = create_command_pool(device, manager.transfer_family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		batch->transfer_commands = create_single_command_buffer(device, batch->transfer_pool);
+		batch->acquire_pool = create_command_pool(device, manager.graphics_family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		batch->acquire_commands = create_single_command_buffer(device, batch->acquire_pool);
+		batch->transfer_done = create_semaphore(device);
+		batch->done = create_fence(device, true);
+	}
+
+	return manager;
+}
+
+void destroy_upload_manager(VkDevice device, struct upload_manager *manager){
+	upload_wait_idle(device, manager);
+
+	for (int i = 0; i < UPLOAD_BATCH_COUNT; i++){
+		struct upload_batch *batch = &manager->batches[i];
+		if (batch->copy_count)
+			printf("Error: %d uploads were never flushed\n", batch->copy_count);
+
+		vkDestroyFence(device, batch->done, HOST_ALLOCATOR);
+		vkDestroySemaphore(device, batch->transfer_done, HOST_ALLOCATOR);
+		vkDestroyCommandPool(device, batch->transfer_pool, HOST_ALLOCATOR);
+		vkDestroyCommandPool(device, batch->acquire_pool, HOST_ALLOCATOR);
+	}
+
+	vkDestroyBuffer(device, manager->staging_buffer, HOST_ALLOCATOR);
+	gpu_free(device, &manager->staging_allocation);
+}
+
+//the current batch with room for size more bytes of staging and one more copy, flushing it first if it is full
+static struct upload_batch *batch_with_room(VkDevice device, struct upload_manager *manager, VkDeviceSize size){
+	struct upload_batch *batch = &manager->batches[manager->current];
+	if (batch->copy_count == UPLOAD_MAX_COPIES || batch->staging_used + size > manager->batch_staging_size){
+		upload_flush(device, manager);
+		batch = &manager->batches[manager->current];
+	}
+	return batch;
+}
+
+static VkDeviceSize stage(struct upload_manager *manager, struct upload_batch *batch, const void *data, VkDeviceSize size){
+	VkDeviceSize offset = batch->staging_base + batch->staging_used;
+	memcpy((unsigned char *)manager->staging_allocation.mapped + offset, data, size);
+	batch->staging_used = (batch->staging_used + size + 15) & ~(VkDeviceSize)15;
+	manager->bytes_uploaded += size;
+	return offset;
+}
+
+bool upload_buffer(VkDevice device, struct upload_manager *manager, VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size){
+	if (!manager->staging_allocation.mapped)
+		return false;
+
+	//anything bigger than a batch is split over as many batches as it takes
+	while (size > 0){
+		VkDeviceSize chunk = MIN(size, manager->batch_staging_size);
+		struct upload_batch *batch = batch_with_room(device, manager, chunk);
+
+		struct upload_copy *copy = &batch->copies[batch->copy_count++];
+		*copy = (struct upload_copy){0};
+		copy->buffer = buffer;
+		copy->staging_offset = stage(manager, batch, data, chunk);
+		copy->destination_offset = offset;
+		copy->size = chunk;
+
+		data = (const unsigned char *)data + chunk;
+		offset += chunk;
+		size -= chunk;
+	}
+	return true;
+}
+
+bool upload_image(VkDevice device, struct upload_manager *manager, VkImage image, VkExtent3D extent, VkImageLayout final_layout, const void *data, VkDeviceSize size){
+	if (!manager->staging_allocation.mapped)
+		return false;
+
+	//an image is copied in one go so it has to fit in a batch
+	if (size > manager->batch_staging_size){
+		printf("Error: a %llu byte image doesnt fit in the %llu byte upload batches\n", (unsigned long long)size, (unsigned long long)manager->batch_staging_size);
+		return false;
+	}
+
+	struct upload_batch *batch = batch_with_room(device, manager, size);
+	struct upload_copy *copy = &batch->copies[batch->copy_count++];
+	*copy = (struct upload_copy){0};
+	copy->is_image = true;
+	copy->image = image;
+	copy->staging_offset = stage(manager, batch, data, size);
+	copy->size = size;
+	copy->extent = extent;
+	copy->final_layout = final_layout;
+	return true;
+}
+
+//the release half of an ownership transfer on the transfer queue and the matching acquire on the graphics queue have to
+//describe the same transfer, so both are built here, with one family it is just a plain barrier on the one queue
+static void record_handover(VkCommandBuffer command_buffer, struct upload_manager *manager, struct upload_batch *batch, bool release){
+	bool transfer_ownership = manager->transfer_family != manager->graphics_family;
+	uint32_t src_family = transfer_ownership ? manager->transfer_family : VK_QUEUE_FAMILY_IGNORED;
+	uint32_t dst_family = transfer_ownership ? manager->graphics_family : VK_QUEUE_FAMILY_IGNORED;
+
+	VkBufferMemoryBarrier buffer_barriers[UPLOAD_MAX_COPIES];
+	VkImageMemoryBarrier image_barriers[UPLOAD_MAX_COPIES];
+	uint32_t buffer_count = 0;
+	uint32_t image_count = 0;
+
+	for (int i = 0; i < batch->copy_count; i++){
+		struct upload_copy *copy = &batch->copies[i];
+		//the access masks of the side that isnt executing are ignored, release only makes writes available
+		VkAccessFlags src_access = release ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+		VkAccessFlags dst_access = release && transfer_ownership ? 0 : UPLOAD_DST_ACCESS;
+
+		if (copy->is_image){
+			VkImageMemoryBarrier *barrier = &image_barriers[image_count++];
+			*barrier = (VkImageMemoryBarrier){0};
+			barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier->srcAccessMask = src_access;
+			barrier->dstAccessMask = dst_access;
+			barrier->oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier->newLayout = copy->final_layout;
+			barrier->srcQueueFamilyIndex = src_family;
+			barrier->dstQueueFamilyIndex = dst_family;
+			barrier->image = copy->image;
+			barrier->subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			barrier->subresourceRange.levelCount = 1;
+			barrier->subresourceRange.layerCount = 1;
+		} else {
+			VkBufferMemoryBarrier *barrier = &buffer_barriers[buffer_count++];
+			*barrier = (VkBufferMemoryBarrier){0};
+			barrier->sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier->srcAccessMask = src_access;
+			barrier->dstAccessMask = dst_access;
+			barrier->srcQueueFamilyIndex = src_family;
+			barrier->dstQueueFamilyIndex = dst_family;
+			barrier->buffer = copy->buffer;
+			barrier->offset = copy->destination_offset;
+			barrier->size = copy->size;
+		}
+	}
+
+	//the acquire's first scope has to hold the stages the semaphore wait blocked, top of pipe there would be no stages
+	//at all and nothing after it would be ordered behind the copies, its second scope covers every later graphics submit
+	VkPipelineStageFlags src_stage = release ? VK_PIPELINE_STAGE_TRANSFER_BIT : UPLOAD_DST_STAGES;
+	VkPipelineStageFlags dst_stage = release && transfer_ownership ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : UPLOAD_DST_STAGES;
+	vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, NULL, buffer_count, buffer_barriers, image_count, image_barriers);
+}
+
+static void record_copies(VkCommandBuffer command_buffer, struct upload_manager *manager, struct upload_batch *batch){
+	//images have to be in transfer dst before anything can be copied into them, whatever was in them is thrown away
+	VkImageMemoryBarrier to_transfer[UPLOAD_MAX_COPIES];
+	uint32_t image_count = 0;
+	for (int i = 0; i < batch->copy_count; i++){
+		if (!batch->copies[i].is_image)
+			continue;
+
+		VkImageMemoryBarrier *barrier = &to_transfer[image_count++];
+		*barrier = (VkImageMemoryBarrier){0};
+		barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier->srcAccessMask = 0;
+		barrier->dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier->oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier->newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier->image = batch->copies[i].image;
+		barrier->subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier->subresourceRange.levelCount = 1;
+		barrier->subresourceRange.layerCount = 1;
+	}
+	if (image_count)
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, image_count, to_transfer);
+
+	for (int i = 0; i < batch->copy_count; i++){
+		struct upload_copy *copy = &batch->copies[i];
+		if (copy->is_image){
+			VkBufferImageCopy region = {0};
+			region.bufferOffset = copy->staging_offset;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent = copy->extent;
+			vkCmdCopyBufferToImage(command_buffer, manager->staging_buffer, copy->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		} else {
+			VkBufferCopy region = {0};
+			region.srcOffset = copy->staging_offset;
+			region.dstOffset = copy->destination_offset;
+			region.size = copy->size;
+			vkCmdCopyBuffer(command_buffer, manager->staging_buffer, copy->buffer, 1, &region);
+		}
+	}
+}
+
+static void begin_one_time(VkCommandBuffer command_buffer){
+	VkCommandBufferBeginInfo begin_info = {0};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS)
+		printf("Error: failed to begin recording upload commands");
+}
+
+//submits everything queued so far as one batch and moves on to the next one, returns the batch number to check with
+//upload_complete, or the newest submitted one when there was nothing to flush
+uint64_t upload_flush(VkDevice device, struct upload_manager *manager){
+	struct upload_batch *batch = &manager->batches[manager->current];
+	if (!batch->copy_count)
+		return manager->next_batch - 1;
+
+	PROFILE_BEGIN("upload_flush");
+	bool transfer_ownership = manager->transfer_family != manager->graphics_family;
+
+	//the fence was waited on before the batch was filled so the pools are free to reset
+	vkResetCommandPool(device, batch->transfer_pool, 0);
+	begin_one_time(batch->transfer_commands);
+	record_copies(batch->transfer_commands, manager, batch);
+	record_handover(batch->transfer_commands, manager, batch, true);
+	if (vkEndCommandBuffer(batch->transfer_commands) != VK_SUCCESS)
+		printf("Error: failed to record upload commands");
+
+	vkResetFences(device, 1, &batch->done);
+
+	VkSubmitInfo submit_info = {0};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &batch->transfer_commands;
+
+	if (!transfer_ownership){
+		//one family means the copies and their barrier already ran on the graphics queue, nothing to hand over
+		if (vkQueueSubmit(manager->graphics_queue, 1, &submit_info, batch->done) != VK_SUCCESS)
+			printf("Error: failed to submit uploads");
+	} else {
+		submit_info.signalSemaphoreCount = 1;
+		submit_info.pSignalSemaphores = &batch->transfer_done;
+		if (vkQueueSubmit(manager->transfer_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS)
+			printf("Error: failed to submit uploads");
+
+		//the acquire barriers are in submission order before any later graphics work so everything drawn after
+		//this sees the uploaded data, the wait only holds back the stages that read it and only in this tiny submit
+		vkResetCommandPool(device, batch->acquire_pool, 0);
+		begin_one_time(batch->acquire_commands);
+		record_handover(batch->acquire_commands, manager, batch, false);
+		if (vkEndCommandBuffer(batch->acquire_commands) != VK_SUCCESS)
+			printf("Error: failed to record upload acquire commands");
+
+		VkPipelineStageFlags wait_stage = UPLOAD_DST_STAGES;
+		VkSubmitInfo acquire_info = {0};
+		acquire_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquire_info.waitSemaphoreCount = 1;
+		acquire_info.pWaitSemaphores = &batch->transfer_done;
+		acquire_info.pWaitDstStageMask = &wait_stage;
+		acquire_info.commandBufferCount = 1;
+		acquire_info.pCommandBuffers = &batch->acquire_commands;
+
+		if (vkQueueSubmit(manager->graphics_queue, 1, &acquire_info, batch->done) != VK_SUCCESS)
+			printf("Error: failed to submit upload acquire");
+	}
+
+	batch->submitted = manager->next_batch++;
+	batch->copy_count = 0;
+	batch->staging_used = 0;
+	manager->submits++;
+
+	//the next batch can only be filled once the gpu is done with its staging memory
+	manager->current = (manager->current + 1) % UPLOAD_BATCH_COUNT;
+	struct upload_batch *next = &manager->batches[manager->current];
+	if (next->submitted){
+		vkWaitForFences(device, 1, &next->done, VK_TRUE, UINT64_MAX);
+		manager->completed = MAX(manager->completed, next->submitted);
+	}
+
+	PROFILE_END();
+	return batch->submitted;
+}
+
+bool upload_complete(VkDevice device, struct upload_manager *manager, uint64_t batch_number){
+	if (batch_number <= manager->completed)
+		return true;
+
+	for (int i = 0; i < UPLOAD_BATCH_COUNT; i++){
+		struct upload_batch *batch = &manager->batches[i];
+		if (batch->submitted && vkGetFenceStatus(device, batch->done) == VK_SUCCESS)
+			manager->completed = MAX(manager->completed, batch->submitted);
+	}
+	return batch_number <= manager->completed;
+}
+
+void upload_wait_idle(VkDevice device, struct upload_manager *manager){
+	for (int i = 0; i < UPLOAD_BATCH_COUNT; i++){
+		struct upload_batch *batch = &manager->batches[i];
+		if (!batch->submitted)
+			continue;
+
+		vkWaitForFences(device, 1, &batch->done, VK_TRUE, UINT64_MAX);
+		manager->completed = MAX(manager->completed, batch->submitted);
+	}
+}
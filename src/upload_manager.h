@@ -0,0 +1,72 @@
+//upload manager functions
+struct upload_manager create_upload_manager(VkDevice device, struct gpu_allocator *allocator, struct queue_family_indices indices, VkQueue transfer_queue, VkQueue graphics_queue, VkDeviceSize staging_size);
+void destroy_upload_manager(VkDevice device, struct upload_manager *manager);
+bool upload_buffer(VkDevice device, struct upload_manager *manager, VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size);
+bool upload_image(VkDevice device, struct upload_manager *manager, VkImage image, VkExtent3D extent, VkImageLayout final_layout, const void *data, VkDeviceSize size);
+uint64_t upload_flush(VkDevice device, struct upload_manager *manager);
+bool upload_complete(VkDevice device, struct upload_manager *manager, uint64_t batch);
+void upload_wait_idle(VkDevice device, struct upload_manager *manager);
+
+
+//structs
+
+//the most copies one batch can hold before it is flushed by itself
+#define UPLOAD_MAX_COPIES 256
+//batches in flight, one fills while the other is copied
+#define UPLOAD_BATCH_COUNT 2
+
+//a copy waiting to be recorded, the source is always this batch's part of the staging buffer
+struct upload_copy{
+	bool is_image;
+	VkBuffer buffer;
+	VkImage image;
+	VkDeviceSize staging_offset;
+	VkDeviceSize destination_offset;
+	VkDeviceSize size;
+	VkExtent3D extent;
+	VkImageLayout final_layout;
+};
+
+//everything one batch needs, its own slice of staging memory, command buffers and sync
+//transfer records the copies and the release half of each ownership transfer, acquire is the graphics half
+struct upload_batch{
+	VkDeviceSize staging_base;
+	VkDeviceSize staging_used;
+	struct upload_copy copies[UPLOAD_MAX_COPIES];
+	int copy_count;
+
+	VkCommandPool transfer_pool;
+	VkCommandBuffer transfer_commands;
+	VkCommandPool acquire_pool;
+	VkCommandBuffer acquire_commands;
+	//transfer signals it and the graphics queue waits on it before taking ownership, only used with a transfer family
+	VkSemaphore transfer_done;
+	//signaled once the whole batch, acquire included, has finished so the batch can be reused
+	VkFence done;
+
+	//the batch number last submitted from here, 0 if it was never submitted
+	uint64_t submitted;
+};
+
+//batches many small uploads into one staging buffer and one submit on the transfer queue
+//with a dedicated transfer family the copies run on the copy engine while the graphics queue keeps rendering,
+//the graphics queue only waits on them in the small acquire submit that hands the resources over
+struct upload_manager{
+	uint32_t transfer_family;
+	uint32_t graphics_family;
+	VkQueue transfer_queue;
+	VkQueue graphics_queue;
+
+	VkBuffer staging_buffer;
+	struct gpu_allocation staging_allocation;
+	VkDeviceSize batch_staging_size;
+
+	struct upload_batch batches[UPLOAD_BATCH_COUNT];
+	int current;
+	//batch numbers count up from 1, completed is the newest one known to be done
+	uint64_t next_batch;
+	uint64_t completed;
+
+	uint64_t bytes_uploaded;
+	uint64_t submits;
+};
@@ -0,0 +1,209 @@
+//plain old C headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+//GLFW header
+#define GLFW_INCLUDE_VULKAN
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include "host_allocator.h"
+#include "gpu_timer.h"
+#include "vulkan_helpers.h"
+#include "upload_manager.h"
+#include "mesh.h"
+#include "obj_import.h"
+#include "vertex_quantize.h"
+#include "basic_helpers.h"
+
+static const char *vertex_quantization_names[VERTEX_QUANTIZE_COUNT] = {
+	[VERTEX_QUANTIZE_NONE] = "none",
+	[VERTEX_QUANTIZE_SNORM16] = "snorm16",
+	[VERTEX_QUANTIZE_HALF] = "half"
+};
+
+const char *vertex_quantization_name(enum vertex_quantization mode){
+	if (mode < 0 || mode >= VERTEX_QUANTIZE_COUNT)
+		return "unknown";
+	return vertex_quantization_names[mode];
+}
+
+bool parse_vertex_quantization(const char *name, enum vertex_quantization *mode){
+	for (int i = 0; i < VERTEX_QUANTIZE_COUNT; i++){
+		if (strcmp(name, vertex_quantization_names[i]) == 0){
+			*mode = (enum vertex_quantization)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+//rounds to nearest even like the hardware does, anything too big becomes infinity and too small flushes through subnormals to 0
+uint16_t float_to_half(float value){
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof bits);
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t exponent = (bits >> 23) & 0xFF;
+	uint32_t mantissa = bits & 0x7FFFFF;
+
+	if (exponent == 0xFF)
+		return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+
+	int32_t half_exponent = (int32_t)exponent - 127 + 15;
+	if (half_exponent >= 31)
+		return (uint16_t)(sign | 0x7C00);
+
+	if (half_exponent <= 0){
+		if (half_exponent < -10)
+			return (uint16_t)sign;
+		//the implicit leading 1 becomes part of the subnormal's mantissa
+		mantissa |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - half_exponent);
+		uint32_t half_mantissa = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half_mantissa & 1)))
+			half_mantissa++;
+		return (uint16_t)(sign | half_mantissa);
+	}
+
+	//rounding up can carry into the exponent, which is still the right answer all the way up to infinity
+	uint32_t half = sign | ((uint32_t)half_exponent << 10) | (mantissa >> 13);
+	uint32_t remainder = mantissa & 0x1FFF;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+		half++;
+	return (uint16_t)half;
+}
+
+static int16_t float_to_snorm16(float value){
+	value = value < -1.0f ? -1.0f : value > 1.0f ? 1.0f : value;
+	value *= 32767.0f;
+	return (int16_t)(value + (value >= 0.0f ? 0.5f : -0.5f));
+}
+
+//maps the bounds onto -1 to 1 on every axis, a flat axis keeps a scale of 1 so nothing divides by 0
+struct position_transform compute_position_transform(const float *positions, uint32_t vertex_count){
+	struct mesh_bounds bounds = compute_mesh_bounds(VK_FORMAT_R32G32B32_SFLOAT, positions, vertex_count);
+	struct position_transform transform = {.scale = {1.0f, 1.0f, 1.0f, 1.0f}, .offset = {0.0f, 0.0f, 0.0f, 0.0f}};
+	for (int c = 0; c < 3; c++){
+		float half_extent = (bounds.max[c] - bounds.min[c]) * 0.5f;
+		transform.offset[c] = bounds.min[c] + half_extent;
+		if (half_extent > 0.0f)
+			transform.scale[c] = half_extent;
+	}
+	return transform;
+}
+
+//three component 16 bit formats are rarely supported for vertex fetch, so positions are padded out to four
+void *quantize_positions(enum vertex_quantization mode, const float *positions, uint32_t vertex_count, const struct position_transform *transform, VkFormat *format){
+	if (mode != VERTEX_QUANTIZE_SNORM16 && mode != VERTEX_QUANTIZE_HALF)
+		return NULL;
+
+	uint16_t *quantized = malloc(sizeof *quantized * 4 * (vertex_count ? vertex_count : 1));
+	if (!quantized){
+		printf("Error: failed to allocate quantised positions");
+		return NULL;
+	}
+
+	float inverse_scale[3];
+	for (int c = 0; c < 3; c++)
+		inverse_scale[c] = 1.0f / transform->scale[c];
+
+	for (uint32_t v = 0; v < vertex_count; v++){
+		for (int c = 0; c < 3; c++){
+			float stored = (positions[v * 3 + c] - transform->offset[c]) * inverse_scale[c];
+			quantized[v * 4 + c] = mode == VERTEX_QUANTIZE_SNORM16 ? (uint16_t)float_to_snorm16(stored) : float_to_half(stored);
+		}
+		quantized[v * 4 + 3] = 0;
+	}
+
+	*format = mode == VERTEX_QUANTIZE_SNORM16 ? VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R16G16B16A16_SFLOAT;
+	return quantized;
+}
+
+//unit normals folded onto an octahedron and flattened to two snorm16s, under 0.04 degrees of error at worst
+void *encode_octahedral(const float *vectors, uint32_t count, VkFormat *format){
+	int16_t *encoded = malloc(sizeof *encoded * 2 * (count ? count : 1));
+	if (!encoded){
+		printf("Error: failed to allocate octahedral vectors");
+		return NULL;
+	}
+
+	for (uint32_t i = 0; i < count; i++){
+		float x = vectors[i * 3], y = vectors[i * 3 + 1], z = vectors[i * 3 + 2];
+		float ax = x < 0.0f ? -x : x;
+		float ay = y < 0.0f ? -y : y;
+		float az = z < 0.0f ? -z : z;
+		float length = ax + ay + az;
+
+		float u = 0.0f, v = 0.0f;
+		if (length > 0.0f){
+			u = x / length;
+			v = y / length;
+			//the lower half is folded over the diagonals onto the outer triangles of the square
+			if (z < 0.0f){
+				float au = u < 0.0f ? -u : u;
+				float av = v < 0.0f ? -v : v;
+				float folded_u = (1.0f - av) * (u >= 0.0f ? 1.0f : -1.0f);
+				float folded_v = (1.0f - au) * (v >= 0.0f ? 1.0f : -1.0f);
+				u = folded_u;
+				v = folded_v;
+			}
+		}
+		encoded[i * 2] = float_to_snorm16(u);
+		encoded[i * 2 + 1] = float_to_snorm16(v);
+	}
+
+	*format = VK_FORMAT_R16G16_SNORM;
+	return encoded;
+}
+
+struct quantized_vertices quantize_imported_mesh(const struct imported_mesh *mesh, enum vertex_quantization mode){
+	struct quantized_vertices vertices = {0};
+	vertices.attribute_count = 2;
+	vertices.transform = (struct position_transform){.scale = {1.0f, 1.0f, 1.0f, 1.0f}, .offset = {0.0f, 0.0f, 0.0f, 0.0f}};
+
+	//the float layout the importer has always drawn with, normals make a reasonable colour and positions do when there are none
+	vertices.formats[0] = VK_FORMAT_R32G32B32_SFLOAT;
+	vertices.formats[1] = VK_FORMAT_R32G32B32_SFLOAT;
+	vertices.attributes[0] = mesh->positions;
+	vertices.attributes[1] = mesh->normals ? mesh->normals : mesh->positions;
+
+	if (mode == VERTEX_QUANTIZE_SNORM16 || mode == VERTEX_QUANTIZE_HALF){
+		vertices.transform = compute_position_transform(mesh->positions, mesh->vertex_count);
+		void *positions = quantize_positions(mode, mesh->positions, mesh->vertex_count, &vertices.transform, &vertices.formats[0]);
+		void *normals = mesh->normals ? encode_octahedral(mesh->normals, mesh->vertex_count, &vertices.formats[1]) : NULL;
+
+		if (positions && (normals || !mesh->normals)){
+			vertices.attributes[0] = positions;
+			vertices.owned[0] = true;
+			if (normals){
+				vertices.attributes[1] = normals;
+				vertices.owned[1] = true;
+			} else {
+				//shared rather than duplicated, destroy only frees it through the position
+				vertices.attributes[1] = positions;
+				vertices.formats[1] = vertices.formats[0];
+			}
+		} else {
+			free(positions);
+			free(normals);
+			vertices.formats[0] = vertices.formats[1] = VK_FORMAT_R32G32B32_SFLOAT;
+			vertices.transform = (struct position_transform){.scale = {1.0f, 1.0f, 1.0f, 1.0f}, .offset = {0.0f, 0.0f, 0.0f, 0.0f}};
+		}
+	}
+
+	vertices.vertex_size = vertex_format_size(vertices.formats[0]) + vertex_format_size(vertices.formats[1]);
+	return vertices;
+}
+
+void destroy_quantized_vertices(struct quantized_vertices *vertices){
+	for (uint32_t i = 0; i < vertices->attribute_count; i++){
+		if (vertices->owned[i])
+			free((void *)vertices->attributes[i]);
+	}
+	*vertices = (struct quantized_vertices){0};
+}
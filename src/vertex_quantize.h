@@ -0,0 +1,42 @@
+//forward declarations of structs defined further down that are passed around by pointer
+struct imported_mesh;
+struct position_transform;
+
+//enums
+
+//how positions are stored, normals are octahedral whenever it isnt none
+enum vertex_quantization{
+	VERTEX_QUANTIZE_NONE,
+	VERTEX_QUANTIZE_SNORM16,
+	VERTEX_QUANTIZE_HALF,
+	VERTEX_QUANTIZE_COUNT
+};
+
+//functions
+
+//attribute encoders, each returns a tightly packed array the caller frees and sets format to what it holds
+struct position_transform compute_position_transform(const float *positions, uint32_t vertex_count);
+void *quantize_positions(enum vertex_quantization mode, const float *positions, uint32_t vertex_count, const struct position_transform *transform, VkFormat *format);
+void *encode_octahedral(const float *vectors, uint32_t count, VkFormat *format);
+uint16_t float_to_half(float value);
+
+const char *vertex_quantization_name(enum vertex_quantization mode);
+bool parse_vertex_quantization(const char *name, enum vertex_quantization *mode);
+
+//imported meshes laid out the way shader.vert reads them, the position at location 0 and a colour at location 1
+struct quantized_vertices quantize_imported_mesh(const struct imported_mesh *mesh, enum vertex_quantization mode);
+void destroy_quantized_vertices(struct quantized_vertices *vertices);
+
+
+//structs
+
+//attributes ready for create_vertex_layout, create_mesh and save_mesh_file, with the transform the positions need
+//arrays that were already in the right format point into the imported mesh, owned marks the ones to free
+struct quantized_vertices{
+	VkFormat formats[2];
+	const void *attributes[2];
+	bool owned[2];
+	uint32_t attribute_count;
+	uint32_t vertex_size;
+	struct position_transform transform;
+};
@@ -4,14 +4,25 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stddef.h>
 
 //GLFW header
 #define GLFW_INCLUDE_VULKAN
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
+#include "host_allocator.h"
+#include "gpu_timer.h"
 #include "vulkan_helpers.h"
+#include "frame_ring.h"
+#include "mesh.h"
+#include "meshlet.h"
+#include "instancing.h"
+#include "object_cull.h"
+#include "draw_queue.h"
 #include "basic_helpers.h"
+#include "telemetry.h"
+#include "profiler.h"
 
 //the layers/extensions wanted on top of the GLFW required extensions
 const char *validation_layers[] = {"VK_LAYER_KHRONOS_validation"};
@@ -25,15 +36,49 @@ const char *device_extensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 	static const bool enableValidationLayers = true;
 #endif
 
+//enumeration results only need to live until startup is over, main resets this once everything is created
+#define VULKAN_SCRATCH_CHUNK_SIZE (64 * 1024)
+static struct scratch_arena vulkan_scratch = {0};
+
+static void *vulkan_scratch_alloc(size_t size){
+	if (!vulkan_scratch.chunk_size)
+		vulkan_scratch = create_scratch_arena(VULKAN_SCRATCH_CHUNK_SIZE);
+	return scratch_alloc(&vulkan_scratch, size);
+}
+
+void reset_vulkan_scratch(){
+	scratch_reset(&vulkan_scratch);
+}
+
+void destroy_vulkan_scratch(){
+	destroy_scratch_arena(&vulkan_scratch);
+}
+
+//one snapshot per physical device, machines with more devices than this just cycle through the slots
+#define MAX_DEVICE_CAPABILITIES 8
+static struct device_capabilities device_capabilities_cache[MAX_DEVICE_CAPABILITIES];
+static int device_capabilities_count = 0;
+
 GLFWwindow* InitialiseGLFW(uint32_t width, uint32_t height) {
 	glfwInit();
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
 	return(glfwCreateWindow(width, height, "Vulkan", NULL, NULL));
 }
 
-VkInstance create_vk_instance() {
+uint32_t negotiate_api_version(){
+	//vkEnumerateInstanceVersion only exists from 1.1 onwards so a missing function means a 1.0 loader
+	PFN_vkEnumerateInstanceVersion func = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(NULL, "vkEnumerateInstanceVersion");
+	uint32_t loader_version = VK_API_VERSION_1_0;
+	if (func && func(&loader_version) != VK_SUCCESS)
+		loader_version = VK_API_VERSION_1_0;
+
+	//1.2 is the newest version we have use for, anything past that gets clamped down
+	return MIN(loader_version, VK_API_VERSION_1_2);
+}
+
+VkInstance create_vk_instance(uint32_t api_version, bool headless) {
 	if (enableValidationLayers && !CheckValidationLayerSupport()) {
 		printf("Error: Validation layers requested but not found!");
 	}
@@ -44,10 +89,10 @@ VkInstance create_vk_instance() {
 		.applicationVersion = VK_MAKE_VERSION(1, 0, 0),
 		.pEngineName = "No Engine",
 		.engineVersion = VK_MAKE_VERSION(1, 0, 0),
-		.apiVersion = VK_API_VERSION_1_0
+		.apiVersion = api_version
 	};
 
-	struct extension_info ext = get_required_extensions();
+	struct extension_info ext = get_required_extensions(headless);
 
 	VkInstanceCreateInfo createInfo = {
 		.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
@@ -71,7 +116,7 @@ VkInstance create_vk_instance() {
 	}
 
 	VkInstance instance;
-	if (vkCreateInstance(&createInfo, NULL, &instance) != VK_SUCCESS)
+	if (vkCreateInstance(&createInfo, HOST_ALLOCATOR, &instance) != VK_SUCCESS)
 		printf("Error creating vk instance");
 	return instance;
 }
@@ -97,11 +142,10 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
 void PrintAvailibleExtensions() {
 	uint32_t extensionCount = 0;
 	vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, NULL);
-	VkExtensionProperties *extensions = malloc(sizeof *extensions * extensionCount);
+	VkExtensionProperties *extensions = vulkan_scratch_alloc(sizeof *extensions * extensionCount);
 
 	if (!extensions) {
 		printf("NULL pointer extensions");
-		free(extensions);
 		return;
 	}
 
@@ -113,8 +157,6 @@ void PrintAvailibleExtensions() {
 	{
 		printf("%s\n", extensions[i].extensionName);
 	}
-
-	free(extensions);
 }
 
 bool CheckValidationLayerSupport() {
@@ -122,11 +164,10 @@ bool CheckValidationLayerSupport() {
 	//if any one layer defined at the top is not found of the system then false is returned; true returned if all layers found
 	uint32_t layerCount;
 	vkEnumerateInstanceLayerProperties(&layerCount, NULL);
-	VkLayerProperties* AvailibleLayers = malloc(sizeof *AvailibleLayers * layerCount);
+	VkLayerProperties* AvailibleLayers = vulkan_scratch_alloc(sizeof *AvailibleLayers * layerCount);
 
 	if (!AvailibleLayers) {
 		printf("Null pointer AvailibleLayers");
-		free(AvailibleLayers);
 		return false;
 	}
 
@@ -142,25 +183,26 @@ bool CheckValidationLayerSupport() {
 			}
 		}
 		if (!found) {
-			free(AvailibleLayers);
 			return false;
 		}
 	}
-	free(AvailibleLayers);
 	return true;
 }
 
-struct extension_info get_required_extensions() {
+struct extension_info get_required_extensions(bool headless) {
+	//headless runs never initialise glfw and need no surface extensions at all
 	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	const char** glfwExtensions = NULL;
+	if (!headless)
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
 	uint32_t total_extension_count = glfwExtensionCount;
 	if (enableValidationLayers) {
 		total_extension_count += ARR_SIZE(other_extensions);
 	}
 	
-	const char** all_extensions = malloc(sizeof *all_extensions * total_extension_count);
+	//only has to outlive vkCreateInstance, so it goes in the scratch arena like the other enumeration results
+	const char** all_extensions = vulkan_scratch_alloc(sizeof *all_extensions * total_extension_count);
 
 	if (!all_extensions) {
 		printf("Null pointer all_extensions");
@@ -168,7 +210,6 @@ struct extension_info get_required_extensions() {
 			.extensions = NULL,
 			.extension_count = 0
 			};
-		free(all_extensions);
 		return(blank);
 	}
 
@@ -177,7 +218,7 @@ struct extension_info get_required_extensions() {
 		all_extensions[i] = glfwExtensions[i];
 	}
 
-	for (unsigned int i = 0; i < ARR_SIZE(other_extensions); i++) {
+	for (unsigned int i = 0; i < total_extension_count - glfwExtensionCount; i++) {
 		all_extensions[i + glfwExtensionCount] = other_extensions[i];
 	}
 
@@ -195,7 +236,7 @@ void setup_debug_messenger(VkInstance instance, VkDebugUtilsMessengerEXT* p_debu
 	VkDebugUtilsMessengerCreateInfoEXT create_info = { 0 };
 	populate_debug_create_info(&create_info);
 	
-	if (CreateDebugUtilsMessengerEXT(instance, &create_info, NULL, p_debug_messenger) != VK_SUCCESS) {
+	if (CreateDebugUtilsMessengerEXT(instance, &create_info, HOST_ALLOCATOR, p_debug_messenger) != VK_SUCCESS) {
 		printf("Error: failed to set up debug messenger!");
 	}
 }
@@ -213,21 +254,118 @@ VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMes
 VkSurfaceKHR create_surface(VkInstance instance, GLFWwindow* window){
 	VkSurfaceKHR surface;
 
-	if (glfwCreateWindowSurface(instance, window, NULL, &surface) != VK_SUCCESS)
+	if (glfwCreateWindowSurface(instance, window, HOST_ALLOCATOR, &surface) != VK_SUCCESS)
 		printf("Error: failed to create window surface");
 
 	return surface;
 }
 
 VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData) {
+	//handed to the telemetry thread so validation spam never blocks on stdout
+	TELEMETRY_EVENT(TELEMETRY_DEBUG_MESSAGE, 0, (int32_t)messageSeverity, (int32_t)messageType, pCallbackData->pMessage);
 
-	static int count = 0;
+	return VK_FALSE;
+}
 
-	printf("Current Count: %d\tSeverity: %d\tType: %d\tMessage: %s\n\n", ++count, messageSeverity, messageType, pCallbackData->pMessage);
 
-	return VK_FALSE;
+static void free_surface_capabilities(struct device_capabilities *caps){
+	free(caps->present_support);
+	free(caps->formats);
+	free(caps->present_modes);
+	caps->present_support = NULL;
+	caps->formats = NULL;
+	caps->present_modes = NULL;
+	caps->format_count = 0;
+	caps->present_mode_count = 0;
+	caps->surface = VK_NULL_HANDLE;
+}
+
+static void snapshot_surface_capabilities(struct device_capabilities *caps, VkSurfaceKHR surface){
+	free_surface_capabilities(caps);
+	caps->surface = surface;
+
+	caps->present_support = malloc(sizeof *caps->present_support * caps->queue_family_count);
+	for (uint32_t i = 0; i < caps->queue_family_count; i++){
+		VkBool32 supported = false;
+		vkGetPhysicalDeviceSurfaceSupportKHR(caps->physical_device, i, surface, &supported);
+		caps->present_support[i] = supported;
+	}
+
+	uint32_t format_count = 0;
+	vkGetPhysicalDeviceSurfaceFormatsKHR(caps->physical_device, surface, &format_count, NULL);
+	if (format_count){
+		caps->formats = malloc(sizeof *caps->formats * format_count);
+		vkGetPhysicalDeviceSurfaceFormatsKHR(caps->physical_device, surface, &format_count, caps->formats);
+		caps->format_count = format_count;
+	}
+
+	uint32_t present_mode_count = 0;
+	vkGetPhysicalDeviceSurfacePresentModesKHR(caps->physical_device, surface, &present_mode_count, NULL);
+	if (present_mode_count){
+		caps->present_modes = malloc(sizeof *caps->present_modes * present_mode_count);
+		vkGetPhysicalDeviceSurfacePresentModesKHR(caps->physical_device, surface, &present_mode_count, caps->present_modes);
+		caps->present_mode_count = present_mode_count;
+	}
 }
 
+static void snapshot_device_capabilities(struct device_capabilities *caps, VkPhysicalDevice physical_device){
+	caps->physical_device = physical_device;
+	vkGetPhysicalDeviceProperties(physical_device, &caps->properties);
+	vkGetPhysicalDeviceFeatures(physical_device, &caps->features);
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &caps->memory_properties);
+
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &caps->queue_family_count, NULL);
+	caps->queue_families = malloc(sizeof *caps->queue_families * caps->queue_family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &caps->queue_family_count, caps->queue_families);
+
+	//the extension list itself is only needed to answer this once so it stays in the scratch arena
+	uint32_t extension_count = 0;
+	vkEnumerateDeviceExtensionProperties(physical_device, NULL, &extension_count, NULL);
+	VkExtensionProperties *extensions = vulkan_scratch_alloc(sizeof *extensions * extension_count);
+	vkEnumerateDeviceExtensionProperties(physical_device, NULL, &extension_count, extensions);
+
+	caps->device_extensions_supported = true;
+	for (unsigned int i = 0; i < ARR_SIZE(device_extensions); i++){
+		bool found = false;
+		for (unsigned int j = 0; j < extension_count; j++){
+			if (strcmp(device_extensions[i], extensions[j].extensionName) == 0)
+				found = true;
+		}
+		if (!found)
+			caps->device_extensions_supported = false;
+	}
+}
+
+const struct device_capabilities *get_device_capabilities(VkPhysicalDevice physical_device, VkSurfaceKHR surface){
+	struct device_capabilities *caps = NULL;
+	for (int i = 0; i < MIN(device_capabilities_count, MAX_DEVICE_CAPABILITIES); i++){
+		if (device_capabilities_cache[i].physical_device == physical_device)
+			caps = &device_capabilities_cache[i];
+	}
+
+	if (!caps){
+		caps = &device_capabilities_cache[device_capabilities_count++ % MAX_DEVICE_CAPABILITIES];
+		free_surface_capabilities(caps);
+		free(caps->queue_families);
+		*caps = (struct device_capabilities){0};
+		snapshot_device_capabilities(caps, physical_device);
+	}
+
+	//a null surface asks for the device half only, whatever surface was snapshotted before stays put
+	if (surface != VK_NULL_HANDLE && surface != caps->surface)
+		snapshot_surface_capabilities(caps, surface);
+
+	return caps;
+}
+
+void destroy_device_capabilities(){
+	for (int i = 0; i < MIN(device_capabilities_count, MAX_DEVICE_CAPABILITIES); i++){
+		free_surface_capabilities(&device_capabilities_cache[i]);
+		free(device_capabilities_cache[i].queue_families);
+		device_capabilities_cache[i] = (struct device_capabilities){0};
+	}
+	device_capabilities_count = 0;
+}
 
 VkPhysicalDevice pick_physical_device(VkInstance instance, VkSurfaceKHR surface){
 	VkPhysicalDevice device = VK_NULL_HANDLE;
@@ -235,7 +373,7 @@ VkPhysicalDevice pick_physical_device(VkInstance instance, VkSurfaceKHR surface)
 	vkEnumeratePhysicalDevices(instance, &device_count, NULL);
 	if (device_count == 0)
 		printf("Error: No physical devices found");
-	VkPhysicalDevice *devices = malloc(sizeof *devices * device_count);
+	VkPhysicalDevice *devices = vulkan_scratch_alloc(sizeof *devices * device_count);
 
 	vkEnumeratePhysicalDevices(instance, &device_count, devices);
 
@@ -247,30 +385,28 @@ VkPhysicalDevice pick_physical_device(VkInstance instance, VkSurfaceKHR surface)
 	if (device == VK_NULL_HANDLE)
 		printf("Error: No suitible device found");
 
-	free(devices);
 	return device;
 }
 
 bool is_device_suitable(VkPhysicalDevice device, VkSurfaceKHR surface){
-	VkPhysicalDeviceProperties device_properties;
-   VkPhysicalDeviceFeatures device_features;
-   vkGetPhysicalDeviceProperties(device, &device_properties);
-   vkGetPhysicalDeviceFeatures(device, &device_features);
+	const struct device_capabilities *caps = get_device_capabilities(device, surface);
 
 	struct queue_family_indices indices = find_queue_families(device, surface);
-	struct swap_chain_support_details details = query_swap_chain_support(device, surface);
 
+	//a null surface means we are running headless, then nothing about presenting matters
+	bool headless = surface == VK_NULL_HANDLE;
 
-	bool queue_adequate = indices.graphics_family_set && indices.presentation_family_set;
-	bool device_extension_support = check_device_extension_support(device);
+	bool queue_adequate = indices.graphics_family_set && (headless || indices.presentation_family_set);
+	bool device_extension_support = headless || check_device_extension_support(device);
 
-	bool swap_chain_adaquate = false;
-	if (device_extension_support){
-		swap_chain_adaquate = details.format_count && details.present_modes_count;
+	bool swap_chain_adaquate = headless;
+	if (!headless && device_extension_support){
+		swap_chain_adaquate = caps->format_count && caps->present_mode_count;
 	}
 
-	bool features_adaquate = device_features.geometryShader;
-	bool type_adaquate = device_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
+	bool features_adaquate = caps->features.geometryShader;
+	//headless runs are for render servers which may only have a software driver such as lavapipe
+	bool type_adaquate = headless || caps->properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
 
 	bool device_adaquate = queue_adequate && swap_chain_adaquate && device_extension_support && features_adaquate && type_adaquate;
 
@@ -278,72 +414,107 @@ bool is_device_suitable(VkPhysicalDevice device, VkSurfaceKHR surface){
 }
 
 bool check_device_extension_support(VkPhysicalDevice device){
-	uint32_t extension_count = 0;
-	vkEnumerateDeviceExtensionProperties(device, NULL, &extension_count, NULL);
-
-	VkExtensionProperties *extensions = malloc(sizeof *extensions * extension_count);
-	vkEnumerateDeviceExtensionProperties(device, NULL, &extension_count, extensions);
-
-	bool found;
-	for (unsigned int i = 0; i < ARR_SIZE(device_extensions); i++) {
-		found = false;
-		for (unsigned int j = 0; j < extension_count; j++) {
-			if (strcmp(device_extensions[i], extensions[j].extensionName) == 0)
-				found = true;
-		}
-		if (!found) {
-			return false;
-		}
-	}
-	return true;
+	return get_device_capabilities(device, VK_NULL_HANDLE)->device_extensions_supported;
 }
 
 struct queue_family_indices find_queue_families(VkPhysicalDevice device, VkSurfaceKHR surface){
+	//called once per candidate device and again by most of the setup functions, so it gets its own span
+	PROFILE_BEGIN("find_queue_families");
 	struct queue_family_indices indices = {0};
 
-	indices.family_count = 2;
+	//headless runs only need the graphics family plus the transfer one
+	bool headless = surface == VK_NULL_HANDLE;
+	indices.family_count = headless ? 2 : 3;
 
-	uint32_t family_count = 0;
-	vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count, NULL);
+	const struct device_capabilities *caps = get_device_capabilities(device, surface);
+	uint32_t family_count = caps->queue_family_count;
+	VkQueueFamilyProperties *families = caps->queue_families;
 
-	VkQueueFamilyProperties *families = malloc(sizeof *families * family_count);
-	vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count, families);
-
-	VkBool32 presentation_support;
+	//a transfer only family is usually the copy engine, one with compute but no graphics is the next best thing
+	int transfer_score = 0;
 
 	for (unsigned int i = 0; i < family_count; i++){
-		if(families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT){
+		VkQueueFlags flags = families[i].queueFlags;
+		if((flags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphics_family_set){
 			indices.graphics_family = i;
 			indices.graphics_family_set = true;
 		}
 
-		presentation_support = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentation_support);
-
-		if (presentation_support){
+		if (!headless && !indices.presentation_family_set && caps->present_support[i]){
 			indices.presentation_family = i;
 			indices.presentation_family_set = true;
 		}
 
-		if (indices.graphics_family_set && indices.presentation_family_set){
-			free(families);
-			return indices;
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)){
+			int score = (flags & VK_QUEUE_COMPUTE_BIT) ? 1 : 2;
+			if (score > transfer_score){
+				indices.transfer_family = i;
+				transfer_score = score;
+			}
 		}
-		
 	}
 
-	printf("Error: not all queue families found");
-	free(families);
+	//without a separate family uploads just go on the graphics queue and no ownership transfers are needed
+	if (!transfer_score)
+		indices.transfer_family = indices.graphics_family;
+	indices.transfer_family_set = indices.graphics_family_set;
+
+	if (!indices.graphics_family_set || (!headless && !indices.presentation_family_set))
+		printf("Error: not all queue families found");
+
+	PROFILE_END();
 	return indices;
 }
 
-VkDevice create_logical_device(VkPhysicalDevice physical_device, VkSurfaceKHR surface){
+//the 1.2 feature struct, left all false when the instance or the device is older than 1.2
+static VkPhysicalDeviceVulkan12Features query_vulkan_12_features(VkInstance instance, VkPhysicalDevice device, uint32_t api_version){
+	VkPhysicalDeviceVulkan12Features features_12 = {0};
+	features_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	if (api_version < VK_API_VERSION_1_2)
+		return features_12;
+
+	if (get_device_capabilities(device, VK_NULL_HANDLE)->properties.apiVersion < VK_API_VERSION_1_2)
+		return features_12;
+
+	PFN_vkGetPhysicalDeviceFeatures2 func = (PFN_vkGetPhysicalDeviceFeatures2)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2");
+	if (!func)
+		return features_12;
+
+	VkPhysicalDeviceFeatures2 features = {0};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &features_12;
+	func(device, &features);
+
+	features_12.pNext = NULL;
+	return features_12;
+}
+
+bool query_timeline_semaphore_support(VkInstance instance, VkPhysicalDevice device, uint32_t api_version){
+	return query_vulkan_12_features(instance, device, api_version).timelineSemaphore;
+}
+
+bool query_draw_indirect_count_support(VkInstance instance, VkPhysicalDevice device, uint32_t api_version){
+	return query_vulkan_12_features(instance, device, api_version).drawIndirectCount;
+}
+
+bool query_pipeline_statistics_support(VkPhysicalDevice device){
+	return get_device_capabilities(device, VK_NULL_HANDLE)->features.pipelineStatisticsQuery;
+}
+
+VkDevice create_logical_device(VkPhysicalDevice physical_device, VkSurfaceKHR surface, bool enable_timeline_semaphores, bool enable_pipeline_statistics, bool enable_draw_indirect_count){
 	//gets queue indices
 	struct queue_family_indices indices = find_queue_families(physical_device, surface);
 
-	int family_array[] = {indices.graphics_family, indices.presentation_family};
+	//the order has to match family_count, headless runs have no presentation family
+	int family_array[3];
+	int family_index = 0;
+	family_array[family_index++] = indices.graphics_family;
+	if (surface != VK_NULL_HANDLE)
+		family_array[family_index++] = indices.presentation_family;
+	family_array[family_index++] = indices.transfer_family;
 
-	VkDeviceQueueCreateInfo *queue_create_infos = malloc(sizeof *queue_create_infos * indices.family_count);
+	VkDeviceQueueCreateInfo *queue_create_infos = vulkan_scratch_alloc(sizeof *queue_create_infos * indices.family_count);
 
 	float queue_priority = 1.0f;
 
@@ -372,13 +543,25 @@ VkDevice create_logical_device(VkPhysicalDevice physical_device, VkSurfaceKHR su
 	}
 
 	VkPhysicalDeviceFeatures device_features = {VK_FALSE};
+	device_features.pipelineStatisticsQuery = enable_pipeline_statistics ? VK_TRUE : VK_FALSE;
+	//gpu driven drawing writes many draws with their own first instance, both cost nothing to turn on where they exist
+	const struct device_capabilities *caps = get_device_capabilities(physical_device, VK_NULL_HANDLE);
+	device_features.multiDrawIndirect = caps->features.multiDrawIndirect;
+	device_features.drawIndirectFirstInstance = caps->features.drawIndirectFirstInstance;
+
+	VkPhysicalDeviceVulkan12Features features_12 = {0};
+	features_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	features_12.timelineSemaphore = enable_timeline_semaphores ? VK_TRUE : VK_FALSE;
+	features_12.drawIndirectCount = enable_draw_indirect_count ? VK_TRUE : VK_FALSE;
 
 	VkDeviceCreateInfo create_info = {
 		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+		.pNext = enable_timeline_semaphores || enable_draw_indirect_count ? &features_12 : NULL,
 		.pQueueCreateInfos = queue_create_infos,
 		.queueCreateInfoCount = unique_family_count,
 		.pEnabledFeatures = &device_features,
-		.enabledExtensionCount = ARR_SIZE(device_extensions),
+		//the swap chain extension is only wanted when there is a surface to present to
+		.enabledExtensionCount = surface != VK_NULL_HANDLE ? ARR_SIZE(device_extensions) : 0,
 		.ppEnabledExtensionNames = device_extensions
 	};
 
@@ -391,33 +574,424 @@ VkDevice create_logical_device(VkPhysicalDevice physical_device, VkSurfaceKHR su
 
 	VkDevice device;
 
-	if (vkCreateDevice(physical_device, &create_info, NULL, &device) != VK_SUCCESS)
+	if (vkCreateDevice(physical_device, &create_info, HOST_ALLOCATOR, &device) != VK_SUCCESS)
 		printf("Error: Failed to create logical device");
 
 	return device;
 }
 
-struct swap_chain_support_details query_swap_chain_support(VkPhysicalDevice physical_device, VkSurfaceKHR surface){
-	struct swap_chain_support_details details;
+//device memory is handed out in nodes of GPU_MIN_NODE_SIZE << order bytes from blocks of at most GPU_MAX_BLOCK_SIZE
+//anything over half a block gets its own vkAllocateMemory as it would waste most of a block anyway
+#define GPU_MIN_NODE_SIZE 1024ull
+#define GPU_MAX_BLOCK_SIZE (64ull * 1024 * 1024)
+#define GPU_MIN_BLOCK_SIZE (1ull * 1024 * 1024)
+
+struct gpu_allocator create_gpu_allocator(VkPhysicalDevice physical_device, VkDevice device){
+	(void)device;
+	struct gpu_allocator allocator = {0};
+
+	const struct device_capabilities *caps = get_device_capabilities(physical_device, VK_NULL_HANDLE);
+	allocator.memory_properties = caps->memory_properties;
+	allocator.buffer_image_granularity = caps->properties.limits.bufferImageGranularity;
+	allocator.max_memory_allocations = caps->properties.limits.maxMemoryAllocationCount;
+
+	//an eighth of the heap rounded down to a power of two, so small heaps such as the 256MB bar heap dont get
+	//filled by a couple of mostly empty blocks
+	for (uint32_t i = 0; i < allocator.memory_properties.memoryHeapCount; i++){
+		VkDeviceSize target = allocator.memory_properties.memoryHeaps[i].size / 8;
+		VkDeviceSize block_size = GPU_MAX_BLOCK_SIZE;
+		while (block_size > GPU_MIN_BLOCK_SIZE && block_size > target)
+			block_size /= 2;
+		allocator.block_sizes[i] = block_size;
+	}
 
-	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &details.capabilities);
+	return allocator;
+}
 
-	uint32_t format_count = 0;
-	vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &format_count, NULL);
-	if (format_count){
-		details.formats = malloc(sizeof *details.formats * format_count);
-		vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &format_count, details.formats);
-		details.format_count = format_count;
+static void destroy_memory_block(VkDevice device, struct gpu_allocator *allocator, struct gpu_memory_block *block){
+	//freeing the memory unmaps it too
+	vkFreeMemory(device, block->memory, HOST_ALLOCATOR);
+	allocator->device_allocation_count--;
+
+	free(block->free_heads);
+	free(block->next_free);
+	free(block->prev_free);
+	free(block->free_order);
+	free(block);
+}
+
+void destroy_gpu_allocator(VkDevice device, struct gpu_allocator *allocator){
+	struct gpu_memory_block *block = allocator->blocks;
+	while (block){
+		if (block->allocation_count)
+			printf("Error: %u allocations still live in a memory block being destroyed\n", block->allocation_count);
+
+		struct gpu_memory_block *next = block->next;
+		destroy_memory_block(device, allocator, block);
+		block = next;
 	}
+	allocator->blocks = NULL;
 
-	uint32_t present_mode_count = 0;
-	vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &present_mode_count, NULL);
-	if (present_mode_count){
-		details.present_modes = malloc(sizeof *details.present_modes * present_mode_count);
-		vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &present_mode_count, details.present_modes);
-		details.present_modes_count = present_mode_count;
+	if (allocator->dedicated_count)
+		printf("Error: %u dedicated allocations still live when destroying the allocator\n", allocator->dedicated_count);
+}
+
+uint32_t choose_memory_type(struct gpu_allocator *allocator, uint32_t type_bits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred){
+	//type_bits has a bit set for every memory type the resource is allowed to live in, of the ones with every
+	//required flag pick the one with the most preferred flags, ties go to the lower index as the driver orders them best first
+	uint32_t best = UINT32_MAX;
+	int best_score = -1;
+	for (uint32_t i = 0; i < allocator->memory_properties.memoryTypeCount; i++){
+		VkMemoryPropertyFlags flags = allocator->memory_properties.memoryTypes[i].propertyFlags;
+		if (!(type_bits & (1u << i)) || (flags & required) != required)
+			continue;
+
+		int score = 0;
+		for (VkMemoryPropertyFlags bits = flags & preferred; bits; bits &= bits - 1)
+			score++;
+
+		if (score > best_score){
+			best = i;
+			best_score = score;
+		}
+	}
+
+	if (best == UINT32_MAX)
+		printf("Error: failed to find a suitable memory type");
+	return best;
+}
+
+//the buddy free lists, a free node is identified by the leaf it starts at
+static void push_free_node(struct gpu_memory_block *block, int32_t leaf, uint32_t order){
+	block->free_order[leaf] = (int8_t)order;
+	block->prev_free[leaf] = -1;
+	block->next_free[leaf] = block->free_heads[order];
+	if (block->free_heads[order] >= 0)
+		block->prev_free[block->free_heads[order]] = leaf;
+	block->free_heads[order] = leaf;
+}
+
+static void remove_free_node(struct gpu_memory_block *block, int32_t leaf){
+	uint32_t order = (uint32_t)block->free_order[leaf];
+	if (block->prev_free[leaf] >= 0)
+		block->next_free[block->prev_free[leaf]] = block->next_free[leaf];
+	else
+		block->free_heads[order] = block->next_free[leaf];
+
+	if (block->next_free[leaf] >= 0)
+		block->prev_free[block->next_free[leaf]] = block->prev_free[leaf];
+
+	block->free_order[leaf] = -1;
+}
+
+static struct gpu_memory_block *create_memory_block(VkDevice device, struct gpu_allocator *allocator, uint32_t memory_type, enum gpu_resource_kind kind){
+	if (allocator->device_allocation_count >= allocator->max_memory_allocations){
+		printf("Error: out of device memory allocations (%u)\n", allocator->max_memory_allocations);
+		return NULL;
+	}
+
+	struct gpu_memory_block *block = calloc(1, sizeof *block);
+	if (!block){
+		printf("Error: failed to allocate memory block");
+		return NULL;
+	}
+
+	uint32_t heap = allocator->memory_properties.memoryTypes[memory_type].heapIndex;
+	block->size = allocator->block_sizes[heap];
+	block->memory_type = memory_type;
+	block->kind = kind;
+	while ((GPU_MIN_NODE_SIZE << block->max_order) < block->size)
+		block->max_order++;
+
+	size_t leaf_count = (size_t)1 << block->max_order;
+	block->free_heads = malloc(sizeof *block->free_heads * (block->max_order + 1));
+	block->next_free = malloc(sizeof *block->next_free * leaf_count);
+	block->prev_free = malloc(sizeof *block->prev_free * leaf_count);
+	block->free_order = malloc(sizeof *block->free_order * leaf_count);
+	if (!block->free_heads || !block->next_free || !block->prev_free || !block->free_order){
+		printf("Error: failed to allocate memory block free lists");
+		free(block->free_heads);
+		free(block->next_free);
+		free(block->prev_free);
+		free(block->free_order);
+		free(block);
+		return NULL;
+	}
+
+	VkMemoryAllocateInfo alloc_info = {0};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.allocationSize = block->size;
+	alloc_info.memoryTypeIndex = memory_type;
+
+	if (vkAllocateMemory(device, &alloc_info, HOST_ALLOCATOR, &block->memory) != VK_SUCCESS){
+		printf("Error: failed to allocate a %llu byte memory block\n", (unsigned long long)block->size);
+		free(block->free_heads);
+		free(block->next_free);
+		free(block->prev_free);
+		free(block->free_order);
+		free(block);
+		return NULL;
+	}
+	allocator->device_allocation_count++;
+
+	if (allocator->memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT){
+		if (vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS)
+			printf("Error: failed to map memory block");
+	}
+
+	//the whole block starts out as one free node of the top order
+	memset(block->free_order, -1, sizeof *block->free_order * leaf_count);
+	for (uint32_t i = 0; i <= block->max_order; i++){
+		block->free_heads[i] = -1;
+	}
+	push_free_node(block, 0, block->max_order);
+
+	block->next = allocator->blocks;
+	allocator->blocks = block;
+	return block;
+}
+
+//takes a node of exactly order out of the block, splitting a bigger one if needed, -1 when nothing big enough is free
+static int32_t block_allocate_node(struct gpu_memory_block *block, uint32_t order){
+	uint32_t found = order;
+	while (found <= block->max_order && block->free_heads[found] < 0)
+		found++;
+	if (found > block->max_order)
+		return -1;
+
+	int32_t leaf = block->free_heads[found];
+	remove_free_node(block, leaf);
+
+	//hand the upper half back each time until the node is the right size
+	while (found > order){
+		found--;
+		push_free_node(block, leaf + (1 << found), found);
+	}
+	return leaf;
+}
+
+static void block_free_node(struct gpu_memory_block *block, int32_t leaf, uint32_t order){
+	//merge with the buddy for as long as it is free and whole
+	while (order < block->max_order){
+		int32_t buddy = leaf ^ (1 << order);
+		if (block->free_order[buddy] != (int8_t)order)
+			break;
+
+		remove_free_node(block, buddy);
+		leaf = MIN(leaf, buddy);
+		order++;
+	}
+	push_free_node(block, leaf, order);
+}
+
+static struct gpu_allocation allocate_dedicated(VkDevice device, struct gpu_allocator *allocator, VkDeviceSize size, uint32_t memory_type){
+	struct gpu_allocation allocation = {0};
+	if (allocator->device_allocation_count >= allocator->max_memory_allocations){
+		printf("Error: out of device memory allocations (%u)\n", allocator->max_memory_allocations);
+		return allocation;
+	}
+
+	VkMemoryAllocateInfo alloc_info = {0};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.allocationSize = size;
+	alloc_info.memoryTypeIndex = memory_type;
+
+	if (vkAllocateMemory(device, &alloc_info, HOST_ALLOCATOR, &allocation.memory) != VK_SUCCESS){
+		printf("Error: failed to allocate %llu bytes of dedicated memory\n", (unsigned long long)size);
+		allocation.memory = VK_NULL_HANDLE;
+		return allocation;
+	}
+
+	if (allocator->memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT){
+		if (vkMapMemory(device, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped) != VK_SUCCESS)
+			printf("Error: failed to map dedicated memory");
+	}
+
+	allocation.size = size;
+	allocation.memory_type = memory_type;
+	allocation.allocator = allocator;
+
+	allocator->device_allocation_count++;
+	allocator->dedicated_count++;
+	allocator->dedicated_bytes += size;
+	return allocation;
+}
+
+struct gpu_allocation gpu_allocate(VkDevice device, struct gpu_allocator *allocator, VkMemoryRequirements requirements, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, enum gpu_resource_kind kind, bool dedicated){
+	struct gpu_allocation allocation = {0};
+
+	uint32_t memory_type = choose_memory_type(allocator, requirements.memoryTypeBits, required, preferred);
+	if (memory_type == UINT32_MAX)
+		return allocation;
+
+	uint32_t heap = allocator->memory_properties.memoryTypes[memory_type].heapIndex;
+	if (dedicated || requirements.size > allocator->block_sizes[heap] / 2)
+		return allocate_dedicated(device, allocator, requirements.size, memory_type);
+
+	//with a granularity of 1 linear and optimal resources can sit next to each other so they may share blocks
+	if (allocator->buffer_image_granularity <= 1)
+		kind = GPU_RESOURCE_LINEAR;
+
+	//nodes are aligned to their own size so the node just has to be at least as big as the alignment
+	VkDeviceSize node_size = MAX(requirements.size, requirements.alignment);
+	uint32_t order = 0;
+	while ((GPU_MIN_NODE_SIZE << order) < node_size)
+		order++;
+
+	int32_t leaf = -1;
+	struct gpu_memory_block *block = allocator->blocks;
+	for (; block; block = block->next){
+		if (block->memory_type != memory_type || block->kind != kind || order > block->max_order)
+			continue;
+
+		leaf = block_allocate_node(block, order);
+		if (leaf >= 0)
+			break;
+	}
+
+	if (leaf < 0){
+		block = create_memory_block(device, allocator, memory_type, kind);
+		if (!block)
+			return allocation;
+		leaf = block_allocate_node(block, order);
 	}
 
+	allocation.memory = block->memory;
+	allocation.offset = (VkDeviceSize)leaf * GPU_MIN_NODE_SIZE;
+	allocation.size = requirements.size;
+	allocation.mapped = block->mapped ? (char *)block->mapped + allocation.offset : NULL;
+	allocation.memory_type = memory_type;
+	allocation.allocator = allocator;
+	allocation.block = block;
+	allocation.order = order;
+
+	block->reserved += GPU_MIN_NODE_SIZE << order;
+	block->requested += requirements.size;
+	block->allocation_count++;
+	return allocation;
+}
+
+struct gpu_allocation gpu_allocate_buffer(VkDevice device, struct gpu_allocator *allocator, VkBuffer buffer, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred){
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(device, buffer, &requirements);
+
+	struct gpu_allocation allocation = gpu_allocate(device, allocator, requirements, required, preferred, GPU_RESOURCE_LINEAR, false);
+	if (allocation.memory != VK_NULL_HANDLE)
+		vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+	return allocation;
+}
+
+struct gpu_allocation gpu_allocate_image(VkDevice device, struct gpu_allocator *allocator, VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred){
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(device, image, &requirements);
+
+	enum gpu_resource_kind kind = tiling == VK_IMAGE_TILING_LINEAR ? GPU_RESOURCE_LINEAR : GPU_RESOURCE_OPTIMAL;
+	struct gpu_allocation allocation = gpu_allocate(device, allocator, requirements, required, preferred, kind, false);
+	if (allocation.memory != VK_NULL_HANDLE)
+		vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+	return allocation;
+}
+
+void gpu_free(VkDevice device, struct gpu_allocation *allocation){
+	if (allocation->memory == VK_NULL_HANDLE)
+		return;
+
+	struct gpu_allocator *allocator = allocation->allocator;
+	struct gpu_memory_block *block = allocation->block;
+
+	if (!block){
+		vkFreeMemory(device, allocation->memory, HOST_ALLOCATOR);
+		allocator->device_allocation_count--;
+		allocator->dedicated_count--;
+		allocator->dedicated_bytes -= allocation->size;
+		*allocation = (struct gpu_allocation){0};
+		return;
+	}
+
+	block_free_node(block, (int32_t)(allocation->offset / GPU_MIN_NODE_SIZE), allocation->order);
+	block->reserved -= GPU_MIN_NODE_SIZE << allocation->order;
+	block->requested -= allocation->size;
+	block->allocation_count--;
+	*allocation = (struct gpu_allocation){0};
+
+	//an empty block is only given back when there is another one of its kind, so a single resource being
+	//created and destroyed every frame doesnt turn into a vkAllocateMemory every frame
+	if (block->allocation_count)
+		return;
+
+	struct gpu_memory_block **link = &allocator->blocks;
+	struct gpu_memory_block **block_link = NULL;
+	bool has_spare = false;
+	for (; *link; link = &(*link)->next){
+		if (*link == block)
+			block_link = link;
+		else if ((*link)->memory_type == block->memory_type && (*link)->kind == block->kind)
+			has_spare = true;
+	}
+
+	if (has_spare && block_link){
+		*block_link = block->next;
+		destroy_memory_block(device, allocator, block);
+	}
+}
+
+struct gpu_allocator_stats get_gpu_allocator_stats(struct gpu_allocator *allocator){
+	struct gpu_allocator_stats stats = {0};
+	stats.dedicated_count = allocator->dedicated_count;
+	stats.dedicated_bytes = allocator->dedicated_bytes;
+	stats.allocation_count = allocator->dedicated_count;
+	stats.device_allocation_count = allocator->device_allocation_count;
+	stats.max_memory_allocations = allocator->max_memory_allocations;
+	stats.reserved_bytes = allocator->dedicated_bytes;
+	stats.requested_bytes = allocator->dedicated_bytes;
+	VkDeviceSize fragmented_bytes = 0;
+
+	for (struct gpu_memory_block *block = allocator->blocks; block; block = block->next){
+		stats.block_count++;
+		stats.block_bytes += block->size;
+		stats.allocation_count += block->allocation_count;
+		stats.reserved_bytes += block->reserved;
+		stats.requested_bytes += block->requested;
+		stats.free_bytes += block->size - block->reserved;
+
+		//the largest free node is the first non empty list from the top
+		VkDeviceSize largest_free = 0;
+		for (int32_t order = (int32_t)block->max_order; order >= 0; order--){
+			if (block->free_heads[order] >= 0){
+				largest_free = GPU_MIN_NODE_SIZE << order;
+				break;
+			}
+		}
+		stats.largest_free_bytes = MAX(stats.largest_free_bytes, largest_free);
+		fragmented_bytes += block->size - block->reserved - largest_free;
+	}
+
+	stats.fragmentation = stats.free_bytes ? (double)fragmented_bytes / stats.free_bytes : 0.0;
+	return stats;
+}
+
+void print_gpu_allocator_stats(struct gpu_allocator *allocator){
+	struct gpu_allocator_stats stats = get_gpu_allocator_stats(allocator);
+	printf("Device memory: %u allocations in %u blocks (%.2f MB) and %u dedicated (%.2f MB), %u of %u vkAllocateMemory calls used\n",
+		stats.allocation_count, stats.block_count, stats.block_bytes / 1048576.0, stats.dedicated_count, stats.dedicated_bytes / 1048576.0,
+		stats.device_allocation_count, stats.max_memory_allocations);
+	printf("Device memory: %.2f MB requested, %.2f MB reserved, %.2f MB free in blocks, %.1f%% fragmented\n",
+		stats.requested_bytes / 1048576.0, stats.reserved_bytes / 1048576.0, stats.free_bytes / 1048576.0, stats.fragmentation * 100.0);
+}
+
+struct swap_chain_support_details query_swap_chain_support(VkPhysicalDevice physical_device, VkSurfaceKHR surface){
+	struct swap_chain_support_details details = {0};
+
+	//the current extent follows the window size so the capabilities are the one part that cant come from the snapshot
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &details.capabilities);
+
+	//the arrays belong to the snapshot, nothing here needs freeing
+	const struct device_capabilities *caps = get_device_capabilities(physical_device, surface);
+	details.formats = caps->formats;
+	details.format_count = caps->format_count;
+	details.present_modes = caps->present_modes;
+	details.present_modes_count = caps->present_mode_count;
+
 	return details;
 }
 
@@ -431,10 +1005,51 @@ VkSurfaceFormatKHR choose_swap_surface_format(VkSurfaceFormatKHR *available_form
 	return available_formats[0];
 }
 
-VkPresentModeKHR choose_swap_present_mode(VkPresentModeKHR *availible_modes, int mode_count){
-		//FIFO is the only mode guaranteed to be available
-		//TODO implement mode selection for v-sync triple sync etc
-		return VK_PRESENT_MODE_FIFO_KHR;
+//each goal ranks the present modes best first, the first one the surface supports wins
+//MAILBOX never tears and always shows the newest frame so it is the best for latency
+//IMMEDIATE is fully uncapped so it is the best for throughput but it tears
+//FIFO caps at the refresh rate so the gpu idles between frames which saves the most power
+static const VkPresentModeKHR present_mode_rankings[PRESENT_GOAL_COUNT][4] = {
+	[PRESENT_GOAL_LOW_LATENCY] = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR},
+	[PRESENT_GOAL_MAX_THROUGHPUT] = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR},
+	[PRESENT_GOAL_POWER_SAVING] = {VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR}
+};
+
+static const char *present_mode_goal_names[PRESENT_GOAL_COUNT] = {
+	[PRESENT_GOAL_LOW_LATENCY] = "latency",
+	[PRESENT_GOAL_MAX_THROUGHPUT] = "throughput",
+	[PRESENT_GOAL_POWER_SAVING] = "power"
+};
+
+VkPresentModeKHR choose_swap_present_mode(VkPresentModeKHR *availible_modes, int mode_count, enum present_mode_goal goal){
+	if (goal < 0 || goal >= PRESENT_GOAL_COUNT)
+		goal = PRESENT_GOAL_POWER_SAVING;
+
+	for (unsigned int i = 0; i < ARR_SIZE(present_mode_rankings[goal]); i++){
+		for (int j = 0; j < mode_count; j++){
+			if (availible_modes[j] == present_mode_rankings[goal][i])
+				return availible_modes[j];
+		}
+	}
+
+	//FIFO is the only mode guaranteed to be available
+	return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+const char *present_mode_goal_name(enum present_mode_goal goal){
+	if (goal < 0 || goal >= PRESENT_GOAL_COUNT)
+		return "unknown";
+	return present_mode_goal_names[goal];
+}
+
+bool parse_present_mode_goal(const char *name, enum present_mode_goal *goal){
+	for (int i = 0; i < PRESENT_GOAL_COUNT; i++){
+		if (strcmp(name, present_mode_goal_names[i]) == 0){
+			*goal = (enum present_mode_goal)i;
+			return true;
+		}
+	}
+	return false;
 }
 
 VkExtent2D choose_swap_extent(GLFWwindow *window, VkSurfaceCapabilitiesKHR capabilities){
@@ -457,11 +1072,11 @@ VkExtent2D choose_swap_extent(GLFWwindow *window, VkSurfaceCapabilitiesKHR capab
 	}
 }
 
-struct swap_chain_info create_swap_chain(VkPhysicalDevice physical_device, VkSurfaceKHR surface, GLFWwindow *window, VkDevice device) {
+struct swap_chain_info create_swap_chain(VkPhysicalDevice physical_device, VkSurfaceKHR surface, GLFWwindow *window, VkDevice device, enum present_mode_goal goal, VkSwapchainKHR old_swap_chain) {
 	struct swap_chain_support_details details = query_swap_chain_support(physical_device, surface);
 
 	VkSurfaceFormatKHR surface_format = choose_swap_surface_format(details.formats, details.format_count);
-	VkPresentModeKHR present_mode = choose_swap_present_mode(details.present_modes, details.present_modes_count);
+	VkPresentModeKHR present_mode = choose_swap_present_mode(details.present_modes, details.present_modes_count, goal);
 	VkExtent2D extent = choose_swap_extent(window, details.capabilities);
 
 	uint32_t min_image_count = details.capabilities.minImageCount + 1;
@@ -501,11 +1116,12 @@ struct swap_chain_info create_swap_chain(VkPhysicalDevice physical_device, VkSur
 	create_info.presentMode = present_mode;
 	//if some pixels are obscurred then we dont care about them which is better for performance
 	create_info.clipped = VK_TRUE;
-	create_info.oldSwapchain = VK_NULL_HANDLE;
+	//handing over the old swap chain lets the driver reuse its resources and keeps presenting smooth during a resize
+	create_info.oldSwapchain = old_swap_chain;
 
 	VkSwapchainKHR swap_chain;
 
-	if (vkCreateSwapchainKHR(device, &create_info, NULL, &swap_chain) != VK_SUCCESS){
+	if (vkCreateSwapchainKHR(device, &create_info, HOST_ALLOCATOR, &swap_chain) != VK_SUCCESS){
 		printf("Error: Unable to create swap chain");
 	}
 
@@ -519,12 +1135,109 @@ struct swap_chain_info create_swap_chain(VkPhysicalDevice physical_device, VkSur
 		.images = images,
 		.image_count = image_count,
 		.format = surface_format.format,
-		.extent = extent
+		.extent = extent,
+		.present_mode = present_mode
 	};
 
 	return info;
 }
 
+static void destroy_retired_swap_chain(VkDevice device, void *data){
+	struct swap_chain_resources *resources = data;
+	destroy_swap_chain_resources(device, resources);
+	free(resources);
+}
+
+void recreate_swap_chain(VkPhysicalDevice physical_device, VkSurfaceKHR surface, GLFWwindow *window, VkDevice device, VkRenderPass render_pass, enum present_mode_goal goal, struct swap_chain_resources *resources, struct frame_context *frame_context){
+	//frames still in flight may be using the old images, rather than waiting for the whole device to go idle
+	//the old resources are retired to the deletion queue and destroyed once every frame submitted so far has completed
+	struct swap_chain_resources *retired = malloc(sizeof *retired);
+	if (!retired){
+		printf("Error: failed to allocate retired swap chain");
+		return;
+	}
+	*retired = *resources;
+
+	resources->info = create_swap_chain(physical_device, surface, window, device, goal, retired->info.swap_chain);
+	resources->image_views = create_image_views(resources->info.images, resources->info.image_count, resources->info.format, device);
+	resources->framebuffers = create_swap_chain_framebuffers(device, resources->info.image_count, render_pass, resources->image_views, resources->info.extent);
+
+	push_deletion(&frame_context->deletion_queue, frame_context->frame_number, destroy_retired_swap_chain, retired);
+	TELEMETRY_EVENT(TELEMETRY_SWAP_CHAIN_RECREATED, frame_context->frame_number, 0, 0, present_mode_goal_name(goal));
+
+	//the image count can change between swap chains so the images in flight table has to follow it
+	reset_frame_context_images(frame_context, resources->info.image_count);
+}
+
+struct swap_chain_info create_offscreen_targets(VkDevice device, struct gpu_allocator *allocator, VkFormat format, VkExtent2D extent, int image_count){
+	struct swap_chain_info info = {
+		.swap_chain = VK_NULL_HANDLE,
+		.image_count = image_count,
+		.format = format,
+		.extent = extent,
+		.present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR
+	};
+
+	info.images = malloc(sizeof *info.images * image_count);
+	info.image_allocations = malloc(sizeof *info.image_allocations * image_count);
+	if (!info.images || !info.image_allocations){
+		printf("Error: failed to allocate offscreen targets");
+		return info;
+	}
+
+	for (int i = 0; i < image_count; i++){
+		VkImageCreateInfo create_info = {0};
+		create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		create_info.imageType = VK_IMAGE_TYPE_2D;
+		create_info.format = format;
+		create_info.extent.width = extent.width;
+		create_info.extent.height = extent.height;
+		create_info.extent.depth = 1;
+		create_info.mipLevels = 1;
+		create_info.arrayLayers = 1;
+		create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		//transfer src so the result can be read back to check it
+		create_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		if (vkCreateImage(device, &create_info, HOST_ALLOCATOR, &info.images[i]) != VK_SUCCESS){
+			printf("Error: failed to create offscreen image: %d\n", i);
+		}
+
+		info.image_allocations[i] = gpu_allocate_image(device, allocator, info.images[i], create_info.tiling, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+		if (info.image_allocations[i].memory == VK_NULL_HANDLE){
+			printf("Error: failed to allocate offscreen image memory: %d\n", i);
+		}
+	}
+
+	return info;
+}
+
+void destroy_swap_chain_resources(VkDevice device, struct swap_chain_resources *resources){
+	//order here is extremly important
+	for (int i = 0; i < resources->info.image_count; i++){
+		vkDestroyFramebuffer(device, resources->framebuffers[i], HOST_ALLOCATOR);
+		vkDestroyImageView(device, resources->image_views[i], HOST_ALLOCATOR);
+	}
+
+	//swap chain images belong to the swap chain, offscreen ones are ours to destroy
+	if (resources->info.swap_chain != VK_NULL_HANDLE){
+		vkDestroySwapchainKHR(device, resources->info.swap_chain, HOST_ALLOCATOR);
+	} else {
+		for (int i = 0; i < resources->info.image_count; i++){
+			vkDestroyImage(device, resources->info.images[i], HOST_ALLOCATOR);
+			gpu_free(device, &resources->info.image_allocations[i]);
+		}
+		free(resources->info.image_allocations);
+	}
+
+	free(resources->framebuffers);
+	free(resources->image_views);
+	free(resources->info.images);
+}
+
 VkImageView *create_image_views(VkImage *images, int image_count, VkFormat format, VkDevice device){
 	VkImageView *image_views = malloc(sizeof *image_views * image_count);
 
@@ -544,7 +1257,7 @@ VkImageView *create_image_views(VkImage *images, int image_count, VkFormat forma
 		create_info.subresourceRange.baseArrayLayer = 0;
 		create_info.subresourceRange.layerCount = 1;
 
-		if (vkCreateImageView(device, &create_info, NULL, &image_views[i]) != VK_SUCCESS){
+		if (vkCreateImageView(device, &create_info, HOST_ALLOCATOR, &image_views[i]) != VK_SUCCESS){
 			printf("Error: failed to create image view: %d\n", i);
 		}
 	}
@@ -552,7 +1265,7 @@ VkImageView *create_image_views(VkImage *images, int image_count, VkFormat forma
 	return image_views;
 }
 
-VkRenderPass create_render_pass(VkFormat format, VkDevice device){
+VkRenderPass create_render_pass(VkFormat format, VkImageLayout final_layout, VkDevice device){
 	VkSubpassDependency dependency = {0};
 	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 	dependency.dstSubpass = 0;
@@ -570,7 +1283,8 @@ VkRenderPass create_render_pass(VkFormat format, VkDevice device){
 	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	//PRESENT_SRC for the swap chain, offscreen targets are left ready to be copied out
+	color_attachment.finalLayout = final_layout;
 
 	VkAttachmentReference color_attachment_ref = {0};
 	color_attachment_ref.attachment = 0;
@@ -591,7 +1305,7 @@ VkRenderPass create_render_pass(VkFormat format, VkDevice device){
 	render_pass_create_info.pDependencies = &dependency;
 
 	VkRenderPass render_pass;
-	if (vkCreateRenderPass(device, &render_pass_create_info, NULL, &render_pass) != VK_SUCCESS) {
+	if (vkCreateRenderPass(device, &render_pass_create_info, HOST_ALLOCATOR, &render_pass) != VK_SUCCESS) {
 		printf("Error: failed to create render pass");
 	}
 	return render_pass;
@@ -601,16 +1315,23 @@ VkPipelineLayout create_graphics_pipeline_layout(VkDevice device){
 	VkPipelineLayoutCreateInfo pipeline_layout_info = {0};
 	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipeline_layout_info.setLayoutCount = 0;
-	pipeline_layout_info.pushConstantRangeCount = 0;
+
+	//the mesh's position transform, so quantised positions can be decoded without a descriptor set
+	VkPushConstantRange push_constant_range = {0};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(struct position_transform);
+	pipeline_layout_info.pushConstantRangeCount = 1;
+	pipeline_layout_info.pPushConstantRanges = &push_constant_range;
 
 	VkPipelineLayout pipeline_layout;
-	if (vkCreatePipelineLayout(device, &pipeline_layout_info, NULL, &pipeline_layout) != VK_SUCCESS) {
+	if (vkCreatePipelineLayout(device, &pipeline_layout_info, HOST_ALLOCATOR, &pipeline_layout) != VK_SUCCESS) {
 		printf("Error: failed to create pipeline layout");
 	}
 	return pipeline_layout;
 }
 
-VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D extent, VkRenderPass render_pass, VkPipelineLayout pipeline_layout){
+VkPipeline create_graphics_pipeline(VkDevice device, VkRenderPass render_pass, VkPipelineLayout pipeline_layout, const struct vertex_layout *vertex_layout){
 	//no need to null terminate as we will be explicit about length later
 	char *vert_shader_code = read_file("shaders/vert.spv", false);
 	long vert_shader_length = get_length("shaders/vert.spv");
@@ -620,13 +1341,24 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D extent, VkRender
 	VkShaderModule vert_shader_module = create_shader_module(vert_shader_code, vert_shader_length, device);
 	VkShaderModule frag_shader_module = create_shader_module(frag_shader_code, frag_shader_length, device);
 
+	//the decode path for each quantised attribute is baked in per layout, constant ids match shader.vert
+	struct vertex_decode_constants decode_constants = vertex_layout_decode_constants(vertex_layout);
+	VkSpecializationMapEntry decode_entries[] = {
+		{.constantID = 0, .offset = offsetof(struct vertex_decode_constants, octahedral_color), .size = sizeof(VkBool32)}
+	};
+	VkSpecializationInfo decode_info = {0};
+	decode_info.mapEntryCount = ARR_SIZE(decode_entries);
+	decode_info.pMapEntries = decode_entries;
+	decode_info.dataSize = sizeof decode_constants;
+	decode_info.pData = &decode_constants;
+
 	VkPipelineShaderStageCreateInfo vert_shader_stage_info = {0};
 	vert_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	vert_shader_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
 	vert_shader_stage_info.module = vert_shader_module;
 	vert_shader_stage_info.pName = "main";
 	//use for eificient constant definition at pipeline creation time
-	vert_shader_stage_info.pSpecializationInfo = NULL;
+	vert_shader_stage_info.pSpecializationInfo = &decode_info;
 
 	VkPipelineShaderStageCreateInfo frag_shader_stage_info = {0};
 	frag_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -638,35 +1370,26 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D extent, VkRender
 
 	VkPipelineShaderStageCreateInfo shader_stages[] = {vert_shader_stage_info, frag_shader_stage_info};
 	
-	VkPipelineVertexInputStateCreateInfo vertex_input_info = {0};
-	vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertex_input_info.vertexBindingDescriptionCount = 0;
-	vertex_input_info.vertexAttributeDescriptionCount = 0;
+	VkPipelineVertexInputStateCreateInfo vertex_input_info = vertex_layout_input_state(vertex_layout);
 
 	VkPipelineInputAssemblyStateCreateInfo input_assembly = {0};
 	input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
 	input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 	input_assembly.primitiveRestartEnable = VK_FALSE;
 
-	VkViewport viewport = {0};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = (float) extent.width;
-	viewport.height = (float) extent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	VkRect2D scissor = {0};
-	scissor.offset.x = 0;
-	scissor.offset.y = 0;
-	scissor.extent = extent;
-
+	//the viewport and scissor are set when recording so the pipeline survives the swap chain being resized
 	VkPipelineViewportStateCreateInfo viewport_state = {0};
 	viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	viewport_state.viewportCount = 1;
-	viewport_state.pViewports = &viewport;
+	viewport_state.pViewports = NULL;
 	viewport_state.scissorCount = 1;
-	viewport_state.pScissors = &scissor;
+	viewport_state.pScissors = NULL;
+
+	VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+	VkPipelineDynamicStateCreateInfo dynamic_state = {0};
+	dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamic_state.dynamicStateCount = ARR_SIZE(dynamic_states);
+	dynamic_state.pDynamicStates = dynamic_states;
 
 	VkPipelineRasterizationStateCreateInfo rasterizer = {0};
 	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -709,7 +1432,7 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D extent, VkRender
 	pipeline_info.pMultisampleState = &multisampling;
 	pipeline_info.pDepthStencilState = NULL;
 	pipeline_info.pColorBlendState = &color_blending;
-	pipeline_info.pDynamicState = NULL;
+	pipeline_info.pDynamicState = &dynamic_state;
 
 	pipeline_info.layout = pipeline_layout;
 	pipeline_info.renderPass = render_pass;
@@ -720,12 +1443,12 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D extent, VkRender
 
 	VkPipeline graphics_pipeline;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, NULL, &graphics_pipeline) != VK_SUCCESS){
+	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, HOST_ALLOCATOR, &graphics_pipeline) != VK_SUCCESS){
 		printf("Error: failed to create graphics pipeline");
 	}
 
-	vkDestroyShaderModule(device, vert_shader_module, NULL);
-	vkDestroyShaderModule(device, frag_shader_module, NULL);
+	vkDestroyShaderModule(device, vert_shader_module, HOST_ALLOCATOR);
+	vkDestroyShaderModule(device, frag_shader_module, HOST_ALLOCATOR);
 
 	return graphics_pipeline;
 }
@@ -739,7 +1462,7 @@ VkShaderModule create_shader_module(char *code, long code_size, VkDevice device)
 	create_info.pCode = (uint32_t*) code;
 
 	VkShaderModule shader_module;
-	if (vkCreateShaderModule(device, &create_info, NULL, &shader_module) != VK_SUCCESS){
+	if (vkCreateShaderModule(device, &create_info, HOST_ALLOCATOR, &shader_module) != VK_SUCCESS){
 		printf("Error: failed to create shader module");
 	}
 
@@ -764,7 +1487,7 @@ VkFramebuffer *create_swap_chain_framebuffers(VkDevice device, int image_count,
 		framebuffer_create_info.height = extent.height;
 		framebuffer_create_info.layers = 1;
 
-		if (vkCreateFramebuffer(device, &framebuffer_create_info, NULL, &framebuffers[i])){
+		if (vkCreateFramebuffer(device, &framebuffer_create_info, HOST_ALLOCATOR, &framebuffers[i])){
 			printf("Error: failed to create framebuffer: %d", i);
 		}
 	}
@@ -772,68 +1495,127 @@ VkFramebuffer *create_swap_chain_framebuffers(VkDevice device, int image_count,
 	return framebuffers;
 }
 
-VkCommandPool create_command_pool(VkDevice device, uint32_t queue_index){
-	VkCommandPoolCreateInfo create_info = {};
+VkCommandPool create_command_pool(VkDevice device, uint32_t queue_index, VkCommandPoolCreateFlags flags){
+	VkCommandPoolCreateInfo create_info = {0};
 	create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	create_info.queueFamilyIndex = queue_index;
-	create_info.flags = 0;
+	create_info.flags = flags;
 
 	VkCommandPool command_pool;
-	if (vkCreateCommandPool(device, &create_info, NULL, &command_pool) != VK_SUCCESS){
+	if (vkCreateCommandPool(device, &create_info, HOST_ALLOCATOR, &command_pool) != VK_SUCCESS){
 		printf("Error: failed to create command pool");
 	}
 	return command_pool;
 }
 
-VkCommandBuffer *create_command_buffers(VkDevice device, VkCommandPool command_pool, VkRenderPass render_pass, VkPipeline pipeline, VkFramebuffer *framebuffers, VkExtent2D extent, int image_count){
-	VkCommandBuffer *command_buffers = malloc(sizeof *command_buffers * image_count);
+VkCommandBuffer *create_command_buffers(VkDevice device, VkCommandPool command_pool, int count){
+	PROFILE_BEGIN("create_command_buffers");
+	VkCommandBuffer *command_buffers = malloc(sizeof *command_buffers * count);
 
 	VkCommandBufferAllocateInfo alloc_info = {0};
 	alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	alloc_info.commandPool = command_pool;
 	alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	alloc_info.commandBufferCount = (uint32_t)image_count;
+	alloc_info.commandBufferCount = (uint32_t)count;
 
 	if (vkAllocateCommandBuffers(device, &alloc_info, command_buffers) != VK_SUCCESS){
 		printf("Error: failed to allocate command buffers");
 	}
 
-	for (int i = 0; i < image_count; i++){
-		VkCommandBufferBeginInfo begin_info = {0};
-		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		begin_info.flags = 0;
-		begin_info.pInheritanceInfo = NULL;
+	PROFILE_END();
+	return command_buffers;
+}
 
-		if (vkBeginCommandBuffer(command_buffers[i], &begin_info) != VK_SUCCESS){
-			printf("Error: failed to being recording command buffer: %d", i);
-		}
+void record_command_buffer(VkCommandBuffer command_buffer, struct renderer *renderer, VkFramebuffer framebuffer, VkExtent2D extent, int slot, uint64_t frame_value){
+	VkCommandBufferBeginInfo begin_info = {0};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	//recorded fresh every frame so it is only ever submitted once
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	begin_info.pInheritanceInfo = NULL;
 
-		VkRenderPassBeginInfo render_pass_begin_info = {0};
-		render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		render_pass_begin_info.renderPass = render_pass;
-		render_pass_begin_info.framebuffer = framebuffers[i];
-		render_pass_begin_info.renderArea.offset.x = 0;
-		render_pass_begin_info.renderArea.offset.y = 0;
-		render_pass_begin_info.renderArea.extent = extent;
+	if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS){
+		printf("Error: failed to being recording command buffer: %d", slot);
+	}
 
-		VkClearValue clear_color = {0.0f, 0.0f, 0.0f, 1.0f};
-		render_pass_begin_info.clearValueCount = 1;
-		render_pass_begin_info.pClearValues = &clear_color;
+	gpu_timer_begin_frame(command_buffer, &renderer->gpu_timer, slot, frame_value);
+	//compute has to happen outside the render pass, the draw inside it waits on the compacted indices
+	bool cluster_cull = renderer->culler && renderer->culler->enabled;
+	if (cluster_cull){
+		int cull_region = gpu_timer_begin_region(command_buffer, &renderer->gpu_timer, slot, "cluster_cull");
+		cluster_cull_record(command_buffer, renderer->culler, extent);
+		gpu_timer_end_region(command_buffer, &renderer->gpu_timer, slot, cull_region);
+	}
+	//with no camera yet the mesh is drawn straight into clip space, where one unit is half the framebuffer high
+	float pixels_per_unit = extent.height * 0.5f;
+	bool object_cull = !cluster_cull && renderer->object_culler && renderer->object_culler->enabled;
+	if (object_cull){
+		int cull_region = gpu_timer_begin_region(command_buffer, &renderer->gpu_timer, slot, "object_cull");
+		object_cull_record(command_buffer, renderer->object_culler, pixels_per_unit, renderer->lod_error_pixels);
+		gpu_timer_end_region(command_buffer, &renderer->gpu_timer, slot, cull_region);
+	}
 
-		vkCmdBeginRenderPass(command_buffers[i], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+	int main_pass_region = gpu_timer_begin_region(command_buffer, &renderer->gpu_timer, slot, "main_pass");
 
-		vkCmdBindPipeline(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	VkRenderPassBeginInfo render_pass_begin_info = {0};
+	render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	render_pass_begin_info.renderPass = renderer->render_pass;
+	render_pass_begin_info.framebuffer = framebuffer;
+	render_pass_begin_info.renderArea.offset.x = 0;
+	render_pass_begin_info.renderArea.offset.y = 0;
+	render_pass_begin_info.renderArea.extent = extent;
 
-		vkCmdDraw(command_buffers[i], 3, 1, 0, 0); //holy balls this is it
+	VkClearValue clear_color = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+	render_pass_begin_info.clearValueCount = 1;
+	render_pass_begin_info.pClearValues = &clear_color;
 
-		vkCmdEndRenderPass(command_buffers[i]);
+	vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
 
-		if (vkEndCommandBuffer(command_buffers[i]) != VK_SUCCESS){
-			printf("Error: failed to record command buffer: %d", i);
-		}
+	VkViewport viewport = {0};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = (float) extent.width;
+	viewport.height = (float) extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+	VkRect2D scissor = {0};
+	scissor.offset.x = 0;
+	scissor.offset.y = 0;
+	scissor.extent = extent;
+	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+	if (cluster_cull || object_cull){
+		//the culled paths are a single indirect draw each, there is nothing for the queue to sort
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipeline);
+		vkCmdPushConstants(command_buffer, renderer->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(struct position_transform), &renderer->mesh->position_transform);
+		mesh_bind(command_buffer, renderer->mesh, false);
+	}
+	if (cluster_cull){
+		//the clusters were built over the finest level of the untransformed mesh so that is the one culled and drawn
+		if (bind_instances(command_buffer, renderer->instances, renderer->frame_ring, renderer->instance_binding, 1))
+			cluster_cull_draw(command_buffer, renderer->culler);
+	} else if (object_cull){
+		object_cull_draw(command_buffer, renderer->object_culler, renderer->instance_binding);
+	} else {
+		//there is one pipeline and no descriptor sets yet so every draw shares ids 0, depth is left at 0 as nothing is sorted by it
+		struct draw_packet base = {0};
+		base.key = make_draw_key(DRAW_PASS_MAIN, 0, 0, 0, 0.0f);
+		base.pipeline = renderer->pipeline;
+		base.pipeline_layout = renderer->pipeline_layout;
+		draw_queue_reset(renderer->draw_queue);
+		queue_instances(command_buffer, renderer->instances, renderer->mesh, renderer->frame_ring, renderer->instance_binding, pixels_per_unit, renderer->lod_error_pixels, renderer->draw_queue, &base);
+		draw_queue_sort(renderer->draw_queue);
+		draw_queue_record(command_buffer, renderer->draw_queue);
 	}
 
-	return command_buffers;
+	vkCmdEndRenderPass(command_buffer);
+
+	gpu_timer_end_region(command_buffer, &renderer->gpu_timer, slot, main_pass_region);
+
+	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS){
+		printf("Error: failed to record command buffer: %d", slot);
+	}
 }
 
 VkSemaphore create_semaphore(VkDevice device){
@@ -841,36 +1623,297 @@ VkSemaphore create_semaphore(VkDevice device){
 	create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
 	VkSemaphore semaphore;
-	if (vkCreateSemaphore(device, &create_info, NULL, &semaphore) != VK_SUCCESS){
+	if (vkCreateSemaphore(device, &create_info, HOST_ALLOCATOR, &semaphore) != VK_SUCCESS){
 		printf("Error: failed to create semaphore");
 	}
 
 	return semaphore;
 }
 
-void draw_frame(VkDevice device, VkQueue graphics_queue, VkQueue presentation_queue, VkSwapchainKHR swap_chain, VkCommandBuffer *command_buffers, VkSemaphore image_availible_semaphore, VkSemaphore render_finished_semaphore){
+VkFence create_fence(VkDevice device, bool signaled){
+	VkFenceCreateInfo create_info = {0};
+	create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	//frame fences start signaled so the very first wait on them doesnt block forever
+	create_info.flags = signaled ? VK_FENCE_CREATE_SIGNALED_BIT : 0;
+
+	VkFence fence;
+	if (vkCreateFence(device, &create_info, HOST_ALLOCATOR, &fence) != VK_SUCCESS){
+		printf("Error: failed to create fence");
+	}
+
+	return fence;
+}
+
+VkSemaphore create_timeline_semaphore(VkDevice device, uint64_t initial_value){
+	VkSemaphoreTypeCreateInfo type_info = {0};
+	type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	type_info.initialValue = initial_value;
+
+	VkSemaphoreCreateInfo create_info = {0};
+	create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	create_info.pNext = &type_info;
+
+	VkSemaphore semaphore;
+	if (vkCreateSemaphore(device, &create_info, HOST_ALLOCATOR, &semaphore) != VK_SUCCESS){
+		printf("Error: failed to create timeline semaphore");
+	}
+
+	return semaphore;
+}
+
+struct frame_context create_frame_context(VkDevice device, int frames_in_flight, int image_count, bool use_timeline, uint32_t queue_family){
+	struct frame_context frame_context = {0};
+	frame_context.frames_in_flight = frames_in_flight;
+	frame_context.current_frame = 0;
+	frame_context.frame_number = 0;
+	frame_context.completed_frames = 0;
+	frame_context.image_count = image_count;
+
+	//the 1.2 entry points are loaded by hand so the program still starts against an older loader
+	if (use_timeline){
+		frame_context.wait_semaphores = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(device, "vkWaitSemaphores");
+		frame_context.get_semaphore_counter_value = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValue");
+		if (!frame_context.wait_semaphores || !frame_context.get_semaphore_counter_value){
+			printf("Error: timeline semaphore functions not found, falling back to fences\n");
+			use_timeline = false;
+		}
+	}
+	frame_context.use_timeline = use_timeline;
+
+	frame_context.image_availible_semaphores = malloc(sizeof *frame_context.image_availible_semaphores * frames_in_flight);
+	frame_context.render_finished_semaphores = malloc(sizeof *frame_context.render_finished_semaphores * frames_in_flight);
+	frame_context.in_flight_fences = malloc(sizeof *frame_context.in_flight_fences * frames_in_flight);
+	frame_context.slot_frames = malloc(sizeof *frame_context.slot_frames * frames_in_flight);
+	frame_context.command_pools = malloc(sizeof *frame_context.command_pools * frames_in_flight);
+	frame_context.command_buffers = malloc(sizeof *frame_context.command_buffers * frames_in_flight);
+	frame_context.images_in_flight = malloc(sizeof *frame_context.images_in_flight * image_count);
+
+	if (!frame_context.image_availible_semaphores || !frame_context.render_finished_semaphores || !frame_context.in_flight_fences || !frame_context.slot_frames || !frame_context.command_pools || !frame_context.command_buffers || !frame_context.images_in_flight){
+		printf("Error: failed to allocate frame context");
+		return frame_context;
+	}
+
+	//acquire and present only take binary semaphores so those stay per frame even on the timeline path
+	for (int i = 0; i < frames_in_flight; i++){
+		frame_context.image_availible_semaphores[i] = create_semaphore(device);
+		frame_context.render_finished_semaphores[i] = create_semaphore(device);
+		frame_context.in_flight_fences[i] = use_timeline ? VK_NULL_HANDLE : create_fence(device, true);
+		frame_context.slot_frames[i] = 0;
+
+		//a pool per slot means the whole slot can be reset in one call once its frame has finished
+		frame_context.command_pools[i] = create_command_pool(device, queue_family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		VkCommandBuffer *command_buffer = create_command_buffers(device, frame_context.command_pools[i], 1);
+		frame_context.command_buffers[i] = command_buffer[0];
+		free(command_buffer);
+	}
+
+	if (use_timeline)
+		frame_context.graphics_timeline = create_timeline_semaphore(device, 0);
+
+	//no image is being used by a frame yet
+	for (int i = 0; i < image_count; i++){
+		frame_context.images_in_flight[i] = 0;
+	}
+
+	return frame_context;
+}
+
+void destroy_frame_context(VkDevice device, struct frame_context *frame_context){
+	//this is only called once the device is idle so everything still retired can go
+	flush_deletion_queue(device, &frame_context->deletion_queue, UINT64_MAX);
+	free(frame_context->deletion_queue.entries);
+
+	for (int i = 0; i < frame_context->frames_in_flight; i++){
+		vkDestroySemaphore(device, frame_context->image_availible_semaphores[i], HOST_ALLOCATOR);
+		vkDestroySemaphore(device, frame_context->render_finished_semaphores[i], HOST_ALLOCATOR);
+		if (!frame_context->use_timeline)
+			vkDestroyFence(device, frame_context->in_flight_fences[i], HOST_ALLOCATOR);
+		//destroying the pool frees its command buffer too
+		vkDestroyCommandPool(device, frame_context->command_pools[i], HOST_ALLOCATOR);
+	}
+
+	if (frame_context->use_timeline)
+		vkDestroySemaphore(device, frame_context->graphics_timeline, HOST_ALLOCATOR);
+
+	free(frame_context->image_availible_semaphores);
+	free(frame_context->render_finished_semaphores);
+	free(frame_context->in_flight_fences);
+	free(frame_context->slot_frames);
+	free(frame_context->command_pools);
+	free(frame_context->command_buffers);
+	free(frame_context->images_in_flight);
+}
+
+void wait_for_frame(VkDevice device, struct frame_context *frame_context, uint64_t frame_value){
+	if (frame_value <= frame_context->completed_frames)
+		return;
+
+	if (frame_context->use_timeline){
+		VkSemaphoreWaitInfo wait_info = {0};
+		wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		wait_info.semaphoreCount = 1;
+		wait_info.pSemaphores = &frame_context->graphics_timeline;
+		wait_info.pValues = &frame_value;
+
+		if (frame_context->wait_semaphores(device, &wait_info, UINT64_MAX) != VK_SUCCESS)
+			printf("Error: failed to wait for frame %llu", (unsigned long long)frame_value);
+
+		frame_context->completed_frames = frame_value;
+		return;
+	}
+
+	//without a timeline the frame lives in slot (value - 1) % frames_in_flight, the slot may already hold a newer
+	//frame which only makes the wait more conservative, never wrong, as fences signal in submission order
+	int slot = (int)((frame_value - 1) % frame_context->frames_in_flight);
+	vkWaitForFences(device, 1, &frame_context->in_flight_fences[slot], VK_TRUE, UINT64_MAX);
+	frame_context->completed_frames = MAX(frame_context->completed_frames, frame_context->slot_frames[slot]);
+}
+
+uint64_t get_completed_frames(VkDevice device, struct frame_context *frame_context){
+	//a single counter read tells us every frame that has finished without touching any fences
+	if (frame_context->use_timeline){
+		uint64_t value = 0;
+		if (frame_context->get_semaphore_counter_value(device, frame_context->graphics_timeline, &value) == VK_SUCCESS)
+			frame_context->completed_frames = MAX(frame_context->completed_frames, value);
+	}
+
+	return frame_context->completed_frames;
+}
+
+void reset_frame_context_images(struct frame_context *frame_context, int image_count){
+	uint64_t *images_in_flight = realloc(frame_context->images_in_flight, sizeof *images_in_flight * image_count);
+	if (!images_in_flight){
+		printf("Error: failed to resize images in flight");
+		return;
+	}
+
+	for (int i = 0; i < image_count; i++){
+		images_in_flight[i] = 0;
+	}
+
+	frame_context->images_in_flight = images_in_flight;
+	frame_context->image_count = image_count;
+}
+
+void push_deletion(struct deletion_queue *queue, uint64_t retire_frame, void (*destroy)(VkDevice device, void *data), void *data){
+	if (queue->count == queue->capacity){
+		int new_capacity = queue->capacity ? queue->capacity * 2 : 8;
+		struct deletion_entry *entries = realloc(queue->entries, sizeof *entries * new_capacity);
+		if (!entries){
+			printf("Error: failed to grow deletion queue");
+			return;
+		}
+		queue->entries = entries;
+		queue->capacity = new_capacity;
+	}
+
+	queue->entries[queue->count].retire_frame = retire_frame;
+	queue->entries[queue->count].destroy = destroy;
+	queue->entries[queue->count].data = data;
+	queue->count++;
+}
+
+void flush_deletion_queue(VkDevice device, struct deletion_queue *queue, uint64_t completed_frames){
+	//entries are pushed in retirement order so we can stop at the first one that is still in use
+	int flushed = 0;
+	while (flushed < queue->count && queue->entries[flushed].retire_frame <= completed_frames){
+		queue->entries[flushed].destroy(device, queue->entries[flushed].data);
+		flushed++;
+	}
+
+	if (flushed){
+		memmove(queue->entries, queue->entries + flushed, sizeof *queue->entries * (queue->count - flushed));
+		queue->count -= flushed;
+	}
+}
+
+bool draw_frame(VkDevice device, VkQueue graphics_queue, VkQueue presentation_queue, struct swap_chain_resources *swap_chain_resources, struct frame_context *frame_context, struct renderer *renderer, struct frame_timings *timings){
+	VkSwapchainKHR swap_chain = swap_chain_resources->info.swap_chain;
+	int frame = frame_context->current_frame;
+	uint64_t start_time = get_time_ns();
+
+	//frame values start at 1, frame n can only start once frame n - frames_in_flight has finished on the gpu
+	//this is what stops the cpu running away
+	uint64_t frame_value = frame_context->frame_number + 1;
+	if (frame_value > (uint64_t)frame_context->frames_in_flight)
+		wait_for_frame(device, frame_context, frame_value - frame_context->frames_in_flight);
+
+	flush_deletion_queue(device, &frame_context->deletion_queue, get_completed_frames(device, frame_context));
+
+	//this slots last frame is known to be done so its timestamps can be read and its ring region reused without waiting
+	gpu_timer_collect(device, &renderer->gpu_timer, frame);
+	if (renderer->frame_ring)
+		frame_ring_begin(renderer->frame_ring, frame);
+
+	uint64_t waited_time = get_time_ns();
+
 	uint32_t image_index;
-	vkAcquireNextImageKHR(device, swap_chain, UINT64_MAX, image_availible_semaphore, VK_NULL_HANDLE, &image_index);
+	VkResult acquire_result = vkAcquireNextImageKHR(device, swap_chain, UINT64_MAX, frame_context->image_availible_semaphores[frame], VK_NULL_HANDLE, &image_index);
+
+	//nothing was submitted and the semaphore was not signaled so this frame slot can simply be reused after recreating
+	if (acquire_result == VK_ERROR_OUT_OF_DATE_KHR)
+		return true;
+	if (acquire_result != VK_SUCCESS && acquire_result != VK_SUBOPTIMAL_KHR)
+		printf("Error: failed to acquire swap chain image: %d", acquire_result);
+
+	//suboptimal still gives us a usable image so draw this frame and recreate after presenting it
+	bool needs_recreate = acquire_result == VK_SUBOPTIMAL_KHR;
+	uint64_t acquired_time = get_time_ns();
+
+	//the swap chain can hand back images out of order so an older frame may still be drawing to this image
+	if (frame_context->images_in_flight[image_index] != 0){
+		wait_for_frame(device, frame_context, frame_context->images_in_flight[image_index]);
+	}
+	frame_context->images_in_flight[image_index] = frame_value;
+	uint64_t image_waited_time = get_time_ns();
+
+	//the slots pool is free to reset as the frame that used it has finished
+	VkCommandBuffer command_buffer = frame_context->command_buffers[frame];
+	vkResetCommandPool(device, frame_context->command_pools[frame], 0);
+	record_command_buffer(command_buffer, renderer, swap_chain_resources->framebuffers[image_index], swap_chain_resources->info.extent, frame, frame_value);
 
 	VkSubmitInfo submit_info = {0};
 	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-	VkSemaphore wait_semaphores[] = {image_availible_semaphore};
+	VkSemaphore wait_semaphores[] = {frame_context->image_availible_semaphores[frame]};
 	VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
 	submit_info.waitSemaphoreCount = 1;
 	submit_info.pWaitSemaphores = wait_semaphores;
 	submit_info.pWaitDstStageMask = wait_stages;
 
 	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &command_buffers[image_index];
+	submit_info.pCommandBuffers = &command_buffer;
 
-	VkSemaphore signal_semaphores[] = {render_finished_semaphore};
-	submit_info.signalSemaphoreCount = 1;
+	//the binary semaphore is for present, the timeline one (when there is one) marks the frame as done for the cpu
+	VkSemaphore signal_semaphores[] = {frame_context->render_finished_semaphores[frame], frame_context->graphics_timeline};
+	submit_info.signalSemaphoreCount = frame_context->use_timeline ? 2 : 1;
 	submit_info.pSignalSemaphores = signal_semaphores;
 
-	if (vkQueueSubmit(graphics_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS){
+	//binary semaphores ignore their value but the arrays still have to line up with the semaphore arrays
+	uint64_t wait_values[] = {0};
+	uint64_t signal_values[] = {0, frame_value};
+	VkTimelineSemaphoreSubmitInfo timeline_info = {0};
+	timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timeline_info.waitSemaphoreValueCount = submit_info.waitSemaphoreCount;
+	timeline_info.pWaitSemaphoreValues = wait_values;
+	timeline_info.signalSemaphoreValueCount = submit_info.signalSemaphoreCount;
+	timeline_info.pSignalSemaphoreValues = signal_values;
+
+	VkFence fence = VK_NULL_HANDLE;
+	if (frame_context->use_timeline){
+		submit_info.pNext = &timeline_info;
+	} else {
+		//only reset right before submitting so the fence is never left unsignaled without work behind it
+		fence = frame_context->in_flight_fences[frame];
+		vkResetFences(device, 1, &fence);
+	}
+	frame_context->slot_frames[frame] = frame_value;
+
+	if (vkQueueSubmit(graphics_queue, 1, &submit_info, fence) != VK_SUCCESS){
 		printf("Error: failed to submit draw command buffer");
 	}
+	uint64_t submitted_time = get_time_ns();
 
 	VkPresentInfoKHR present_info = {0};
 	present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -883,7 +1926,91 @@ void draw_frame(VkDevice device, VkQueue graphics_queue, VkQueue presentation_qu
 
 	present_info.pResults = NULL;
 
-	vkQueuePresentKHR(presentation_queue, &present_info);
+	VkResult present_result = vkQueuePresentKHR(presentation_queue, &present_info);
+	if (present_result == VK_ERROR_OUT_OF_DATE_KHR || present_result == VK_SUBOPTIMAL_KHR)
+		needs_recreate = true;
+	else if (present_result != VK_SUCCESS)
+		printf("Error: failed to present swap chain image: %d", present_result);
+	uint64_t presented_time = get_time_ns();
+
+	if (timings){
+		timings->wait_ns = (waited_time - start_time) + (image_waited_time - acquired_time);
+		timings->acquire_ns = acquired_time - waited_time;
+		timings->submit_ns = submitted_time - image_waited_time;
+		timings->present_ns = presented_time - submitted_time;
+	}
 
-	printf("frame completed");
-}
\ No newline at end of file
+	frame_context->frame_number++;
+	frame_context->current_frame = (frame + 1) % frame_context->frames_in_flight;
+
+	TELEMETRY_FRAME_EVENT(frame_value, present_result, acquire_result);
+
+	return needs_recreate;
+}
+
+void draw_offscreen_frame(VkDevice device, VkQueue graphics_queue, struct swap_chain_resources *swap_chain_resources, struct frame_context *frame_context, struct renderer *renderer, struct frame_timings *timings){
+	int frame = frame_context->current_frame;
+	uint64_t start_time = get_time_ns();
+
+	uint64_t frame_value = frame_context->frame_number + 1;
+	if (frame_value > (uint64_t)frame_context->frames_in_flight)
+		wait_for_frame(device, frame_context, frame_value - frame_context->frames_in_flight);
+
+	flush_deletion_queue(device, &frame_context->deletion_queue, get_completed_frames(device, frame_context));
+	gpu_timer_collect(device, &renderer->gpu_timer, frame);
+	if (renderer->frame_ring)
+		frame_ring_begin(renderer->frame_ring, frame);
+
+	//with nothing to acquire from the targets are just used round robin
+	uint32_t image_index = (uint32_t)(frame_context->frame_number % frame_context->image_count);
+	if (frame_context->images_in_flight[image_index] != 0){
+		wait_for_frame(device, frame_context, frame_context->images_in_flight[image_index]);
+	}
+	frame_context->images_in_flight[image_index] = frame_value;
+	uint64_t waited_time = get_time_ns();
+
+	VkCommandBuffer command_buffer = frame_context->command_buffers[frame];
+	vkResetCommandPool(device, frame_context->command_pools[frame], 0);
+	record_command_buffer(command_buffer, renderer, swap_chain_resources->framebuffers[image_index], swap_chain_resources->info.extent, frame, frame_value);
+
+	VkSubmitInfo submit_info = {0};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &command_buffer;
+
+	//there is no present to feed so the timeline is the only thing signaled
+	uint64_t signal_values[] = {frame_value};
+	VkTimelineSemaphoreSubmitInfo timeline_info = {0};
+	timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timeline_info.signalSemaphoreValueCount = 1;
+	timeline_info.pSignalSemaphoreValues = signal_values;
+
+	VkFence fence = VK_NULL_HANDLE;
+	if (frame_context->use_timeline){
+		submit_info.pNext = &timeline_info;
+		submit_info.signalSemaphoreCount = 1;
+		submit_info.pSignalSemaphores = &frame_context->graphics_timeline;
+	} else {
+		fence = frame_context->in_flight_fences[frame];
+		vkResetFences(device, 1, &fence);
+	}
+	frame_context->slot_frames[frame] = frame_value;
+
+	VkResult result = vkQueueSubmit(graphics_queue, 1, &submit_info, fence);
+	if (result != VK_SUCCESS){
+		printf("Error: failed to submit offscreen command buffer");
+	}
+
+	//there is no acquire or present in a headless frame so only the wait and submit are timed
+	if (timings){
+		timings->wait_ns = waited_time - start_time;
+		timings->acquire_ns = 0;
+		timings->submit_ns = get_time_ns() - waited_time;
+		timings->present_ns = 0;
+	}
+
+	frame_context->frame_number++;
+	frame_context->current_frame = (frame + 1) % frame_context->frames_in_flight;
+
+	TELEMETRY_FRAME_EVENT(frame_value, result, VK_SUCCESS);
+}
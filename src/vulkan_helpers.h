@@ -1,21 +1,78 @@
+//forward declarations of structs defined further down that are passed around by pointer
+struct frame_context;
+struct swap_chain_resources;
+struct deletion_queue;
+struct frame_timings;
+struct renderer;
+struct gpu_allocator;
+struct gpu_allocation;
+struct frame_ring;
+struct upload_manager;
+struct device_capabilities;
+struct vertex_layout;
+struct mesh;
+struct cluster_culler;
+struct object_culler;
+struct draw_queue;
+struct instance_set;
+
+//enums
+
+//what the present mode policy should optimise for when ranking the availible present modes
+enum present_mode_goal{
+	PRESENT_GOAL_LOW_LATENCY,
+	PRESENT_GOAL_MAX_THROUGHPUT,
+	PRESENT_GOAL_POWER_SAVING,
+	PRESENT_GOAL_COUNT
+};
+
+//what a sub-allocation will be bound to, linear and optimal resources are kept in separate blocks
+//so the buffer image granularity never has to be checked between neighbours
+enum gpu_resource_kind{
+	GPU_RESOURCE_LINEAR,
+	GPU_RESOURCE_OPTIMAL,
+	GPU_RESOURCE_KIND_COUNT
+};
+
 //functions
 
 //glfw stuff
 GLFWwindow *InitialiseGLFW(uint32_t width, uint32_t height);
 
 //instance functions
-VkInstance create_vk_instance();
+VkInstance create_vk_instance(uint32_t api_version, bool headless);
+uint32_t negotiate_api_version();
 
 //device functions
-VkDevice create_logical_device(VkPhysicalDevice physical_device, VkSurfaceKHR surface);
+VkDevice create_logical_device(VkPhysicalDevice physical_device, VkSurfaceKHR surface, bool enable_timeline_semaphores, bool enable_pipeline_statistics, bool enable_draw_indirect_count);
+bool query_timeline_semaphore_support(VkInstance instance, VkPhysicalDevice device, uint32_t api_version);
+bool query_draw_indirect_count_support(VkInstance instance, VkPhysicalDevice device, uint32_t api_version);
+bool query_pipeline_statistics_support(VkPhysicalDevice device);
 bool check_device_extension_support(VkPhysicalDevice device);
 bool is_device_suitable(VkPhysicalDevice device, VkSurfaceKHR surface);
 VkPhysicalDevice pick_physical_device(VkInstance instance, VkSurfaceKHR VkSurfaceKHR);
 struct queue_family_indices find_queue_families(VkPhysicalDevice device, VkSurfaceKHR surface);
+const struct device_capabilities *get_device_capabilities(VkPhysicalDevice physical_device, VkSurfaceKHR surface);
+void destroy_device_capabilities();
+
+//startup scratch functions, enumeration results live in the arena until it is reset
+void reset_vulkan_scratch();
+void destroy_vulkan_scratch();
+
+//device memory functions, every buffer and image should get its memory through these
+struct gpu_allocator create_gpu_allocator(VkPhysicalDevice physical_device, VkDevice device);
+void destroy_gpu_allocator(VkDevice device, struct gpu_allocator *allocator);
+struct gpu_allocation gpu_allocate(VkDevice device, struct gpu_allocator *allocator, VkMemoryRequirements requirements, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, enum gpu_resource_kind kind, bool dedicated);
+struct gpu_allocation gpu_allocate_buffer(VkDevice device, struct gpu_allocator *allocator, VkBuffer buffer, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred);
+struct gpu_allocation gpu_allocate_image(VkDevice device, struct gpu_allocator *allocator, VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred);
+void gpu_free(VkDevice device, struct gpu_allocation *allocation);
+uint32_t choose_memory_type(struct gpu_allocator *allocator, uint32_t type_bits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred);
+struct gpu_allocator_stats get_gpu_allocator_stats(struct gpu_allocator *allocator);
+void print_gpu_allocator_stats(struct gpu_allocator *allocator);
 
 //extension functions
 void PrintAvailibleExtensions();
-struct extension_info get_required_extensions();
+struct extension_info get_required_extensions(bool headless);
 
 //debug functions
 void setup_debug_messenger(VkInstance instance, VkDebugUtilsMessengerEXT* p_debug_messenger);
@@ -30,16 +87,23 @@ VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
 void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks *pAllocator);
 
 //swap chain functions
-struct swap_chain_info create_swap_chain(VkPhysicalDevice physical_device, VkSurfaceKHR surface, GLFWwindow *window, VkDevice device);
+struct swap_chain_info create_swap_chain(VkPhysicalDevice physical_device, VkSurfaceKHR surface, GLFWwindow *window, VkDevice device, enum present_mode_goal goal, VkSwapchainKHR old_swap_chain);
+void recreate_swap_chain(VkPhysicalDevice physical_device, VkSurfaceKHR surface, GLFWwindow *window, VkDevice device, VkRenderPass render_pass, enum present_mode_goal goal, struct swap_chain_resources *resources, struct frame_context *frame_context);
+void destroy_swap_chain_resources(VkDevice device, struct swap_chain_resources *resources);
+
+//offscreen target functions
+struct swap_chain_info create_offscreen_targets(VkDevice device, struct gpu_allocator *allocator, VkFormat format, VkExtent2D extent, int image_count);
 VkImageView *create_image_views(VkImage *images, int image_count, VkFormat format, VkDevice device);
 VkSurfaceKHR create_surface(VkInstance instance, GLFWwindow *window);
 struct swap_chain_support_details query_swap_chain_support(VkPhysicalDevice device, VkSurfaceKHR surface);
 VkSurfaceFormatKHR choose_swap_surface_format(VkSurfaceFormatKHR *available_formats, int format_count);
-VkPresentModeKHR choose_swap_present_mode(VkPresentModeKHR *availible_modes, int mode_count);
+VkPresentModeKHR choose_swap_present_mode(VkPresentModeKHR *availible_modes, int mode_count, enum present_mode_goal goal);
+const char *present_mode_goal_name(enum present_mode_goal goal);
+bool parse_present_mode_goal(const char *name, enum present_mode_goal *goal);
 VkExtent2D choose_swap_extent(GLFWwindow *window, VkSurfaceCapabilitiesKHR capabilities);
 
 //graphics pipeline functions
-VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D extent, VkRenderPass render_pass, VkPipelineLayout pipeline_layout);
+VkPipeline create_graphics_pipeline(VkDevice device, VkRenderPass render_pass, VkPipelineLayout pipeline_layout, const struct vertex_layout *vertex_layout);
 VkPipelineLayout create_graphics_pipeline_layout(VkDevice device);
 VkShaderModule create_shader_module(char *code, long code_size, VkDevice device);
 
@@ -48,19 +112,57 @@ VkFramebuffer *create_swap_chain_framebuffers(VkDevice device, int image_count,
 
 
 //render pass functions
-VkRenderPass create_render_pass(VkFormat format, VkDevice device);
+VkRenderPass create_render_pass(VkFormat format, VkImageLayout final_layout, VkDevice device);
 
 //command stuff
-VkCommandPool create_command_pool(VkDevice device, uint32_t queue_index);
-VkCommandBuffer *create_command_buffers(VkDevice device, VkCommandPool command_pool, VkRenderPass render_pass, VkPipeline pipeline, VkFramebuffer *framebuffers, VkExtent2D extent, int image_count);
-void draw_frame(VkDevice device, VkQueue graphics_queue, VkQueue presentation_queue, VkSwapchainKHR swap_chain, VkCommandBuffer *command_buffers, VkSemaphore image_availible_semaphore, VkSemaphore render_finished_semaphore);
+VkCommandPool create_command_pool(VkDevice device, uint32_t queue_index, VkCommandPoolCreateFlags flags);
+VkCommandBuffer *create_command_buffers(VkDevice device, VkCommandPool command_pool, int count);
+void record_command_buffer(VkCommandBuffer command_buffer, struct renderer *renderer, VkFramebuffer framebuffer, VkExtent2D extent, int slot, uint64_t frame_value);
+bool draw_frame(VkDevice device, VkQueue graphics_queue, VkQueue presentation_queue, struct swap_chain_resources *swap_chain_resources, struct frame_context *frame_context, struct renderer *renderer, struct frame_timings *timings);
+void draw_offscreen_frame(VkDevice device, VkQueue graphics_queue, struct swap_chain_resources *swap_chain_resources, struct frame_context *frame_context, struct renderer *renderer, struct frame_timings *timings);
 
 //semaphores
 VkSemaphore create_semaphore(VkDevice device);
+VkSemaphore create_timeline_semaphore(VkDevice device, uint64_t initial_value);
+
+//fences
+VkFence create_fence(VkDevice device, bool signaled);
+
+//frame context functions
+struct frame_context create_frame_context(VkDevice device, int frames_in_flight, int image_count, bool use_timeline, uint32_t queue_family);
+void wait_for_frame(VkDevice device, struct frame_context *frame_context, uint64_t frame_value);
+uint64_t get_completed_frames(VkDevice device, struct frame_context *frame_context);
+void destroy_frame_context(VkDevice device, struct frame_context *frame_context);
+void reset_frame_context_images(struct frame_context *frame_context, int image_count);
+
+//deletion queue functions
+void push_deletion(struct deletion_queue *queue, uint64_t retire_frame, void (*destroy)(VkDevice device, void *data), void *data);
+void flush_deletion_queue(VkDevice device, struct deletion_queue *queue, uint64_t completed_frames);
 
 
 //structs
 
+//everything about a physical device that never changes, taken once instead of on every query
+//the surface half is retaken only when a different surface is asked about, the surface capabilities
+//are left out since their current extent changes with the window
+struct device_capabilities{
+	VkPhysicalDevice physical_device;
+	VkPhysicalDeviceProperties properties;
+	VkPhysicalDeviceFeatures features;
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	VkQueueFamilyProperties *queue_families;
+	uint32_t queue_family_count;
+	bool device_extensions_supported;
+
+	VkSurfaceKHR surface;
+	//one per queue family
+	bool *present_support;
+	VkSurfaceFormatKHR *formats;
+	int format_count;
+	VkPresentModeKHR *present_modes;
+	int present_mode_count;
+};
+
 //a struct for getting the queue family indicies for certain family types
 struct queue_family_indices{
 	int family_count;
@@ -68,6 +170,9 @@ struct queue_family_indices{
 	bool graphics_family_set;
 	uint32_t presentation_family;
 	bool presentation_family_set;
+	//a family for uploads, a transfer only one when the device has it otherwise the graphics family
+	uint32_t transfer_family;
+	bool transfer_family_set;
 };
 
 //a struct made to allow the get_required_extensions function to give both a list of extensions and
@@ -87,12 +192,178 @@ struct swap_chain_support_details{
 };
 
 //a struct for swap chain details to pass back from create function
+//headless runs fill it with offscreen targets instead, swap_chain is then VK_NULL_HANDLE and image_allocations is set
 struct swap_chain_info{
 	VkSwapchainKHR swap_chain;
 	VkImage *images;
+	struct gpu_allocation *image_allocations;
 	int image_count;
 	VkFormat format;
 	VkExtent2D extent;
+	VkPresentModeKHR present_mode;
+};
+
+//a struct for everything that is tied to the swap chain images and so has to be rebuilt whenever the swap chain is
+struct swap_chain_resources{
+	struct swap_chain_info info;
+	VkImageView *image_views;
+	VkFramebuffer *framebuffers;
+};
+
+//a struct for the objects every frame is recorded with, these outlive any one swap chain
+struct renderer{
+	VkRenderPass render_pass;
+	VkPipelineLayout pipeline_layout;
+	VkPipeline pipeline;
+	struct gpu_timer gpu_timer;
+	//per frame uniforms, dynamic vertices and indirect args, rewound for each frame once its slot is free again
+	struct frame_ring *frame_ring;
+	//batched staging uploads on the transfer queue, anything filling buffers or images should go through it
+	struct upload_manager *upload_manager;
+	//what gets drawn, its vertex layout has to be the one the pipeline was built with
+	struct mesh *mesh;
+	//culls the mesh's clusters before it is drawn, NULL to draw it whole
+	struct cluster_culler *culler;
+	//culls the instances and writes their draws on the gpu, NULL to draw them from the cpu
+	struct object_culler *object_culler;
+	//draws made from the cpu go through here to be sorted by state before they are recorded
+	struct draw_queue *draw_queue;
+	//the copies of the mesh drawn each frame and the vertex binding their per instance data goes in
+	struct instance_set *instances;
+	uint32_t instance_binding;
+	//how many pixels of error picking a coarser level of detail for an instance is allowed to cost
+	float lod_error_pixels;
+};
+
+//a struct for the cpu time spent in each part of drawing a frame, filled in by the draw functions when asked for
+//wait covers blocking on earlier frames, present is left at 0 when there is nothing to present
+struct frame_timings{
+	uint64_t wait_ns;
+	uint64_t acquire_ns;
+	uint64_t submit_ns;
+	uint64_t present_ns;
+};
+
+//a struct for a resource waiting to be destroyed once the gpu has finished every frame that could have used it
+struct deletion_entry{
+	//the number of frames that had been submitted when this was retired, it is safe to destroy once that many have completed
+	uint64_t retire_frame;
+	void (*destroy)(VkDevice device, void *data);
+	void *data;
+};
+
+//a growable list of deletion entries, kept in retirement order
+struct deletion_queue{
+	struct deletion_entry *entries;
+	int count;
+	int capacity;
+};
+
+//a struct holding the per frame sync objects so the cpu can record frame n+1 while the gpu is still drawing frame n
+//frames_in_flight bounds how far the cpu can run ahead, more frames means more throughput but more latency
+struct frame_context{
+	int frames_in_flight;
+	int current_frame;
+
+	//counts every submitted frame, frame n is given the value n + 1 so 0 can mean no frame at all
+	//completed_frames is the highest frame value known to have finished on the gpu
+	uint64_t frame_number;
+	uint64_t completed_frames;
+	struct deletion_queue deletion_queue;
+	VkSemaphore *image_availible_semaphores;
+	VkSemaphore *render_finished_semaphores;
+
+	//with timeline semaphores the graphics queue signals graphics_timeline to the frame value on every submit
+	//so the cpu can wait for or query any frame by value, otherwise one fence per frame slot is used instead
+	bool use_timeline;
+	VkSemaphore graphics_timeline;
+	PFN_vkWaitSemaphores wait_semaphores;
+	PFN_vkGetSemaphoreCounterValue get_semaphore_counter_value;
+	VkFence *in_flight_fences;
+	//the frame value last submitted in each slot, needed to know what a fence covers on the fallback path
+	uint64_t *slot_frames;
+
+	//every slot records into its own pool which is reset once the slot comes round again
+	VkCommandPool *command_pools;
+	VkCommandBuffer *command_buffers;
+
+	//one entry per swap chain image, holds the value of the frame last drawn to that image or 0
+	int image_count;
+	uint64_t *images_in_flight;
+};
+
+//one large vkAllocateMemory carved up by a buddy allocator, every node is MIN_SIZE << order bytes and starts at a
+//multiple of its own size, so any alignment up to the node size comes for free
+//the free lists are intrusive over the block's leaves (MIN_SIZE sized slots) to keep them allocation free
+struct gpu_memory_block{
+	VkDeviceMemory memory;
+	//host visible blocks stay mapped for their whole life so sub-allocations never map or unmap
+	void *mapped;
+	uint32_t memory_type;
+	enum gpu_resource_kind kind;
+	VkDeviceSize size;
+	uint32_t max_order;
+
+	//first free leaf of each order or -1, then per leaf the links and the order of the free node starting there or -1
+	int32_t *free_heads;
+	int32_t *next_free;
+	int32_t *prev_free;
+	int8_t *free_order;
+
+	//bytes handed out rounded up to node sizes and bytes actually asked for
+	VkDeviceSize reserved;
+	VkDeviceSize requested;
+	uint32_t allocation_count;
+
+	struct gpu_memory_block *next;
+};
+
+//owns every device memory block, it isnt thread safe so allocate and free from one thread
+struct gpu_allocator{
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	VkDeviceSize buffer_image_granularity;
+	uint32_t max_memory_allocations;
+	//live vkAllocateMemory calls, blocks plus dedicated allocations, kept well under max_memory_allocations
+	uint32_t device_allocation_count;
+
+	//the block size used for each memory heap, smaller heaps get smaller blocks so one block cant eat them
+	VkDeviceSize block_sizes[VK_MAX_MEMORY_HEAPS];
+	struct gpu_memory_block *blocks;
+
+	uint32_t dedicated_count;
+	VkDeviceSize dedicated_bytes;
+};
+
+//a piece of device memory, either a node in a block or a dedicated allocation when block is NULL
+//memory is VK_NULL_HANDLE when the allocation failed
+struct gpu_allocation{
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	//offset already applied, NULL unless the memory is host visible
+	void *mapped;
+	uint32_t memory_type;
+
+	struct gpu_allocator *allocator;
+	struct gpu_memory_block *block;
+	uint32_t order;
+};
+
+//usage and fragmentation over every block, fragmentation is the share of free bytes outside the largest free node
+//of their block, so 0 means each block's free space is in one piece
+struct gpu_allocator_stats{
+	uint32_t block_count;
+	uint32_t dedicated_count;
+	uint32_t allocation_count;
+	uint32_t device_allocation_count;
+	uint32_t max_memory_allocations;
+	VkDeviceSize block_bytes;
+	VkDeviceSize dedicated_bytes;
+	VkDeviceSize reserved_bytes;
+	VkDeviceSize requested_bytes;
+	VkDeviceSize free_bytes;
+	VkDeviceSize largest_free_bytes;
+	double fragmentation;
 };
 
 